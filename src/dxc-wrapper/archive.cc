@@ -0,0 +1,1167 @@
+#include "archive.hh"
+
+#include <cstdio>
+#include <cstring>
+
+#include <algorithm>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <clean-core/assert.hh>
+
+#include <dxc-wrapper/common/crc32c.hh>
+#include <dxc-wrapper/common/entry_name.hh>
+#include <dxc-wrapper/common/log.hh>
+#include <dxc-wrapper/common/lz.hh>
+#include <dxc-wrapper/common/mapped_file.hh>
+#include <dxc-wrapper/common/spirv_codec.hh>
+#include <dxc-wrapper/compiler.hh>
+
+#ifdef CC_OS_WINDOWS
+#include <io.h>
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+struct dxcw::detail::archive_writer_state
+{
+    std::mutex mutex;
+    std::FILE* file = nullptr;
+    std::string path;
+    std::string temp_path; // a new archive is written here and renamed to path in finalize(), empty for updates
+    std::string base_path;
+    uint32_t blob_alignment = 0;
+    uint64_t write_offset = 0;
+    bool enable_compression = false;
+    bool enable_spirv_encoding = false;
+    bool has_failed = false;
+
+    // sizes of unique blobs, before and after compression and encoding
+    uint64_t num_raw_bytes = 0;
+    uint64_t num_stored_bytes = 0;
+
+    enum class entry_status : uint8_t
+    {
+        loaded,  // read from the archive by initialize_update
+        added,   // added since initialize
+        removed, // a tombstone, skipped when writing the index
+    };
+
+    std::vector<archive_entry> entries;
+    std::vector<entry_status> entry_statuses;
+    std::vector<char> strings;
+    // entry index per name and output, to replace entries that are added twice
+    std::unordered_map<std::string, size_t> entry_indices;
+
+    // in-place update of an existing archive (initialize_update)
+    bool is_update = false;
+    bool is_modified = false; // any entry was added, changed or removed
+    float compaction_threshold = 1.f;
+    uint32_t generation = 0;
+    uint64_t num_dead_bytes = 0; // of the existing archive
+    struct written_blob
+    {
+        uint64_t offset;
+        uint64_t raw_size;
+        uint64_t stored_size;
+        uint32_t checksum;    // of the stored bytes
+        uint16_t codec_flags; // archive_entry::codec_flags
+    };
+
+    // written blobs per content hash
+    std::unordered_map<uint64_t, std::vector<written_blob>> blobs_by_hash;
+    std::unordered_map<std::string, uint32_t> string_offsets;
+};
+
+namespace
+{
+// "<path>.<process id>.tmp", processes writing the same archive never share a temporary file
+std::string get_temp_path(std::string const& path)
+{
+#ifdef CC_OS_WINDOWS
+    auto const process_id = unsigned(::_getpid());
+#else
+    auto const process_id = unsigned(::getpid());
+#endif
+    return path + '.' + std::to_string(process_id) + ".tmp";
+}
+
+std::FILE* open_file_for_writing(char const* path)
+{
+#ifdef CC_OS_WINDOWS
+    std::FILE* fp = nullptr;
+    if (::fopen_s(&fp, path, "wb") != 0)
+    {
+        fp = nullptr;
+    }
+    return fp;
+#else
+    return std::fopen(path, "wb");
+#endif
+}
+
+std::FILE* open_file_for_update(char const* path)
+{
+#ifdef CC_OS_WINDOWS
+    std::FILE* fp = nullptr;
+    if (::fopen_s(&fp, path, "r+b") != 0)
+    {
+        fp = nullptr;
+    }
+    return fp;
+#else
+    return std::fopen(path, "r+b");
+#endif
+}
+
+bool seek_file(std::FILE* file, uint64_t offset)
+{
+#ifdef CC_OS_WINDOWS
+    return ::_fseeki64(file, int64_t(offset), SEEK_SET) == 0;
+#else
+    return ::fseeko(file, off_t(offset), SEEK_SET) == 0;
+#endif
+}
+
+// flushes the file and waits until its contents are durable
+bool sync_file(std::FILE* file)
+{
+    if (std::fflush(file) != 0)
+        return false;
+
+#ifdef CC_OS_WINDOWS
+    return ::_commit(::_fileno(file)) == 0;
+#else
+    return ::fsync(::fileno(file)) == 0;
+#endif
+}
+
+uint32_t get_header_checksum(dxcw::archive_header header)
+{
+    header.checksum = 0;
+    return dxcw::detail::crc32c(reinterpret_cast<std::byte const*>(&header), sizeof(header));
+}
+
+// written to both slots of a new archive, never chosen by readers as its checksum does not match
+// magic and version are the same in all headers, so they stay readable while a slot is overwritten
+dxcw::archive_header get_placeholder_header()
+{
+    dxcw::archive_header header = {};
+    header.magic = dxcw::archive_header::magic_value;
+    header.version = dxcw::archive_header::current_version;
+    header.checksum = ~get_header_checksum(header);
+    return header;
+}
+
+bool write_bytes(dxcw::detail::archive_writer_state& state, void const* data, size_t size)
+{
+    if (size > 0 && std::fwrite(data, 1, size, state.file) != size)
+    {
+        state.has_failed = true;
+        return false;
+    }
+
+    state.write_offset += size;
+    return true;
+}
+
+bool write_padding(dxcw::detail::archive_writer_state& state, uint64_t alignment)
+{
+    static constexpr char zeros[512] = {};
+
+    uint64_t num_padding = (alignment - state.write_offset % alignment) % alignment;
+    while (num_padding > 0)
+    {
+        auto const num_written = size_t(std::min<uint64_t>(num_padding, sizeof(zeros)));
+        if (!write_bytes(state, zeros, num_written))
+            return false;
+
+        num_padding -= num_written;
+    }
+
+    return true;
+}
+
+// encodes a blob according to the enabled codecs, returns the archive_entry codec flags of out_encoded, or 0 to store it raw
+uint16_t encode_blob(cc::span<std::byte const> data,
+                     dxcw::output output,
+                     bool enable_compression,
+                     bool enable_spirv_encoding,
+                     std::vector<std::byte>& out_encoded)
+{
+    using dxcw::archive_entry;
+
+    uint16_t codec_flags = 0;
+    std::vector<std::byte> spirv_encoded;
+    if (enable_spirv_encoding && output == dxcw::output::spirv)
+    {
+        spirv_encoded.resize(dxcw::detail::spirv_get_max_encoded_size(data.size()));
+        spirv_encoded.resize(dxcw::detail::spirv_encode(data.data(), data.size(), spirv_encoded.data()));
+
+        if (!spirv_encoded.empty())
+        {
+            data = cc::span<std::byte const>(spirv_encoded.data(), spirv_encoded.size());
+            codec_flags |= archive_entry::flag_spirv_encoded;
+        }
+    }
+
+    if (enable_compression)
+    {
+        // encoded modules are prefixed with their size, which is required for decompression
+        size_t const prefix_size = (codec_flags & archive_entry::flag_spirv_encoded) ? sizeof(uint32_t) : 0;
+        out_encoded.resize(prefix_size + dxcw::detail::lz_get_max_compressed_size(data.size()));
+        out_encoded.resize(prefix_size + dxcw::detail::lz_compress(data.data(), data.size(), out_encoded.data() + prefix_size));
+
+        if (prefix_size > 0)
+        {
+            auto const encoded_size = uint32_t(data.size());
+            std::memcpy(out_encoded.data(), &encoded_size, sizeof(encoded_size));
+        }
+
+        // keep the uncompressed (possibly SPIR-V encoded) data if it's smaller
+        if (out_encoded.size() < data.size())
+            codec_flags |= archive_entry::flag_compressed;
+        else
+            out_encoded.clear();
+    }
+
+    if (out_encoded.empty())
+        out_encoded = std::move(spirv_encoded);
+
+    return codec_flags;
+}
+
+uint32_t add_string(dxcw::detail::archive_writer_state& state, char const* str)
+{
+    auto const [it, is_new] = state.string_offsets.try_emplace(str, uint32_t(state.strings.size()));
+    if (is_new)
+    {
+        state.strings.insert(state.strings.end(), str, str + std::strlen(str) + 1);
+    }
+
+    return it->second;
+}
+
+// builds a minimal perfect hash (CHD) over the keys of the sorted entries
+// buckets of ~4 keys are placed in descending size, each searching a displacement that moves all of its keys to free slots
+bool build_perfect_hash(std::vector<dxcw::archive_entry> const& entries,
+                        uint64_t& out_seed,
+                        std::vector<uint32_t>& out_displacements,
+                        std::vector<uint32_t>& out_entry_indices)
+{
+    auto const num_entries = uint32_t(entries.size());
+    if (num_entries == 0)
+        return false;
+
+    std::vector<uint64_t> keys(num_entries);
+    for (auto i = 0u; i < num_entries; ++i)
+        keys[i] = dxcw::get_archive_key(entries[i].name_hash, entries[i].output);
+
+    // identical keys can't be separated (colliding name hashes)
+    {
+        auto sorted_keys = keys;
+        std::sort(sorted_keys.begin(), sorted_keys.end());
+        if (std::adjacent_find(sorted_keys.begin(), sorted_keys.end()) != sorted_keys.end())
+            return false;
+    }
+
+    uint32_t const num_buckets = (num_entries + 3) / 4;
+    uint32_t const max_displacement = num_entries * 64 + 1024;
+
+    std::vector<std::vector<uint32_t>> buckets(num_buckets);
+    std::vector<uint32_t> bucket_order(num_buckets);
+    std::vector<bool> is_slot_taken(num_entries);
+    std::vector<uint32_t> bucket_slots;
+
+    for (uint64_t seed = 0x5eed; seed < 0x5eed + 32; ++seed)
+    {
+        for (auto& bucket : buckets)
+            bucket.clear();
+
+        for (auto i = 0u; i < num_entries; ++i)
+            buckets[dxcw::get_archive_bucket(keys[i], seed, num_buckets)].push_back(i);
+
+        for (auto i = 0u; i < num_buckets; ++i)
+            bucket_order[i] = i;
+
+        std::stable_sort(bucket_order.begin(), bucket_order.end(),
+                         [&](uint32_t lhs, uint32_t rhs) { return buckets[lhs].size() > buckets[rhs].size(); });
+
+        std::fill(is_slot_taken.begin(), is_slot_taken.end(), false);
+        out_displacements.assign(num_buckets, 0);
+        out_entry_indices.assign(num_entries, 0);
+
+        bool success = true;
+        for (uint32_t const bucket_index : bucket_order)
+        {
+            auto const& bucket = buckets[bucket_index];
+            if (bucket.empty())
+                break;
+
+            bool found = false;
+            for (uint32_t displacement = 0; displacement < max_displacement && !found; ++displacement)
+            {
+                bucket_slots.clear();
+                found = true;
+                for (uint32_t const entry_index : bucket)
+                {
+                    auto const slot = dxcw::get_archive_slot(keys[entry_index], seed, displacement, num_entries);
+                    if (is_slot_taken[slot] || std::find(bucket_slots.begin(), bucket_slots.end(), slot) != bucket_slots.end())
+                    {
+                        found = false;
+                        break;
+                    }
+                    bucket_slots.push_back(slot);
+                }
+
+                if (found)
+                {
+                    out_displacements[bucket_index] = displacement;
+                    for (auto i = 0u; i < bucket.size(); ++i)
+                    {
+                        is_slot_taken[bucket_slots[i]] = true;
+                        out_entry_indices[bucket_slots[i]] = bucket[i];
+                    }
+                }
+            }
+
+            if (!found)
+            {
+                success = false;
+                break;
+            }
+        }
+
+        if (success)
+        {
+            out_seed = seed;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+uint64_t align_up(uint64_t value, uint64_t alignment) { return (value + alignment - 1) / alignment * alignment; }
+
+// end of an index, its strings and perfect hash written after blobs_end
+uint64_t get_index_end(uint64_t blobs_end, size_t num_entries, size_t strings_size)
+{
+    uint64_t end = align_up(blobs_end, alignof(dxcw::archive_entry)) + num_entries * sizeof(dxcw::archive_entry) + strings_size;
+    if (num_entries > 0)
+        end = align_up(end, alignof(uint32_t)) + ((num_entries + 3) / 4 + num_entries) * sizeof(uint32_t);
+
+    return end;
+}
+
+// size of the archive after compaction, when it only contains the blobs referenced by the entries
+uint64_t get_compacted_size(std::vector<dxcw::archive_entry> const& entries, size_t strings_size, uint32_t blob_alignment)
+{
+    std::vector<std::pair<uint64_t, uint64_t>> blobs; // offset and size
+    blobs.reserve(entries.size());
+    for (auto const& entry : entries)
+        blobs.emplace_back(entry.offset, entry.size);
+
+    std::sort(blobs.begin(), blobs.end());
+    blobs.erase(std::unique(blobs.begin(), blobs.end()), blobs.end());
+
+    uint64_t end = dxcw::archive_header::num_slots * sizeof(dxcw::archive_header);
+    for (auto const& blob : blobs)
+        end = align_up(end, blob_alignment) + blob.second;
+
+    return get_index_end(end, entries.size(), strings_size);
+}
+
+// all entries that are not tombstones
+std::vector<dxcw::archive_entry> get_live_entries(dxcw::detail::archive_writer_state const& state)
+{
+    using entry_status = dxcw::detail::archive_writer_state::entry_status;
+
+    std::vector<dxcw::archive_entry> entries;
+    entries.reserve(state.entries.size());
+    for (size_t i = 0; i < state.entries.size(); ++i)
+    {
+        if (state.entry_statuses[i] != entry_status::removed)
+            entries.push_back(state.entries[i]);
+    }
+
+    return entries;
+}
+
+// sorts the entries and writes the index, the strings and the perfect hash at the end of the file
+// fills the matching fields of the header, which is written last (see write_header)
+void write_index(dxcw::detail::archive_writer_state& state,
+                 std::vector<dxcw::archive_entry>& entries,
+                 std::vector<char> const& strings,
+                 dxcw::archive_header& header)
+{
+    using dxcw::archive_entry;
+
+    std::sort(entries.begin(), entries.end(),
+              [&](archive_entry const& lhs, archive_entry const& rhs)
+              {
+                  if (lhs.name_hash != rhs.name_hash)
+                      return lhs.name_hash < rhs.name_hash;
+                  if (lhs.output != rhs.output)
+                      return lhs.output < rhs.output;
+                  return std::strcmp(strings.data() + lhs.name_offset, strings.data() + rhs.name_offset) < 0;
+              });
+
+    header.num_entries = uint32_t(entries.size());
+
+    write_padding(state, alignof(archive_entry));
+    header.index_offset = state.write_offset;
+    write_bytes(state, entries.data(), entries.size() * sizeof(archive_entry));
+
+    header.strings_offset = state.write_offset;
+    header.strings_size = strings.size();
+    write_bytes(state, strings.data(), strings.size());
+
+    // readers fall back to binary search over the index without a perfect hash
+    uint64_t phf_seed = 0;
+    std::vector<uint32_t> phf_displacements;
+    std::vector<uint32_t> phf_entry_indices;
+    if (build_perfect_hash(entries, phf_seed, phf_displacements, phf_entry_indices))
+    {
+        write_padding(state, alignof(uint32_t));
+        header.phf_seed = phf_seed;
+        header.phf_offset = state.write_offset;
+        header.phf_num_buckets = uint32_t(phf_displacements.size());
+        write_bytes(state, phf_displacements.data(), phf_displacements.size() * sizeof(uint32_t));
+        write_bytes(state, phf_entry_indices.data(), phf_entry_indices.size() * sizeof(uint32_t));
+    }
+    else if (!entries.empty())
+    {
+        DXCW_LOG_WARN("failed to build a perfect hash for shader archive {}, lookups use binary search", state.path);
+    }
+}
+
+// writes the header to its slot once everything it references is durable, and syncs again so it is durable itself on success
+// the other slot keeps the previous header, readers fall back to it if this one is torn by a crash
+bool write_header(dxcw::detail::archive_writer_state& state, dxcw::archive_header header)
+{
+    if (state.has_failed)
+        return false;
+
+    header.checksum = get_header_checksum(header);
+    uint64_t const slot_offset = uint64_t(header.generation % dxcw::archive_header::num_slots) * sizeof(header);
+
+    if (!sync_file(state.file) || !seek_file(state.file, slot_offset) || std::fwrite(&header, sizeof(header), 1, state.file) != 1
+        || !sync_file(state.file))
+        state.has_failed = true;
+
+    return !state.has_failed;
+}
+
+// writes the blobs referenced by the entries and a new index to a temporary file, which then replaces the archive
+// on failure the archive is unchanged and stays open for appending
+bool compact_archive_file(dxcw::detail::archive_writer_state& state, std::vector<dxcw::archive_entry> entries)
+{
+    using dxcw::archive_entry;
+    using dxcw::archive_header;
+
+    auto const temp_path = get_temp_path(state.path);
+
+    dxcw::detail::archive_writer_state compacted;
+    compacted.path = state.path;
+    compacted.blob_alignment = state.blob_alignment;
+    compacted.file = open_file_for_writing(temp_path.c_str());
+    if (!compacted.file)
+    {
+        DXCW_LOG_ERROR("failed to compact shader archive {}, can't create {}", state.path, temp_path);
+        return false;
+    }
+
+    archive_header header = {};
+    header.magic = archive_header::magic_value;
+    header.version = archive_header::current_version;
+    header.blob_alignment = state.blob_alignment;
+    header.generation = state.generation + 1;
+
+    archive_header const placeholder = get_placeholder_header();
+    for (auto slot = 0u; slot < archive_header::num_slots; ++slot)
+        write_bytes(compacted, &placeholder, sizeof(placeholder));
+
+    // blobs in file order, blobs shared by multiple entries are copied once
+    std::vector<size_t> order(entries.size());
+    for (size_t i = 0; i < order.size(); ++i)
+        order[i] = i;
+
+    std::sort(order.begin(), order.end(), [&](size_t lhs, size_t rhs) { return entries[lhs].offset < entries[rhs].offset; });
+
+    std::vector<std::byte> blob;
+    uint64_t previous_offset = ~uint64_t(0);
+    uint64_t compacted_offset = 0;
+    for (size_t const i : order)
+    {
+        auto& entry = entries[i];
+        if (entry.offset != previous_offset)
+        {
+            previous_offset = entry.offset;
+            blob.resize(size_t(entry.size));
+            if (!seek_file(state.file, entry.offset) || std::fread(blob.data(), 1, blob.size(), state.file) != blob.size())
+            {
+                compacted.has_failed = true;
+                break;
+            }
+
+            // a damaged blob would otherwise be carried over with a valid index
+            if (dxcw::detail::crc32c(blob.data(), blob.size()) != entry.checksum)
+            {
+                DXCW_LOG_ERROR("blob of {} in shader archive {} is corrupt", state.strings.data() + entry.name_offset, state.path);
+                compacted.has_failed = true;
+                break;
+            }
+
+            write_padding(compacted, compacted.blob_alignment);
+            compacted_offset = compacted.write_offset;
+            write_bytes(compacted, blob.data(), blob.size());
+        }
+
+        // strings of removed entries are dropped
+        entry.offset = compacted_offset;
+        entry.name_offset = add_string(compacted, state.strings.data() + entry.name_offset);
+        entry.entrypoint_offset = add_string(compacted, state.strings.data() + entry.entrypoint_offset);
+    }
+
+    if (!compacted.has_failed)
+    {
+        write_index(compacted, entries, compacted.strings, header);
+        write_header(compacted, header);
+    }
+
+    bool success = std::fclose(compacted.file) == 0 && !compacted.has_failed;
+    compacted.file = nullptr;
+
+    std::error_code ec;
+    if (success)
+    {
+        // open files can't be replaced on Windows
+        std::fclose(state.file);
+        std::filesystem::rename(temp_path, state.path, ec);
+        state.file = ec ? open_file_for_update(state.path.c_str()) : nullptr;
+        success = !ec;
+    }
+
+    if (!success)
+    {
+        std::filesystem::remove(temp_path, ec);
+        DXCW_LOG_ERROR("failed to compact shader archive {}", state.path);
+
+        // reading moved the file position
+        if (!state.file || !seek_file(state.file, state.write_offset))
+            state.has_failed = true;
+
+        return false;
+    }
+
+    DXCW_LOG("compacted shader archive {} ({} binaries, {} to {} bytes)", state.path, entries.size(), state.write_offset, compacted.write_offset);
+    return true;
+}
+}
+
+uint64_t dxcw::hash_archive_name(char const* name) { return hash_archive_name(name, std::strlen(name)); }
+
+uint64_t dxcw::hash_archive_content(std::byte const* data, size_t size)
+{
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (auto i = 0u; i < size; ++i)
+    {
+        hash ^= uint8_t(data[i]);
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+bool dxcw::read_archive_header(std::byte const* data, size_t size, char const* path, archive_header& out_header)
+{
+    if (size < archive_header::num_slots * sizeof(archive_header))
+    {
+        DXCW_LOG_ERROR("shader archive {} is truncated", path);
+        return false;
+    }
+
+    // each slot is copied once, the copies are checked and the chosen one is returned
+    archive_header slots[archive_header::num_slots];
+    std::memcpy(slots, data, sizeof(slots));
+
+    if (slots[0].magic != archive_header::magic_value)
+    {
+        DXCW_LOG_ERROR("{} is not a shader archive", path);
+        return false;
+    }
+
+    if (slots[0].version != archive_header::current_version)
+    {
+        DXCW_LOG_ERROR("shader archive {} has version {}, expected {}", path, slots[0].version, archive_header::current_version);
+        return false;
+    }
+
+    archive_header const* newest = nullptr;
+    archive_header const* newest_within_size = nullptr;
+    for (auto const& slot : slots)
+    {
+        bool const is_valid = slot.magic == archive_header::magic_value && slot.version == archive_header::current_version
+                              && slot.checksum == get_header_checksum(slot);
+        if (!is_valid)
+            continue;
+
+        if (!newest || slot.generation > newest->generation)
+            newest = &slot;
+
+        if (get_archive_index_end(slot) <= size && (!newest_within_size || slot.generation > newest_within_size->generation))
+            newest_within_size = &slot;
+    }
+
+    if (!newest)
+    {
+        DXCW_LOG_ERROR("shader archive {} has no intact header, it was not finalized or its last update was interrupted", path);
+        return false;
+    }
+
+    out_header = newest_within_size ? *newest_within_size : *newest;
+    return true;
+}
+
+uint64_t dxcw::get_archive_index_end(archive_header const& header)
+{
+    auto const f_end = [](uint64_t offset, uint64_t size) { return offset > ~uint64_t(0) - size ? ~uint64_t(0) : offset + size; };
+
+    uint64_t end = f_end(header.index_offset, uint64_t(header.num_entries) * sizeof(archive_entry));
+    end = std::max(end, f_end(header.strings_offset, header.strings_size));
+    if (header.phf_num_buckets > 0)
+        end = std::max(end, f_end(header.phf_offset, (uint64_t(header.phf_num_buckets) + header.num_entries) * sizeof(uint32_t)));
+
+    return end;
+}
+
+bool dxcw::validate_archive(archive_header const& header, std::byte const* data, size_t size, char const* path)
+{
+    if (size < archive_header::num_slots * sizeof(archive_header))
+    {
+        DXCW_LOG_ERROR("shader archive {} is truncated", path);
+        return false;
+    }
+
+    if (header.magic != archive_header::magic_value)
+    {
+        DXCW_LOG_ERROR("{} is not a shader archive", path);
+        return false;
+    }
+
+    if (header.version != archive_header::current_version)
+    {
+        DXCW_LOG_ERROR("shader archive {} has version {}, expected {}", path, header.version, archive_header::current_version);
+        return false;
+    }
+
+    uint64_t const index_size = uint64_t(header.num_entries) * sizeof(archive_entry);
+    if (header.index_offset % alignof(archive_entry) != 0 || header.index_offset > size || index_size > size - header.index_offset
+        || header.strings_offset > size || header.strings_size > size - header.strings_offset
+        || (header.strings_size > 0 && char(data[header.strings_offset + header.strings_size - 1]) != '\0'))
+    {
+        DXCW_LOG_ERROR("shader archive {} has an invalid index", path);
+        return false;
+    }
+
+    // the index is small compared to the blobs, validating it up front keeps lookups free of checks
+    auto const* const entries = reinterpret_cast<archive_entry const*>(data + header.index_offset);
+    for (auto i = 0u; i < header.num_entries; ++i)
+    {
+        auto const& entry = entries[i];
+        bool const is_encoded = (entry.flags & archive_entry::codec_flags) != 0;
+        if (entry.offset > size || entry.size > size - entry.offset || entry.name_offset >= header.strings_size
+            || entry.entrypoint_offset >= header.strings_size || (!is_encoded && entry.raw_size != entry.size))
+        {
+            DXCW_LOG_ERROR("shader archive {} has an invalid entry #{}", path, i);
+            return false;
+        }
+    }
+
+    if (header.phf_num_buckets > 0)
+    {
+        uint64_t const phf_size = (uint64_t(header.phf_num_buckets) + header.num_entries) * sizeof(uint32_t);
+        if (header.phf_offset % alignof(uint32_t) != 0 || header.phf_offset > size || phf_size > size - header.phf_offset)
+        {
+            DXCW_LOG_ERROR("shader archive {} has an invalid perfect hash", path);
+            return false;
+        }
+
+        auto const* const entry_indices = reinterpret_cast<uint32_t const*>(data + header.phf_offset) + header.phf_num_buckets;
+        for (auto i = 0u; i < header.num_entries; ++i)
+        {
+            if (entry_indices[i] >= header.num_entries)
+            {
+                DXCW_LOG_ERROR("shader archive {} has an invalid perfect hash", path);
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+bool dxcw::compact_archive(char const* path)
+{
+    CC_CONTRACT(path);
+
+    std::error_code ec;
+    if (!std::filesystem::is_regular_file(path, ec))
+    {
+        DXCW_LOG_ERROR("shader archive {} does not exist", path);
+        return false;
+    }
+
+    // initialize_update writes a new archive in place of an invalid one, which must not happen here
+    {
+        detail::mapped_file existing;
+        archive_header header;
+        bool const is_valid = existing.map(path) && read_archive_header(existing.data, existing.size, path, header)
+                              && validate_archive(header, existing.data, existing.size, path);
+        existing.unmap();
+
+        if (!is_valid)
+        {
+            DXCW_LOG_ERROR("can't compact shader archive {}, it is left unchanged", path);
+            return false;
+        }
+    }
+
+    archive_writer writer;
+    if (!writer.initialize_update(path, nullptr, false, false, 0.f))
+        return false;
+
+    return writer.finalize();
+}
+
+bool dxcw::archive_writer::initialize(char const* path,
+                                      char const* base_path,
+                                      uint32_t blob_alignment,
+                                      bool enable_compression,
+                                      bool enable_spirv_encoding)
+{
+    CC_CONTRACT(path);
+    CC_ASSERT(_state == nullptr && "double initialize");
+    CC_ASSERT(blob_alignment > 0 && "invalid blob alignment");
+
+    std::error_code ec;
+    std::filesystem::create_directories(std::filesystem::path(path).remove_filename(), ec);
+
+    // the previous archive stays intact until the new one is complete
+    auto temp_path = get_temp_path(path);
+    std::FILE* const file = open_file_for_writing(temp_path.c_str());
+    if (!file)
+    {
+        DXCW_LOG_ERROR("failed to create shader archive at {}", temp_path);
+        return false;
+    }
+
+    _state = new detail::archive_writer_state();
+    _state->file = file;
+    _state->path = path;
+    _state->temp_path = std::move(temp_path);
+    _state->base_path = base_path ? base_path : "";
+    std::replace(_state->base_path.begin(), _state->base_path.end(), '\\', '/');
+    _state->blob_alignment = blob_alignment;
+    _state->enable_compression = enable_compression;
+    _state->enable_spirv_encoding = enable_spirv_encoding;
+
+    // placeholder headers, the first one is written in finalize()
+    archive_header const placeholder = get_placeholder_header();
+    for (auto slot = 0u; slot < archive_header::num_slots; ++slot)
+        write_bytes(*_state, &placeholder, sizeof(placeholder));
+
+    return !_state->has_failed;
+}
+
+bool dxcw::archive_writer::initialize_update(char const* path,
+                                             char const* base_path,
+                                             bool enable_compression,
+                                             bool enable_spirv_encoding,
+                                             float compaction_threshold)
+{
+    CC_CONTRACT(path);
+    CC_ASSERT(_state == nullptr && "double initialize");
+
+    std::error_code ec;
+    if (!std::filesystem::is_regular_file(path, ec))
+        return initialize(path, base_path, 4096, enable_compression, enable_spirv_encoding);
+
+    detail::mapped_file existing;
+    archive_header header;
+    if (!existing.map(path) || !read_archive_header(existing.data, existing.size, path, header)
+        || !validate_archive(header, existing.data, existing.size, path))
+    {
+        existing.unmap();
+        DXCW_LOG_WARN("can't update shader archive {}, writing a new one", path);
+        return initialize(path, base_path, 4096, enable_compression, enable_spirv_encoding);
+    }
+
+    std::FILE* const file = open_file_for_update(path);
+    if (!file || !seek_file(file, existing.size))
+    {
+        if (file)
+            std::fclose(file);
+
+        existing.unmap();
+        DXCW_LOG_ERROR("failed to open shader archive {} for updating", path);
+        return false;
+    }
+
+    _state = new detail::archive_writer_state();
+    auto& state = *_state;
+    state.file = file;
+    state.path = path;
+    state.base_path = base_path ? base_path : "";
+    std::replace(state.base_path.begin(), state.base_path.end(), '\\', '/');
+    state.blob_alignment = header.blob_alignment;
+    state.enable_compression = enable_compression;
+    state.enable_spirv_encoding = enable_spirv_encoding;
+    state.write_offset = existing.size;
+
+    state.is_update = true;
+    state.compaction_threshold = compaction_threshold;
+    state.generation = header.generation;
+    state.num_dead_bytes = header.num_dead_bytes;
+
+    auto const* const strings = reinterpret_cast<char const*>(existing.data + header.strings_offset);
+    state.strings.assign(strings, strings + header.strings_size);
+    for (size_t offset = 0; offset < state.strings.size(); offset += std::strlen(state.strings.data() + offset) + 1)
+        state.string_offsets.try_emplace(state.strings.data() + offset, uint32_t(offset));
+
+    auto const* const entries = reinterpret_cast<archive_entry const*>(existing.data + header.index_offset);
+    state.entries.assign(entries, entries + header.num_entries);
+    state.entry_statuses.assign(header.num_entries, detail::archive_writer_state::entry_status::loaded);
+
+    for (size_t i = 0; i < state.entries.size(); ++i)
+    {
+        auto const& entry = state.entries[i];
+
+        std::string key = state.strings.data() + entry.name_offset;
+        key.push_back('\0');
+        key.push_back(char(entry.output));
+        state.entry_indices.try_emplace(std::move(key), i);
+
+        // existing blobs are reused by identical binaries
+        auto& blobs = state.blobs_by_hash[entry.content_hash];
+        if (std::none_of(blobs.begin(), blobs.end(), [&](auto const& blob) { return blob.offset == entry.offset; }))
+        {
+            blobs.push_back(detail::archive_writer_state::written_blob{entry.offset, entry.raw_size, entry.size, entry.checksum,
+                                                                       uint16_t(entry.flags & archive_entry::codec_flags)});
+        }
+    }
+
+    existing.unmap();
+    return true;
+}
+
+bool dxcw::archive_writer::add(char const* output_path,
+                               char const* entrypoint,
+                               dxcw::target target,
+                               dxcw::output output,
+                               cc::span<std::byte const> data,
+                               uint16_t flags,
+                               bool allow_compression)
+{
+    CC_CONTRACT(output_path);
+    CC_ASSERT(_state != nullptr && "Uninitialized dxcw::archive_writer");
+    CC_ASSERT(data.size() <= 0xFFFFFFFFu && "archive blobs are limited to 4 GiB");
+
+    auto const name = detail::get_entry_name(_state->base_path, output_path);
+    auto const content_hash = hash_archive_content(data.data(), data.size());
+
+    // encode outside of the lock, blobs are only stored encoded if that saves at least 1/16
+    std::vector<std::byte> encoded;
+    uint16_t codec_flags = 0;
+    if (allow_compression && data.size() > 0)
+    {
+        codec_flags = encode_blob(data, output, _state->enable_compression, _state->enable_spirv_encoding, encoded);
+
+        if (encoded.size() > data.size() - data.size() / 16)
+            codec_flags = 0;
+    }
+
+    cc::span<std::byte const> const stored_data = codec_flags != 0 ? cc::span<std::byte const>(encoded.data(), encoded.size()) : data;
+    uint32_t const checksum = detail::crc32c(stored_data.data(), stored_data.size());
+
+    std::lock_guard lg(_state->mutex);
+    auto& state = *_state;
+
+    // reuse identical blobs
+    detail::archive_writer_state::written_blob const* blob = nullptr;
+    auto& blobs = state.blobs_by_hash[content_hash];
+    for (auto const& written : blobs)
+    {
+        if (written.raw_size == data.size())
+        {
+            blob = &written;
+            break;
+        }
+    }
+
+    if (!blob)
+    {
+        if (!write_padding(state, state.blob_alignment))
+            return false;
+
+        uint64_t const blob_offset = state.write_offset;
+        if (!write_bytes(state, stored_data.data(), stored_data.size()))
+        {
+            DXCW_LOG_ERROR("failed to write {} to shader archive {}", name, state.path);
+            return false;
+        }
+
+        state.num_raw_bytes += data.size();
+        state.num_stored_bytes += stored_data.size();
+        blob = &blobs.emplace_back(detail::archive_writer_state::written_blob{blob_offset, data.size(), stored_data.size(), checksum, codec_flags});
+    }
+
+    archive_entry entry = {};
+    entry.name_hash = hash_archive_name(name.c_str(), name.size());
+    entry.content_hash = content_hash;
+    entry.offset = blob->offset;
+    entry.size = blob->stored_size;
+    entry.raw_size = uint32_t(blob->raw_size);
+    entry.checksum = blob->checksum;
+    entry.name_offset = add_string(state, name.c_str());
+    entry.entrypoint_offset = add_string(state, entrypoint ? entrypoint : "");
+    entry.target = target;
+    entry.output = output;
+    entry.flags = uint16_t((flags & ~archive_entry::codec_flags) | blob->codec_flags);
+
+    auto key = name;
+    key.push_back('\0');
+    key.push_back(char(output));
+
+    using entry_status = detail::archive_writer_state::entry_status;
+
+    auto const [it, is_new] = state.entry_indices.try_emplace(std::move(key), state.entries.size());
+    if (is_new)
+    {
+        state.entries.push_back(entry);
+        state.entry_statuses.push_back(entry_status::added);
+        state.is_modified = true;
+    }
+    else
+    {
+        auto& existing = state.entries[it->second];
+        auto& status = state.entry_statuses[it->second];
+        if (status == entry_status::removed || std::memcmp(&existing, &entry, sizeof(entry)) != 0)
+            state.is_modified = true;
+
+        existing = entry;
+        status = entry_status::added;
+    }
+
+    return true;
+}
+
+bool dxcw::archive_writer::remove(char const* output_path, dxcw::output output)
+{
+    CC_CONTRACT(output_path);
+    CC_ASSERT(_state != nullptr && "Uninitialized dxcw::archive_writer");
+    using entry_status = detail::archive_writer_state::entry_status;
+
+    auto key = detail::get_entry_name(_state->base_path, output_path);
+    key.push_back('\0');
+    key.push_back(char(output));
+
+    std::lock_guard lg(_state->mutex);
+    auto& state = *_state;
+
+    auto const it = state.entry_indices.find(key);
+    if (it == state.entry_indices.end() || state.entry_statuses[it->second] == entry_status::removed)
+        return false;
+
+    state.entry_statuses[it->second] = entry_status::removed;
+    state.is_modified = true;
+    return true;
+}
+
+unsigned dxcw::archive_writer::remove_stale_entries()
+{
+    CC_ASSERT(_state != nullptr && "Uninitialized dxcw::archive_writer");
+    using entry_status = detail::archive_writer_state::entry_status;
+
+    std::lock_guard lg(_state->mutex);
+    auto& state = *_state;
+
+    unsigned num_removed = 0;
+    for (auto& status : state.entry_statuses)
+    {
+        if (status == entry_status::loaded)
+        {
+            status = entry_status::removed;
+            ++num_removed;
+        }
+    }
+
+    if (num_removed > 0)
+        state.is_modified = true;
+
+    return num_removed;
+}
+
+bool dxcw::archive_writer::finalize()
+{
+    CC_ASSERT(_state != nullptr && "Uninitialized dxcw::archive_writer");
+    auto& state = *_state;
+
+    auto entries = get_live_entries(state);
+
+    archive_header header = {};
+    header.magic = archive_header::magic_value;
+    header.version = archive_header::current_version;
+    header.blob_alignment = state.blob_alignment;
+
+    if (state.is_update)
+    {
+        if (!state.is_modified)
+        {
+            // the existing index stays valid, only compact if the archive was left with too much unreferenced space
+            bool success = true;
+            if (state.num_dead_bytes > 0 && double(state.num_dead_bytes) > double(state.compaction_threshold) * double(state.write_offset))
+                success = compact_archive_file(state, std::move(entries));
+            else
+                DXCW_LOG("shader archive {} is up to date ({} binaries)", state.path, entries.size());
+
+            destroy();
+            return success;
+        }
+
+        // superseded blobs and the previous index are no longer referenced after this update
+        uint64_t const updated_size = get_index_end(state.write_offset, entries.size(), state.strings.size());
+        uint64_t const compacted_size = get_compacted_size(entries, state.strings.size(), state.blob_alignment);
+        uint64_t const num_dead_bytes = updated_size > compacted_size ? updated_size - compacted_size : 0;
+
+        if (double(num_dead_bytes) > double(state.compaction_threshold) * double(updated_size) && compact_archive_file(state, entries))
+        {
+            destroy();
+            return true;
+        }
+
+        header.generation = state.generation + 1;
+        header.num_dead_bytes = num_dead_bytes;
+    }
+
+    write_index(state, entries, state.strings, header);
+    write_header(state, header);
+
+    // a new archive replaces the file at its path once complete
+    if (!state.has_failed && !state.temp_path.empty())
+    {
+        bool const closed = std::fclose(state.file) == 0;
+        state.file = nullptr;
+
+        std::error_code ec;
+        if (closed)
+            std::filesystem::rename(state.temp_path, state.path, ec);
+
+        if (closed && !ec)
+            state.temp_path.clear();
+        else
+            state.has_failed = true;
+    }
+
+    bool const success = !state.has_failed;
+    if (success && state.is_update)
+        DXCW_LOG("updated shader archive {} ({} binaries, {} bytes, {} unreferenced)", state.path, entries.size(), state.write_offset,
+                 header.num_dead_bytes);
+    else if (success && (state.enable_compression || state.enable_spirv_encoding))
+        DXCW_LOG("wrote shader archive {} ({} binaries, {} bytes, blobs compressed from {} to {} bytes)", state.path, entries.size(),
+                 state.write_offset, state.num_raw_bytes, state.num_stored_bytes);
+    else if (success)
+        DXCW_LOG("wrote shader archive {} ({} binaries, {} bytes)", state.path, entries.size(), state.write_offset);
+    else
+        DXCW_LOG_ERROR("failed to write shader archive {}", state.path);
+
+    destroy();
+    return success;
+}
+
+bool dxcw::archive_writer::write_id_header(char const* path, char const* namespace_name) const
+{
+    CC_CONTRACT(path);
+    CC_CONTRACT(namespace_name);
+    CC_ASSERT(_state != nullptr && "Uninitialized dxcw::archive_writer");
+    auto const& state = *_state;
+
+    // one constant per name, outputs of the same name share it
+    std::vector<std::pair<std::string, uint64_t>> names;
+    for (auto const& entry : get_live_entries(state))
+        names.emplace_back(state.strings.data() + entry.name_offset, entry.name_hash);
+
+    std::sort(names.begin(), names.end());
+    names.erase(std::unique(names.begin(), names.end()), names.end());
+
+    std::string content = "// generated by dxc-wrapper, do not edit\n"
+                          "// name hashes of shader archive entries, usable with dxcw::shader_store::find_entry(name_hash, output)\n\n"
+                          "#pragma once\n\n"
+                          "#include <cstdint>\n\n";
+    content.append("namespace ").append(namespace_name).append("\n{\n");
+
+    std::unordered_map<std::string, std::string const*> identifiers;
+    char hash_text[32];
+    for (auto const& [name, hash] : names)
+    {
+        // replace everything that is not valid in an identifier
+        std::string identifier = name;
+        for (auto& c : identifier)
+        {
+            if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_'))
+                c = '_';
+        }
+
+        if (identifier.empty() || (identifier[0] >= '0' && identifier[0] <= '9'))
+            identifier.insert(0, "_");
+
+        auto const [it, is_new] = identifiers.try_emplace(identifier, &name);
+        if (!is_new)
+        {
+            DXCW_LOG_WARN("shader archive names \"{}\" and \"{}\" map to the same identifier {}, skipping the latter", *it->second, name, identifier);
+            continue;
+        }
+
+        std::snprintf(hash_text, sizeof(hash_text), "0x%016llxull", static_cast<unsigned long long>(hash));
+        content.append("inline constexpr uint64_t ").append(identifier).append(" = ").append(hash_text).append("; // ").append(name).append("\n");
+    }
+
+    content.append("}\n");
+
+    std::error_code ec;
+    std::filesystem::create_directories(std::filesystem::path(path).remove_filename(), ec);
+
+    std::FILE* const file = open_file_for_writing(path);
+    if (!file)
+    {
+        DXCW_LOG_ERROR("failed to write shader archive id header to {}", path);
+        return false;
+    }
+
+    bool const success = std::fwrite(content.data(), 1, content.size(), file) == content.size();
+    std::fclose(file);
+    return success;
+}
+
+void dxcw::archive_writer::destroy()
+{
+    if (_state == nullptr)
+        return;
+
+    if (_state->file)
+        std::fclose(_state->file);
+
+    // an unfinished new archive is discarded
+    if (!_state->temp_path.empty())
+    {
+        std::error_code ec;
+        std::filesystem::remove(_state->temp_path, ec);
+    }
+
+    delete _state;
+    _state = nullptr;
+}
@@ -0,0 +1,237 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <clean-core/fwd.hh>
+#include <clean-core/span.hh>
+
+#include <dxc-wrapper/common/api.hh>
+#include <dxc-wrapper/fwd.hh>
+
+namespace dxcw
+{
+namespace detail
+{
+struct archive_writer_state;
+}
+
+/// packed shader archive, a single file containing many binaries
+///
+/// layout:
+/// [archive_header slot 0][archive_header slot 1][padding][blob][padding][blob]...[archive_entry index][string table]
+///
+/// blobs start at multiples of archive_header::blob_alignment (the page size by default) so they can be used directly from a mapping
+/// the index is sorted by (name_hash, output, name) and written after all blobs, the header is written last
+/// blobs are optionally compressed per entry (see common/lz.hh), SPIR-V can additionally be encoded (see common/spirv_codec.hh)
+/// entries that don't shrink are stored raw
+/// each entry holds a CRC-32C of its stored blob (see common/crc32c.hh), readers verify it before the blob is first used
+/// if present, a minimal perfect hash over the (name_hash, output) keys follows the string table (see get_archive_slot)
+/// all values are little endian
+///
+/// archives can be updated in place (see archive_writer::initialize_update), updates are append-only:
+/// new blobs and a new index are written after the existing data, then a header referencing the new index is written
+/// superseded blobs and indices stay in the file as unreferenced space until the archive is compacted
+/// headers are the only part that is ever overwritten, a reader that copied one keeps a consistent view of its index
+///
+/// headers alternate between two slots (generation % num_slots), each protected by a checksum
+/// the file is synced before and after a header is written, so a header never becomes durable before the index it references
+/// a header torn by a crash fails its checksum, readers then use the other slot, which still references the previous index
+struct archive_header
+{
+    static constexpr uint32_t magic_value = 0x41435844; // "DXCA"
+    static constexpr uint32_t current_version = 4;
+    static constexpr unsigned num_slots = 2;
+
+    uint32_t magic;
+    uint32_t version;
+    uint32_t num_entries;
+    uint32_t blob_alignment;
+
+    uint64_t index_offset;   // archive_entry[num_entries]
+    uint64_t strings_offset; // null-terminated names and entrypoints, referenced by offset
+    uint64_t strings_size;
+
+    // minimal perfect hash (CHD), no perfect hash if phf_num_buckets is 0
+    uint64_t phf_seed;
+    uint64_t phf_offset; // uint32_t displacements[phf_num_buckets], followed by uint32_t entry_indices[num_entries] (index entry per slot)
+    uint32_t phf_num_buckets;
+
+    uint32_t generation;     // incremented by every update and compaction, readers use the valid slot with the highest generation
+    uint64_t num_dead_bytes; // unreferenced bytes (superseded blobs and indices), reclaimed by compaction
+
+    uint32_t checksum; // CRC-32C of the header with checksum set to 0
+    uint32_t reserved32;
+    uint64_t reserved[6];
+};
+
+static_assert(sizeof(archive_header) == 128, "archive_header layout changed");
+
+struct archive_entry
+{
+    enum flags : uint16_t
+    {
+        flag_library = 1 << 0,    // a library binary, target is meaningless and there is no entrypoint
+        flag_compressed = 1 << 1,    // the blob is an LZ block of raw_size bytes
+        flag_spirv_encoded = 1 << 2, // the blob is an encoded SPIR-V module of raw_size bytes
+                                     // with flag_compressed: a uint32_t encoded size followed by an LZ block of the encoded module
+
+        codec_flags = flag_compressed | flag_spirv_encoded,
+    };
+
+    uint64_t name_hash;    // hash_archive_name of the name
+    uint64_t content_hash; // hash_archive_content of the blob
+    uint64_t offset;       // blob offset from the start of the file
+    uint64_t size;         // stored blob size in bytes
+
+    uint32_t name_offset;       // output path relative to the archive base path without file ending, ie. "bin/mat_ps__WITH_IBL_1"
+    uint32_t entrypoint_offset; // entrypoint name, empty for libraries
+
+    dxcw::target target;
+    dxcw::output output;
+    uint16_t flags;
+    uint32_t raw_size; // decompressed size in bytes, equal to size if not compressed
+
+    uint32_t checksum; // CRC-32C of the stored blob
+    uint32_t reserved;
+};
+
+static_assert(sizeof(archive_entry) == 56, "archive_entry layout changed");
+
+/// hash of an archive entry name (64 bit FNV-1a), can be evaluated at compile time
+constexpr uint64_t hash_archive_name(char const* name, size_t length)
+{
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < length; ++i)
+    {
+        hash ^= uint8_t(name[i]);
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+DXCW_API uint64_t hash_archive_name(char const* name);
+
+/// perfect hash key of an archive entry
+constexpr uint64_t get_archive_key(uint64_t name_hash, dxcw::output output) { return name_hash ^ ((uint64_t(output) + 1) * 0x9e3779b97f4a7c15ull); }
+
+/// 64 bit finalizer (splitmix64) of a key and seed
+constexpr uint64_t mix_archive_hash(uint64_t key, uint64_t seed)
+{
+    uint64_t x = key ^ seed;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+/// CHD lookup: the bucket of a key selects a displacement, key and displacement select the slot in [0, num_entries)
+constexpr uint32_t get_archive_bucket(uint64_t key, uint64_t seed, uint32_t num_buckets)
+{
+    return uint32_t(mix_archive_hash(key, seed) % num_buckets);
+}
+
+constexpr uint32_t get_archive_slot(uint64_t key, uint64_t seed, uint32_t displacement, uint32_t num_entries)
+{
+    return uint32_t(mix_archive_hash(key, ~seed + (uint64_t(displacement) + 1) * 0x9e3779b97f4a7c15ull) % num_entries);
+}
+
+/// hash of an archive blob (64 bit FNV-1a) before compression
+DXCW_API uint64_t hash_archive_content(std::byte const* data, size_t size);
+
+/// copies the current header of an archive in memory: the slot with a matching checksum and the highest generation whose index lies within size,
+/// or the valid slot with the highest generation if no index lies within size (see get_archive_index_end)
+/// logs and returns false if the data is too small, not an archive of the current version, or no slot is valid
+/// updates overwrite header slots in place (see archive_writer::initialize_update), readers must only use the copy afterwards
+DXCW_API bool read_archive_header(std::byte const* data, size_t size, char const* path, archive_header& out_header);
+
+/// end of the index, string table and perfect hash referenced by a header, saturated on overflow
+/// beyond the mapped size if the archive was updated after it was mapped, the mapping then lacks the new index
+DXCW_API uint64_t get_archive_index_end(archive_header const& header);
+
+/// checks a header copied by read_archive_header and the index and perfect hash it references against the archive in memory
+/// logs the first problem found, blobs are not read, path is only used for the log
+DXCW_API bool validate_archive(archive_header const& header, std::byte const* data, size_t size, char const* path);
+
+/// rewrites an archive in place without its unreferenced space (see archive_header::num_dead_bytes)
+/// the compacted archive is written next to it and renamed over it, readers that mapped it before keep the old file
+/// returns false if the archive can't be read or replaced, it is unchanged in that case
+DXCW_API bool compact_archive(char const* path);
+
+/// writes a packed shader archive
+///
+/// binaries are written as they are added, from any amount of threads, only the index is kept in memory until finalize()
+/// identical blobs (ie. aliased permutations) are stored once and referenced by multiple entries
+/// with compression or SPIR-V encoding enabled, each blob is encoded on the adding thread and stored raw if that doesn't save enough
+///
+/// Usage:
+/// dxcw::archive_writer writer;
+/// writer.initialize("res/bin/shaders.dxca", "res/");
+/// writer.add("res/bin/shader_vs", "main_vs", dxcw::target::vertex, dxcw::output::spirv, data);
+/// writer.finalize();
+///
+/// updating an existing archive, only changed binaries are written:
+/// writer.initialize_update("res/bin/shaders.dxca", "res/");
+/// writer.add("res/bin/shader_vs", "main_vs", dxcw::target::vertex, dxcw::output::spirv, data);
+/// writer.remove_stale_entries(); // optional, drops everything that was not added again
+/// writer.finalize();
+struct DXCW_API archive_writer
+{
+public:
+    /// creates the archive in a temporary file next to path, which replaces the file at path in finalize()
+    /// returns false if it can't be opened
+    /// names of added binaries are their output paths relative to base_path, which is usually the directory of the shaderlist
+    /// enable_spirv_encoding applies to binaries added with output::spirv, and can be combined with compression
+    bool initialize(char const* path,
+                    char const* base_path,
+                    uint32_t blob_alignment = 4096,
+                    bool enable_compression = false,
+                    bool enable_spirv_encoding = false);
+
+    /// opens an existing archive for an append-only update, its entries are kept unless they are added again or removed
+    /// blobs identical to existing ones are not written again, the blob alignment of the existing archive is used
+    /// finalize() compacts the archive instead if its unreferenced space would exceed compaction_threshold of the file size
+    /// (0 - compact on any change, >= 1 - never)
+    /// creates a new archive if there is none at path or it is not a valid archive, returns false if it can't be opened
+    bool initialize_update(char const* path,
+                           char const* base_path,
+                           bool enable_compression = false,
+                           bool enable_spirv_encoding = false,
+                           float compaction_threshold = 0.5f);
+
+    /// writes a binary to the archive, output_path without file ending
+    /// an existing entry with the same name and output is replaced
+    /// allow_compression = false stores the blob raw even if compression or encoding is enabled, ie. for data that is already compressed
+    bool add(char const* output_path,
+             char const* entrypoint,
+             dxcw::target target,
+             dxcw::output output,
+             cc::span<std::byte const> data,
+             uint16_t flags = 0,
+             bool allow_compression = true);
+
+    /// removes the entry with the given name and output, output_path without file ending
+    /// returns false if there is no such entry
+    bool remove(char const* output_path, dxcw::output output);
+
+    /// removes all entries loaded by initialize_update that were not added again since, ie. binaries no longer in the shaderlist
+    /// returns the amount of removed entries
+    unsigned remove_stale_entries();
+
+    /// writes a C++ header with one constexpr name hash per entry name, for lookups without hashing at runtime
+    /// ie. "bin/mat_ps__WITH_IBL_1" -> constexpr uint64_t bin_mat_ps__WITH_IBL_1 = 0x...; inside the given namespace
+    /// must be called before finalize()
+    bool write_id_header(char const* path, char const* namespace_name = "shader_ids") const;
+
+    /// writes the index, the perfect hash and the header and closes the file, returns false if any write failed
+    /// after initialize_update, the new index is appended and the header is replaced last, or the archive is compacted
+    bool finalize();
+
+    /// closes the file without writing the index, a new archive is discarded and an existing file at its path is left unchanged
+    /// an updated archive keeps its previous index
+    void destroy();
+
+    bool is_initialized() const { return _state != nullptr; }
+
+    detail::archive_writer_state* _state = nullptr;
+};
+}
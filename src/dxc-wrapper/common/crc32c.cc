@@ -0,0 +1,239 @@
+#include "crc32c.hh"
+
+#include <cstring>
+
+#include <clean-core/assert.hh>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define DXCW_CRC32C_X64 1
+#include <nmmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#elif (defined(__aarch64__) || defined(_M_ARM64)) && defined(__ARM_FEATURE_CRC32)
+#define DXCW_CRC32C_ARM64 1
+#include <arm_acle.h>
+#endif
+
+// the SSE 4.2 path is compiled for it regardless of the target flags, it is only called if the CPU supports it
+#if defined(DXCW_CRC32C_X64) && (defined(__GNUC__) || defined(__clang__))
+#define DXCW_CRC32C_TARGET __attribute__((target("sse4.2")))
+#else
+#define DXCW_CRC32C_TARGET
+#endif
+
+namespace
+{
+constexpr uint32_t sc_polynomial = 0x82f63b78;
+
+// block sizes of the interleaved hardware path, zeros tables shift a checksum over one block
+constexpr size_t sc_long_block = 8192;
+constexpr size_t sc_short_block = 256;
+
+uint64_t read_u64(std::byte const* ptr)
+{
+    uint64_t res;
+    std::memcpy(&res, ptr, sizeof(res));
+    return res;
+}
+
+// product of a 32x32 matrix over GF(2) (one column per bit) and a vector
+uint32_t gf2_matrix_times(uint32_t const* matrix, uint32_t vector)
+{
+    uint32_t sum = 0;
+    for (; vector != 0; vector >>= 1, ++matrix)
+    {
+        if (vector & 1)
+            sum ^= *matrix;
+    }
+    return sum;
+}
+
+void gf2_matrix_square(uint32_t* out_square, uint32_t const* matrix)
+{
+    for (auto n = 0; n < 32; ++n)
+        out_square[n] = gf2_matrix_times(matrix, matrix[n]);
+}
+
+struct crc32c_tables
+{
+    // slicing by 8, table[k][b] is the checksum of byte b followed by k zero bytes
+    uint32_t slices[8][256];
+
+    // the operator appending sc_long_block and sc_short_block zero bytes to a checksum, split into one table per input byte
+    uint32_t long_zeros[4][256];
+    uint32_t short_zeros[4][256];
+
+    crc32c_tables()
+    {
+        for (uint32_t n = 0; n < 256; ++n)
+        {
+            uint32_t crc = n;
+            for (auto k = 0; k < 8; ++k)
+                crc = (crc & 1) ? (crc >> 1) ^ sc_polynomial : crc >> 1;
+            slices[0][n] = crc;
+        }
+
+        for (uint32_t n = 0; n < 256; ++n)
+        {
+            for (auto k = 1; k < 8; ++k)
+                slices[k][n] = (slices[k - 1][n] >> 8) ^ slices[0][slices[k - 1][n] & 0xFF];
+        }
+
+        build_zeros(long_zeros, sc_long_block);
+        build_zeros(short_zeros, sc_short_block);
+    }
+
+    // num_bytes must be a power of two
+    static void build_zeros(uint32_t (&out_zeros)[4][256], size_t num_bytes)
+    {
+        // operator for one zero bit, then squared up to 8 * num_bytes zero bits
+        uint32_t odd[32];
+        uint32_t even[32];
+        odd[0] = sc_polynomial;
+        for (auto n = 1; n < 32; ++n)
+            odd[n] = 1u << (n - 1);
+
+        gf2_matrix_square(even, odd); // 2 zero bits
+        gf2_matrix_square(odd, even); // 4 zero bits
+
+        uint32_t const* op = odd;
+        for (size_t len = num_bytes; len != 0;)
+        {
+            gf2_matrix_square(even, odd);
+            op = even;
+            len >>= 1;
+            if (len == 0)
+                break;
+
+            gf2_matrix_square(odd, even);
+            op = odd;
+            len >>= 1;
+        }
+
+        for (uint32_t n = 0; n < 256; ++n)
+        {
+            out_zeros[0][n] = gf2_matrix_times(op, n);
+            out_zeros[1][n] = gf2_matrix_times(op, n << 8);
+            out_zeros[2][n] = gf2_matrix_times(op, n << 16);
+            out_zeros[3][n] = gf2_matrix_times(op, n << 24);
+        }
+    }
+};
+
+crc32c_tables const& get_tables()
+{
+    static crc32c_tables const tables;
+    return tables;
+}
+
+uint32_t shift(uint32_t const (&zeros)[4][256], uint32_t crc)
+{
+    return zeros[0][crc & 0xFF] ^ zeros[1][(crc >> 8) & 0xFF] ^ zeros[2][(crc >> 16) & 0xFF] ^ zeros[3][crc >> 24];
+}
+
+// crc is the inverted checksum in all of the following
+uint32_t crc32c_portable(std::byte const* data, size_t num_bytes, uint32_t crc)
+{
+    auto const& t = get_tables().slices;
+
+    for (; num_bytes >= 8; data += 8, num_bytes -= 8)
+    {
+        uint64_t const word = read_u64(data) ^ crc;
+        crc = t[7][word & 0xFF] ^ t[6][(word >> 8) & 0xFF] ^ t[5][(word >> 16) & 0xFF] ^ t[4][(word >> 24) & 0xFF] //
+              ^ t[3][(word >> 32) & 0xFF] ^ t[2][(word >> 40) & 0xFF] ^ t[1][(word >> 48) & 0xFF] ^ t[0][word >> 56];
+    }
+
+    for (; num_bytes > 0; ++data, --num_bytes)
+        crc = (crc >> 8) ^ t[0][(crc ^ uint8_t(*data)) & 0xFF];
+
+    return crc;
+}
+
+#if defined(DXCW_CRC32C_X64) || defined(DXCW_CRC32C_ARM64)
+
+#ifdef DXCW_CRC32C_X64
+DXCW_CRC32C_TARGET inline uint32_t crc_u8(uint32_t crc, std::byte value) { return _mm_crc32_u8(crc, uint8_t(value)); }
+DXCW_CRC32C_TARGET inline uint32_t crc_u64(uint32_t crc, std::byte const* data) { return uint32_t(_mm_crc32_u64(crc, read_u64(data))); }
+#else
+inline uint32_t crc_u8(uint32_t crc, std::byte value) { return __crc32cb(crc, uint8_t(value)); }
+inline uint32_t crc_u64(uint32_t crc, std::byte const* data) { return __crc32cd(crc, read_u64(data)); }
+#endif
+
+// three streams of block_size bytes each, combined by shifting the earlier streams over the later ones
+DXCW_CRC32C_TARGET uint32_t crc32c_interleaved(std::byte const*& data, size_t& num_bytes, uint32_t crc, size_t block_size, uint32_t const (&zeros)[4][256])
+{
+    while (num_bytes >= block_size * 3)
+    {
+        uint32_t crc1 = 0;
+        uint32_t crc2 = 0;
+        for (std::byte const* const end = data + block_size; data < end; data += 8)
+        {
+            crc = crc_u64(crc, data);
+            crc1 = crc_u64(crc1, data + block_size);
+            crc2 = crc_u64(crc2, data + block_size * 2);
+        }
+
+        crc = shift(zeros, crc) ^ crc1;
+        crc = shift(zeros, crc) ^ crc2;
+        data += block_size * 2;
+        num_bytes -= block_size * 3;
+    }
+
+    return crc;
+}
+
+DXCW_CRC32C_TARGET uint32_t crc32c_hardware(std::byte const* data, size_t num_bytes, uint32_t crc)
+{
+    auto const& tables = get_tables();
+
+    // align to 8 bytes for the 64 bit loads
+    for (; num_bytes > 0 && (reinterpret_cast<uintptr_t>(data) & 7) != 0; ++data, --num_bytes)
+        crc = crc_u8(crc, *data);
+
+    crc = crc32c_interleaved(data, num_bytes, crc, sc_long_block, tables.long_zeros);
+    crc = crc32c_interleaved(data, num_bytes, crc, sc_short_block, tables.short_zeros);
+
+    for (; num_bytes >= 8; data += 8, num_bytes -= 8)
+        crc = crc_u64(crc, data);
+
+    for (; num_bytes > 0; ++data, --num_bytes)
+        crc = crc_u8(crc, *data);
+
+    return crc;
+}
+#endif
+
+bool detect_hardware_support()
+{
+#if defined(DXCW_CRC32C_X64) && defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    return (info[2] & (1 << 20)) != 0; // ecx bit 20: SSE 4.2
+#elif defined(DXCW_CRC32C_X64)
+    return __builtin_cpu_supports("sse4.2");
+#elif defined(DXCW_CRC32C_ARM64)
+    return true;
+#else
+    return false;
+#endif
+}
+}
+
+bool dxcw::detail::crc32c_is_hardware_accelerated()
+{
+    static bool const is_supported = detect_hardware_support();
+    return is_supported;
+}
+
+uint32_t dxcw::detail::crc32c(std::byte const* data, size_t num_bytes, uint32_t crc)
+{
+    CC_ASSERT((num_bytes == 0 || data) && "invalid buffer");
+
+#if defined(DXCW_CRC32C_X64) || defined(DXCW_CRC32C_ARM64)
+    if (crc32c_is_hardware_accelerated())
+        return ~crc32c_hardware(data, num_bytes, ~crc);
+#endif
+
+    return ~crc32c_portable(data, num_bytes, ~crc);
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <dxc-wrapper/common/api.hh>
+
+namespace dxcw::detail
+{
+/// CRC-32C (Castagnoli, reflected polynomial 0x82f63b78), the integrity checksum of archive blobs and manifest records
+///
+/// uses the crc32 instruction of SSE 4.2 (detected at runtime) on x64 and of ARMv8 (if the target has __ARM_FEATURE_CRC32) on ARM64,
+/// large buffers are processed as three interleaved streams to hide the latency of the instruction
+/// elsewhere a portable table-driven implementation (slicing by 8) is used, all implementations produce the same checksums
+
+/// returns the checksum of the data, continuing from the checksum of previous data if crc is not 0
+/// crc32c("123456789") is 0xe3069283
+DXCW_API uint32_t crc32c(std::byte const* data, size_t num_bytes, uint32_t crc = 0);
+
+/// true if crc32c uses a hardware instruction on this machine
+DXCW_API bool crc32c_is_hardware_accelerated();
+}
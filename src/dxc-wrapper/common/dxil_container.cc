@@ -0,0 +1,647 @@
+#include "dxil_container.hh"
+
+#include <cstring>
+
+#include <clean-core/assert.hh>
+
+#include <dxc-wrapper/compiler.hh>
+#include <dxc-wrapper/reflection.hh>
+
+namespace
+{
+using dxcw::detail::dxil_fourcc;
+
+// DxilContainerHeader: fourcc, hash (16 bytes), version, size, part count, followed by part offsets
+constexpr uint32_t sc_container_fourcc = dxil_fourcc('D', 'X', 'B', 'C');
+constexpr uint32_t sc_container_header_size = 32;
+constexpr uint32_t sc_part_header_size = 8;
+
+constexpr uint32_t sc_psv_fourcc = dxil_fourcc('P', 'S', 'V', '0');
+constexpr uint32_t sc_rdat_fourcc = dxil_fourcc('R', 'D', 'A', 'T');
+
+// sizes of the versions of PSVRuntimeInfo, later versions append members
+constexpr uint32_t sc_psv_info0_size = 24;
+constexpr uint32_t sc_psv_info1_size = 36;
+constexpr uint32_t sc_psv_info2_size = 48;
+constexpr uint32_t sc_psv_info3_size = 52;
+
+constexpr uint32_t sc_psv_bind_info0_size = 16;
+constexpr uint32_t sc_psv_bind_info1_size = 24;
+constexpr uint32_t sc_psv_signature_element_size = 16;
+
+constexpr uint32_t sc_rdat_version = 0x10;
+constexpr uint32_t sc_rdat_resource_size = 32;
+constexpr uint32_t sc_rdat_function_size = 44;
+
+enum rdat_part_type : uint32_t
+{
+    rdat_string_buffer = 1,
+    rdat_index_arrays = 2,
+    rdat_resource_table = 3,
+    rdat_function_table = 4,
+};
+
+// DXIL::ResourceClass
+enum resource_class : uint32_t
+{
+    class_srv = 0,
+    class_uav = 1,
+    class_cbuffer = 2,
+    class_sampler = 3,
+};
+
+// DXIL::ResourceKind
+enum resource_kind : uint32_t
+{
+    kind_invalid = 0,
+    kind_texture_2d = 2,
+    kind_typed_buffer = 10,
+    kind_raw_buffer = 11,
+    kind_structured_buffer = 12,
+    kind_cbuffer = 13,
+    kind_sampler = 14,
+    kind_tbuffer = 15,
+    kind_acceleration_structure = 16,
+    kind_feedback_texture_2d_array = 18,
+};
+
+// PSVResourceType
+enum psv_resource_type : uint32_t
+{
+    psv_sampler = 1,
+    psv_cbv = 2,
+    psv_srv_typed = 3,
+    psv_srv_raw = 4,
+    psv_srv_structured = 5,
+    psv_uav_typed = 6,
+    psv_uav_raw = 7,
+    psv_uav_structured = 8,
+    psv_uav_structured_with_counter = 9,
+};
+
+// DXIL::ShaderKind
+enum shader_kind : uint32_t
+{
+    stage_pixel = 0,
+    stage_vertex,
+    stage_geometry,
+    stage_hull,
+    stage_domain,
+    stage_compute,
+    stage_library,
+    stage_raygeneration,
+    stage_intersection,
+    stage_anyhit,
+    stage_closesthit,
+    stage_miss,
+    stage_callable,
+    stage_mesh,
+    stage_amplification,
+};
+
+uint32_t read_u32(std::byte const* ptr)
+{
+    uint32_t res;
+    std::memcpy(&res, ptr, sizeof(res));
+    return res;
+}
+
+// part of a validated container
+dxcw::detail::dxil_part get_part(std::byte const* container, unsigned index)
+{
+    uint32_t const offset = read_u32(container + sc_container_header_size + size_t(index) * 4);
+    return {read_u32(container + offset), read_u32(container + offset + 4), container + offset + sc_part_header_size};
+}
+
+// bounds checked sequential reads of a part
+struct part_reader
+{
+    std::byte const* data;
+    uint32_t size;
+    uint32_t pos = 0;
+
+    bool read(uint32_t& out_value)
+    {
+        if (size - pos < 4)
+            return false;
+
+        out_value = read_u32(data + pos);
+        pos += 4;
+        return true;
+    }
+
+    // the next num_records * record_size bytes, nullptr if the part is too small
+    std::byte const* read_array(uint32_t num_records, uint32_t record_size)
+    {
+        uint64_t const num_bytes = uint64_t(num_records) * record_size;
+        if (num_bytes > size - pos)
+            return nullptr;
+
+        auto const* const res = data + pos;
+        pos += uint32_t(num_bytes);
+        return res;
+    }
+};
+
+// a table of null-terminated strings, referenced by offset
+struct string_table
+{
+    char const* data = nullptr;
+    uint32_t size = 0;
+
+    bool is_valid() const { return size == 0 || data[size - 1] == '\0'; }
+
+    char const* get(uint32_t offset) const { return offset < size ? data + offset : ""; }
+};
+
+bool get_target(uint32_t kind, dxcw::target& out_target)
+{
+    switch (kind)
+    {
+    case stage_pixel:
+        out_target = dxcw::target::pixel;
+        return true;
+    case stage_vertex:
+        out_target = dxcw::target::vertex;
+        return true;
+    case stage_geometry:
+        out_target = dxcw::target::geometry;
+        return true;
+    case stage_hull:
+        out_target = dxcw::target::hull;
+        return true;
+    case stage_domain:
+        out_target = dxcw::target::domain;
+        return true;
+    case stage_compute:
+        out_target = dxcw::target::compute;
+        return true;
+    case stage_raygeneration:
+        out_target = dxcw::target::raygeneration;
+        return true;
+    case stage_intersection:
+        out_target = dxcw::target::intersection;
+        return true;
+    case stage_anyhit:
+        out_target = dxcw::target::anyhit;
+        return true;
+    case stage_closesthit:
+        out_target = dxcw::target::closesthit;
+        return true;
+    case stage_miss:
+        out_target = dxcw::target::miss;
+        return true;
+    case stage_callable:
+        out_target = dxcw::target::callable;
+        return true;
+    case stage_mesh:
+        out_target = dxcw::target::mesh;
+        return true;
+    case stage_amplification:
+        out_target = dxcw::target::amplification;
+        return true;
+    default:
+        // libraries and invalid kinds
+        return false;
+    }
+}
+
+dxcw::resource_type get_resource_type(uint32_t resource_class, uint32_t kind)
+{
+    if (resource_class == class_cbuffer)
+        return dxcw::resource_type::constant_buffer;
+    if (resource_class == class_sampler)
+        return dxcw::resource_type::sampler;
+    if (resource_class != class_srv && resource_class != class_uav)
+        return dxcw::resource_type::unknown;
+
+    bool const is_uav = resource_class == class_uav;
+    switch (kind)
+    {
+    case kind_typed_buffer:
+        return is_uav ? dxcw::resource_type::rw_typed_buffer : dxcw::resource_type::typed_buffer;
+    case kind_raw_buffer:
+    case kind_structured_buffer:
+    case kind_tbuffer:
+        return is_uav ? dxcw::resource_type::rw_buffer : dxcw::resource_type::buffer;
+    case kind_acceleration_structure:
+        return dxcw::resource_type::acceleration_structure;
+    case kind_invalid:
+    case kind_cbuffer:
+    case kind_sampler:
+        return dxcw::resource_type::unknown;
+    default:
+        return kind <= kind_feedback_texture_2d_array ? (is_uav ? dxcw::resource_type::rw_texture : dxcw::resource_type::texture)
+                                                      : dxcw::resource_type::unknown;
+    }
+}
+
+// resource class and kind of a PSV0 binding, the kind is only recorded from PSV version 2 on and inferred from the type if it is invalid
+void get_psv_resource_class(uint32_t psv_type, uint32_t& out_class, uint32_t& inout_kind)
+{
+    switch (psv_type)
+    {
+    case psv_sampler:
+        out_class = class_sampler;
+        inout_kind = kind_sampler;
+        return;
+    case psv_cbv:
+        out_class = class_cbuffer;
+        inout_kind = kind_cbuffer;
+        return;
+    case psv_srv_typed:
+    case psv_srv_raw:
+    case psv_srv_structured:
+        out_class = class_srv;
+        break;
+    case psv_uav_typed:
+    case psv_uav_raw:
+    case psv_uav_structured:
+    case psv_uav_structured_with_counter:
+        out_class = class_uav;
+        break;
+    default:
+        out_class = ~0u;
+        inout_kind = kind_invalid;
+        return;
+    }
+
+    if (inout_kind != kind_invalid)
+        return;
+
+    if (psv_type == psv_srv_raw || psv_type == psv_uav_raw)
+        inout_kind = kind_raw_buffer;
+    else if (psv_type == psv_srv_typed || psv_type == psv_uav_typed)
+        inout_kind = kind_texture_2d;
+    else
+        inout_kind = kind_structured_buffer;
+}
+
+dxcw::component_type get_component_type(uint8_t type)
+{
+    // DxilProgramSigCompType
+    switch (type)
+    {
+    case 1:
+        return dxcw::component_type::uint32;
+    case 2:
+        return dxcw::component_type::int32;
+    case 3:
+        return dxcw::component_type::float32;
+    case 4:
+        return dxcw::component_type::uint16;
+    case 5:
+        return dxcw::component_type::int16;
+    case 6:
+        return dxcw::component_type::float16;
+    case 7:
+        return dxcw::component_type::uint64;
+    case 8:
+        return dxcw::component_type::int64;
+    case 9:
+        return dxcw::component_type::float64;
+    default:
+        return dxcw::component_type::unknown;
+    }
+}
+
+bool add_name(dxcw::shader_reflection& out, char const* name, uint16_t& out_offset) { return out.add_name(name, std::strlen(name), out_offset); }
+
+bool add_binding(dxcw::shader_reflection& out, dxcw::resource_type type, uint32_t space, uint32_t lower_bound, uint32_t upper_bound, char const* name)
+{
+    if (out.num_bindings >= dxcw::shader_reflection::max_num_bindings)
+        return false;
+
+    auto& binding = out.bindings[out.num_bindings++];
+    binding = {};
+    binding.type = type;
+    binding.space = space;
+    binding.binding = lower_bound;
+    binding.num_elements = upper_bound == 0xFFFFFFFF ? 0 : upper_bound - lower_bound + 1;
+    return add_name(out, name, binding.name_offset);
+}
+
+bool read_psv_signature(std::byte const* elements,
+                        uint32_t num_elements,
+                        uint32_t element_size,
+                        bool is_output,
+                        string_table const& strings,
+                        std::byte const* semantic_indices,
+                        uint32_t num_semantic_indices,
+                        dxcw::shader_reflection& out)
+{
+    for (auto i = 0u; i < num_elements; ++i)
+    {
+        // PSVSignatureElement0: name, semantic indices, rows, start row, cols and start col, semantic kind, component type, ...
+        auto const* const element_data = elements + size_t(i) * element_size;
+        uint32_t const semantic_index_offset = read_u32(element_data + 4);
+        auto const cols_and_start = uint8_t(element_data[10]);
+        auto const semantic_kind = uint8_t(element_data[11]);
+
+        if (out.num_signature_elements >= dxcw::shader_reflection::max_num_signature_elements)
+            return false;
+
+        auto& element = out.signature_elements[out.num_signature_elements++];
+        element = {};
+        element.is_output = is_output;
+        element.type = get_component_type(uint8_t(element_data[12]));
+        element.num_components = uint8_t(cols_and_start & 0xF);
+        element.location = (cols_and_start & 0x40) ? uint32_t(uint8_t(element_data[9])) : dxcw::reflection_signature_element::no_value;
+        element.builtin = semantic_kind != 0 ? semantic_kind : dxcw::reflection_signature_element::no_value;
+
+        // elements spanning multiple rows have one index per row, the first one is recorded
+        if (semantic_index_offset < num_semantic_indices)
+            element.semantic_index = read_u32(semantic_indices + size_t(semantic_index_offset) * 4);
+
+        if (!add_name(out, strings.get(read_u32(element_data)), element.name_offset))
+            return false;
+    }
+
+    return true;
+}
+
+bool read_psv(dxcw::detail::dxil_part const& part, bool read_bindings, dxcw::shader_reflection& out)
+{
+    part_reader reader = {part.data, part.size};
+
+    uint32_t info_size;
+    if (!reader.read(info_size) || info_size < sc_psv_info0_size)
+        return false;
+
+    auto const* const info = reader.read_array(1, info_size);
+    if (!info)
+        return false;
+
+    uint32_t num_resources;
+    if (!reader.read(num_resources))
+        return false;
+
+    if (num_resources > 0)
+    {
+        uint32_t bind_info_size;
+        if (!reader.read(bind_info_size) || bind_info_size < sc_psv_bind_info0_size)
+            return false;
+
+        auto const* const bind_infos = reader.read_array(num_resources, bind_info_size);
+        if (!bind_infos)
+            return false;
+
+        for (auto i = 0u; read_bindings && i < num_resources; ++i)
+        {
+            // PSVResourceBindInfo0: type, space, lower bound, upper bound, PSVResourceBindInfo1: kind, flags
+            auto const* const bind_info = bind_infos + size_t(i) * bind_info_size;
+            uint32_t resource_class;
+            uint32_t kind = bind_info_size >= sc_psv_bind_info1_size ? read_u32(bind_info + 16) : uint32_t(kind_invalid);
+            get_psv_resource_class(read_u32(bind_info), resource_class, kind);
+
+            auto const type = get_resource_type(resource_class, kind);
+            if (!add_binding(out, type, read_u32(bind_info + 4), read_u32(bind_info + 8), read_u32(bind_info + 12), ""))
+                return false;
+        }
+    }
+
+    // PSV version 0 does not record the stage or signatures
+    if (info_size < sc_psv_info1_size)
+        return true;
+
+    uint32_t const stage = uint32_t(uint8_t(info[24]));
+    uint32_t const num_inputs = uint32_t(uint8_t(info[28]));
+    uint32_t const num_outputs = uint32_t(uint8_t(info[29]));
+    uint32_t const num_patch_constants = uint32_t(uint8_t(info[30]));
+
+    string_table strings;
+    uint32_t num_semantic_indices;
+    if (!reader.read(strings.size))
+        return false;
+
+    strings.data = reinterpret_cast<char const*>(reader.read_array(strings.size, 1));
+    if (!strings.data || !strings.is_valid() || !reader.read(num_semantic_indices))
+        return false;
+
+    auto const* const semantic_indices = reader.read_array(num_semantic_indices, 4);
+    if (!semantic_indices)
+        return false;
+
+    dxcw::target target;
+    if (get_target(stage, target))
+    {
+        if (out.num_entry_points >= dxcw::shader_reflection::max_num_entry_points)
+            return false;
+
+        auto& entry_point = out.entry_points[out.num_entry_points++];
+        entry_point = {};
+        entry_point.target = target;
+
+        if (info_size >= sc_psv_info2_size && (stage == stage_compute || stage == stage_mesh || stage == stage_amplification))
+        {
+            for (auto dim = 0u; dim < 3; ++dim)
+                entry_point.thread_group_size[dim] = read_u32(info + sc_psv_info1_size + dim * 4);
+        }
+
+        // the entry function name is recorded from PSV version 3 on
+        char const* const name = info_size >= sc_psv_info3_size ? strings.get(read_u32(info + sc_psv_info2_size)) : "";
+        if (!add_name(out, name, entry_point.name_offset))
+            return false;
+    }
+
+    if (num_inputs == 0 && num_outputs == 0 && num_patch_constants == 0)
+        return true;
+
+    uint32_t element_size;
+    if (!reader.read(element_size) || element_size < sc_psv_signature_element_size)
+        return false;
+
+    auto const* const inputs = reader.read_array(num_inputs, element_size);
+    auto const* const outputs = inputs ? reader.read_array(num_outputs, element_size) : nullptr;
+    auto const* const patch_constants = outputs ? reader.read_array(num_patch_constants, element_size) : nullptr;
+    if (!patch_constants)
+        return false;
+
+    // patch constants are outputs of hull shaders and inputs of domain shaders, mesh shaders output primitive attributes
+    bool const is_patch_constant_output = stage != stage_domain;
+    return read_psv_signature(inputs, num_inputs, element_size, false, strings, semantic_indices, num_semantic_indices, out)
+           && read_psv_signature(outputs, num_outputs, element_size, true, strings, semantic_indices, num_semantic_indices, out)
+           && read_psv_signature(patch_constants, num_patch_constants, element_size, is_patch_constant_output, strings, semantic_indices,
+                                 num_semantic_indices, out);
+}
+
+// a table part of RDAT, records of at least min_record_size bytes
+struct rdat_table
+{
+    std::byte const* records = nullptr;
+    uint32_t num_records = 0;
+    uint32_t record_size = 0;
+};
+
+bool read_rdat_table(part_reader& reader, uint32_t min_record_size, rdat_table& out_table)
+{
+    if (!reader.read(out_table.num_records) || !reader.read(out_table.record_size))
+        return false;
+
+    out_table.records = reader.read_array(out_table.num_records, out_table.record_size);
+    return out_table.records && (out_table.num_records == 0 || out_table.record_size >= min_record_size);
+}
+
+bool read_rdat(dxcw::detail::dxil_part const& part, bool read_entry_points, bool& out_has_resources, dxcw::shader_reflection& out)
+{
+    // RuntimeDataHeader: version, part count, followed by part offsets relative to the header
+    part_reader reader = {part.data, part.size};
+
+    uint32_t version;
+    uint32_t num_parts;
+    if (!reader.read(version) || version != sc_rdat_version || !reader.read(num_parts))
+        return false;
+
+    auto const* const offsets = reader.read_array(num_parts, 4);
+    if (!offsets)
+        return false;
+
+    string_table strings;
+    rdat_table resources;
+    rdat_table functions;
+    for (auto i = 0u; i < num_parts; ++i)
+    {
+        // RuntimeDataPartHeader: type, size
+        uint32_t const offset = read_u32(offsets + size_t(i) * 4);
+        part_reader header_reader = {part.data, part.size, offset};
+        uint32_t type;
+        uint32_t size;
+        if (offset > part.size || !header_reader.read(type) || !header_reader.read(size))
+            return false;
+
+        auto const* const data = header_reader.read_array(size, 1);
+        if (!data)
+            return false;
+
+        part_reader data_reader = {data, size};
+        switch (type)
+        {
+        case rdat_string_buffer:
+            strings.data = reinterpret_cast<char const*>(data);
+            strings.size = size;
+            if (!strings.is_valid())
+                return false;
+            break;
+        case rdat_resource_table:
+            if (!read_rdat_table(data_reader, sc_rdat_resource_size, resources))
+                return false;
+            break;
+        case rdat_function_table:
+            if (!read_rdat_table(data_reader, sc_rdat_function_size, functions))
+                return false;
+            break;
+        default:
+            // index arrays, raw bytes, subobjects and the tables of later versions
+            break;
+        }
+    }
+
+    out_has_resources = resources.num_records > 0;
+    for (auto i = 0u; i < resources.num_records; ++i)
+    {
+        // RuntimeDataResourceInfo: class, kind, id, space, lower bound, upper bound, name, flags
+        auto const* const resource = resources.records + size_t(i) * resources.record_size;
+        auto const type = get_resource_type(read_u32(resource), read_u32(resource + 4));
+        if (!add_binding(out, type, read_u32(resource + 12), read_u32(resource + 16), read_u32(resource + 20), strings.get(read_u32(resource + 24))))
+            return false;
+    }
+
+    for (auto i = 0u; read_entry_points && i < functions.num_records; ++i)
+    {
+        // RuntimeDataFunctionInfo: name, unmangled name, resources, dependencies, shader kind, ...
+        auto const* const function = functions.records + size_t(i) * functions.record_size;
+
+        dxcw::target target;
+        if (!get_target(read_u32(function + 16), target))
+            continue;
+
+        if (out.num_entry_points >= dxcw::shader_reflection::max_num_entry_points)
+            return false;
+
+        auto& entry_point = out.entry_points[out.num_entry_points++];
+        entry_point = {};
+        entry_point.target = target;
+        if (!add_name(out, strings.get(read_u32(function + 4)), entry_point.name_offset))
+            return false;
+    }
+
+    return true;
+}
+}
+
+int dxcw::detail::dxil_get_parts(std::byte const* data, size_t num_bytes, dxil_part* out_parts, unsigned max_num_parts)
+{
+    CC_ASSERT((num_bytes == 0 || data) && "invalid buffer");
+
+    if (num_bytes < sc_container_header_size || read_u32(data) != sc_container_fourcc)
+        return -1;
+
+    // the recorded size can be smaller than the buffer (ie. padded blobs), but not larger
+    uint32_t const container_size = read_u32(data + 24);
+    uint32_t const num_parts = read_u32(data + 28);
+    if (container_size > num_bytes || container_size < sc_container_header_size || num_parts > (container_size - sc_container_header_size) / 4)
+        return -1;
+
+    for (auto i = 0u; i < num_parts; ++i)
+    {
+        uint32_t const offset = read_u32(data + sc_container_header_size + size_t(i) * 4);
+        if (offset > container_size || container_size - offset < sc_part_header_size)
+            return -1;
+
+        if (read_u32(data + offset + 4) > container_size - offset - sc_part_header_size)
+            return -1;
+
+        if (out_parts && i < max_num_parts)
+            out_parts[i] = get_part(data, i);
+    }
+
+    return int(num_parts);
+}
+
+bool dxcw::detail::dxil_find_part(std::byte const* data, size_t num_bytes, uint32_t fourcc, dxil_part* out_part)
+{
+    CC_CONTRACT(out_part);
+
+    int const num_parts = dxil_get_parts(data, num_bytes, nullptr, 0);
+    for (int i = 0; i < num_parts; ++i)
+    {
+        auto const part = get_part(data, unsigned(i));
+        if (part.fourcc == fourcc)
+        {
+            *out_part = part;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool dxcw::detail::dxil_reflect(std::byte const* data, size_t num_bytes, shader_reflection* out_reflection)
+{
+    CC_CONTRACT(out_reflection);
+
+    if (dxil_get_parts(data, num_bytes, nullptr, 0) < 0)
+        return false;
+
+    auto& out = *out_reflection;
+    out.string_buffer_size = 0;
+    out.num_entry_points = 0;
+    out.num_bindings = 0;
+    out.num_push_constants = 0;
+    out.num_signature_elements = 0;
+
+    dxil_part psv;
+    dxil_part rdat;
+    bool const has_psv = dxil_find_part(data, num_bytes, sc_psv_fourcc, &psv);
+    bool const has_rdat = dxil_find_part(data, num_bytes, sc_rdat_fourcc, &rdat);
+
+    // named RDAT resources replace the PSV0 bindings, functions are only entry points of libraries (without PSV0)
+    bool has_rdat_resources = false;
+    if (has_rdat && !read_rdat(rdat, !has_psv, has_rdat_resources, out))
+        return false;
+
+    if (has_psv && !read_psv(psv, !has_rdat_resources, out))
+        return false;
+
+    return true;
+}
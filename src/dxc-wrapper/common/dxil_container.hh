@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <dxc-wrapper/common/api.hh>
+
+namespace dxcw
+{
+struct shader_reflection;
+}
+
+namespace dxcw::detail
+{
+/// four character code of a DXIL container part, ie. dxil_fourcc('P', 'S', 'V', '0')
+constexpr uint32_t dxil_fourcc(char c0, char c1, char c2, char c3)
+{
+    return uint32_t(uint8_t(c0)) | uint32_t(uint8_t(c1)) << 8 | uint32_t(uint8_t(c2)) << 16 | uint32_t(uint8_t(c3)) << 24;
+}
+
+/// a part of a DXIL container, data points into the container
+struct dxil_part
+{
+    uint32_t fourcc;
+    uint32_t size;
+    std::byte const* data;
+};
+
+/// reads the part table of a DXIL container ("DXBC" header, part offsets, part headers, see DxilContainer.h of DXC)
+/// writes up to max_num_parts parts to out_parts (can be null), in container order
+/// returns the amount of parts, or -1 if the data is not a well-formed container
+DXCW_API int dxil_get_parts(std::byte const* data, size_t num_bytes, dxil_part* out_parts, unsigned max_num_parts);
+
+/// finds the first part with the given fourcc, returns false if there is none or the container is malformed
+DXCW_API bool dxil_find_part(std::byte const* data, size_t num_bytes, uint32_t fourcc, dxil_part* out_part);
+
+/// reads entry points, resource bindings and signatures from the PSV0 (pipeline state validation) and RDAT (runtime data) parts
+///
+/// PSV0 describes a single entry point: its stage, thread group size, resource bindings and input / output / patch constant signatures
+/// RDAT describes libraries: the exported functions and all resources including their names, it replaces the unnamed PSV0 bindings
+/// both parts are kept by strip_reflection, resource names of non-library shaders are only stored in the DXIL module itself and are empty
+/// DXIL has no push constants, root constants are constant buffers
+
+/// returns false if the data is not a well-formed DXIL container or exceeds the capacity of out_reflection
+DXCW_API bool dxil_reflect(std::byte const* data, size_t num_bytes, shader_reflection* out_reflection);
+}
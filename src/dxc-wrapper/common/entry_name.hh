@@ -0,0 +1,26 @@
+#pragma once
+
+#include <algorithm>
+#include <string>
+
+namespace dxcw::detail
+{
+/// name of an archived or embedded binary, its output path relative to the base path with forward slashes, ie. "bin/mat_ps"
+/// base_path must use forward slashes
+inline std::string get_entry_name(std::string const& base_path, char const* output_path)
+{
+    std::string name = output_path;
+    std::replace(name.begin(), name.end(), '\\', '/');
+
+    if (!base_path.empty() && name.compare(0, base_path.size(), base_path) == 0
+        && (base_path.back() == '/' || name.size() == base_path.size() || name[base_path.size()] == '/'))
+    {
+        name.erase(0, base_path.size());
+
+        while (!name.empty() && name.front() == '/')
+            name.erase(0, 1);
+    }
+
+    return name;
+}
+}
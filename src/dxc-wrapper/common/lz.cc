@@ -0,0 +1,237 @@
+#include "lz.hh"
+
+#include <cstdint>
+#include <cstring>
+
+#include <algorithm>
+
+#include <clean-core/assert.hh>
+
+namespace
+{
+constexpr unsigned sc_hash_bits = 14;
+constexpr size_t sc_min_match_length = 4;
+constexpr size_t sc_max_offset = 65535;
+
+// the last bytes of a block are always literals, and matches never start close to the end
+constexpr size_t sc_num_last_literals = 5;
+constexpr size_t sc_match_search_margin = 12;
+
+uint32_t read_u32(std::byte const* ptr)
+{
+    uint32_t res;
+    std::memcpy(&res, ptr, sizeof(res));
+    return res;
+}
+
+uint32_t hash_sequence(uint32_t sequence) { return (sequence * 2654435761u) >> (32 - sc_hash_bits); }
+
+std::byte* write_length_extension(std::byte* out, size_t length)
+{
+    while (length >= 255)
+    {
+        *out++ = std::byte(255);
+        length -= 255;
+    }
+
+    *out++ = std::byte(length);
+    return out;
+}
+
+// writes a sequence of literals followed by a match, match_length is 0 for the last sequence
+std::byte* write_sequence(std::byte* out, std::byte const* literals, size_t num_literals, size_t offset, size_t match_length)
+{
+    std::byte* const token = out++;
+    auto token_value = uint8_t(std::min<size_t>(num_literals, 15) << 4);
+
+    if (num_literals >= 15)
+        out = write_length_extension(out, num_literals - 15);
+
+    std::memcpy(out, literals, num_literals);
+    out += num_literals;
+
+    if (match_length > 0)
+    {
+        out[0] = std::byte(offset & 0xFF);
+        out[1] = std::byte(offset >> 8);
+        out += 2;
+
+        size_t const length_code = match_length - sc_min_match_length;
+        token_value |= uint8_t(std::min<size_t>(length_code, 15));
+
+        if (length_code >= 15)
+            out = write_length_extension(out, length_code - 15);
+    }
+
+    *token = std::byte(token_value);
+    return out;
+}
+
+bool read_length_extension(std::byte const*& in, std::byte const* in_end, size_t& inout_length)
+{
+    uint8_t value;
+    do
+    {
+        if (in >= in_end)
+            return false;
+
+        value = uint8_t(*in++);
+        inout_length += value;
+    } while (value == 255);
+
+    return true;
+}
+}
+
+size_t dxcw::detail::lz_compress(std::byte const* data, size_t num_bytes, std::byte* out_data)
+{
+    CC_ASSERT((num_bytes == 0 || (data && out_data)) && "invalid buffers");
+    CC_ASSERT(num_bytes <= 0xFFFFFFFFu && "block too large");
+
+    std::byte* out = out_data;
+    std::byte const* const end = data + num_bytes;
+    std::byte const* anchor = data; // start of pending literals
+
+    if (num_bytes > sc_match_search_margin)
+    {
+        // most recent position per hash of the 4 bytes at that position, stale entries are rejected by comparing bytes
+        uint32_t table[1u << sc_hash_bits] = {};
+
+        std::byte const* const search_end = end - sc_match_search_margin;
+        std::byte const* const match_end = end - sc_num_last_literals;
+        std::byte const* pos = data;
+        unsigned num_misses = 0;
+
+        while (pos < search_end)
+        {
+            uint32_t const sequence = read_u32(pos);
+            uint32_t const hash = hash_sequence(sequence);
+            std::byte const* candidate = data + table[hash];
+            table[hash] = uint32_t(pos - data);
+
+            if (candidate >= pos || size_t(pos - candidate) > sc_max_offset || read_u32(candidate) != sequence)
+            {
+                // step faster through incompressible data
+                pos += 1 + (num_misses++ >> 5);
+                continue;
+            }
+
+            num_misses = 0;
+
+            // extend backwards into the pending literals, then forwards
+            std::byte const* match_start = pos;
+            while (match_start > anchor && candidate > data && match_start[-1] == candidate[-1])
+            {
+                --match_start;
+                --candidate;
+            }
+
+            std::byte const* match_pos = pos + sc_min_match_length;
+            std::byte const* ref_pos = candidate + (match_pos - match_start);
+            while (match_pos < match_end && *match_pos == *ref_pos)
+            {
+                ++match_pos;
+                ++ref_pos;
+            }
+
+            out = write_sequence(out, anchor, size_t(match_start - anchor), size_t(match_start - candidate), size_t(match_pos - match_start));
+            anchor = pos = match_pos;
+
+            // seed the table with a position inside the match, helps on repetitive word streams
+            if (pos < search_end)
+                table[hash_sequence(read_u32(pos - 2))] = uint32_t(pos - 2 - data);
+        }
+    }
+
+    out = write_sequence(out, anchor, size_t(end - anchor), 0, 0);
+    return size_t(out - out_data);
+}
+
+bool dxcw::detail::lz_decompress(std::byte const* data, size_t num_bytes, std::byte* out_data, size_t out_num_bytes)
+{
+    std::byte const* in = data;
+    std::byte const* const in_end = data + num_bytes;
+    std::byte* out = out_data;
+    std::byte* const out_end = out_data + out_num_bytes;
+
+    for (;;)
+    {
+        if (in >= in_end)
+            return false;
+
+        auto const token = uint8_t(*in++);
+
+        // common case of short literals followed by a short match: fixed size copies with enough slack on both sides
+        if (token < 0xF0 && (token & 15) != 15 && in_end - in >= 18 && out_end - out >= 32)
+        {
+            size_t const num_short_literals = token >> 4;
+            std::memcpy(out, in, 16);
+            in += num_short_literals;
+            out += num_short_literals;
+
+            size_t const offset = size_t(uint8_t(in[0])) | size_t(uint8_t(in[1])) << 8;
+            size_t const match_length = (token & 15) + sc_min_match_length;
+            if (offset >= 8 && offset <= size_t(out - out_data))
+            {
+                in += 2;
+                std::memcpy(out, out - offset, 8);
+                std::memcpy(out + 8, out - offset + 8, 8);
+                std::memcpy(out + 16, out - offset + 16, 2);
+                out += match_length;
+                continue;
+            }
+
+            // rewind to the regular path for short offsets and errors
+            in -= num_short_literals;
+            out -= num_short_literals;
+        }
+
+        size_t num_literals = token >> 4;
+        if (num_literals == 15 && !read_length_extension(in, in_end, num_literals))
+            return false;
+
+        if (num_literals > size_t(in_end - in) || num_literals > size_t(out_end - out))
+            return false;
+
+        std::memcpy(out, in, num_literals);
+        in += num_literals;
+        out += num_literals;
+
+        // the last sequence has no match
+        if (in == in_end)
+            return out == out_end;
+
+        if (in_end - in < 2)
+            return false;
+
+        size_t const offset = size_t(uint8_t(in[0])) | size_t(uint8_t(in[1])) << 8;
+        in += 2;
+
+        size_t match_length = token & 15;
+        if (match_length == 15 && !read_length_extension(in, in_end, match_length))
+            return false;
+
+        match_length += sc_min_match_length;
+
+        if (offset == 0 || offset > size_t(out - out_data) || match_length > size_t(out_end - out))
+            return false;
+
+        std::byte const* ref = out - offset;
+        std::byte* const match_out_end = out + match_length;
+
+        if (offset >= 8)
+        {
+            // source and destination of each 8 byte chunk don't overlap
+            while (match_out_end - out >= 8)
+            {
+                std::memcpy(out, ref, 8);
+                out += 8;
+                ref += 8;
+            }
+        }
+
+        // overlapping matches repeat the last offset bytes
+        while (out < match_out_end)
+            *out++ = *ref++;
+    }
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+
+#include <dxc-wrapper/common/api.hh>
+
+namespace dxcw::detail
+{
+/// byte-oriented LZ77 block codec (LZ4 block layout), used for archive entries
+///
+/// a block is a sequence of [token][literal length ext][literals][offset u16][match length ext]
+/// the token holds the literal length in its high and the match length - 4 in its low nibble, 15 means more length bytes follow
+/// the last sequence only has literals, matches reference at most 65535 bytes back
+/// blocks do not store their decompressed size, it must be known by the reader
+
+/// upper bound of the compressed size of num_bytes input bytes
+constexpr size_t lz_get_max_compressed_size(size_t num_bytes) { return num_bytes + num_bytes / 255 + 16; }
+
+/// compresses a block into out_data, which must hold lz_get_max_compressed_size(num_bytes) bytes
+/// returns the compressed size
+DXCW_API size_t lz_compress(std::byte const* data, size_t num_bytes, std::byte* out_data);
+
+/// decompresses a block of exactly out_num_bytes decompressed bytes into out_data
+/// the input is fully bounds checked, returns false if it is malformed or does not match out_num_bytes
+DXCW_API bool lz_decompress(std::byte const* data, size_t num_bytes, std::byte* out_data, size_t out_num_bytes);
+}
@@ -0,0 +1,106 @@
+#include "mapped_file.hh"
+
+#include <clean-core/assert.hh>
+#include <clean-core/macros.hh>
+
+#ifdef CC_OS_WINDOWS
+
+// clang-format off
+#include <clean-core/native/detail/win32_sanitize_before.inl>
+
+#include <Windows.h>
+
+#include <clean-core/native/detail/win32_sanitize_after.inl>
+// clang-format on
+
+#else
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#endif
+
+bool dxcw::detail::mapped_file::map(char const* path)
+{
+    CC_CONTRACT(path);
+    CC_ASSERT(!is_mapped() && "double map");
+
+#ifdef CC_OS_WINDOWS
+    // mapped archives can be updated in place, and replaced by compaction
+    HANDLE const file = ::CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+                                      FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER file_size;
+    if (!::GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0)
+    {
+        ::CloseHandle(file);
+        return false;
+    }
+
+    HANDLE const mapping = ::CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping == nullptr)
+    {
+        ::CloseHandle(file);
+        return false;
+    }
+
+    void const* const view = ::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (view == nullptr)
+    {
+        ::CloseHandle(mapping);
+        ::CloseHandle(file);
+        return false;
+    }
+
+    _native_file = file;
+    _native_mapping = mapping;
+    data = static_cast<std::byte const*>(view);
+    size = size_t(file_size.QuadPart);
+#else
+    int const fd = ::open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    void* const view = ::mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    // the mapping keeps the file referenced
+    ::close(fd);
+
+    if (view == MAP_FAILED)
+        return false;
+
+    data = static_cast<std::byte const*>(view);
+    size = size_t(st.st_size);
+#endif
+
+    return true;
+}
+
+void dxcw::detail::mapped_file::unmap()
+{
+    if (!is_mapped())
+        return;
+
+#ifdef CC_OS_WINDOWS
+    ::UnmapViewOfFile(data);
+    ::CloseHandle(static_cast<HANDLE>(_native_mapping));
+    ::CloseHandle(static_cast<HANDLE>(_native_file));
+    _native_mapping = nullptr;
+    _native_file = nullptr;
+#else
+    ::munmap(const_cast<std::byte*>(data), size);
+#endif
+
+    data = nullptr;
+    size = 0;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+
+#include <dxc-wrapper/common/api.hh>
+
+namespace dxcw::detail
+{
+/// read-only memory mapping of an entire file, pages are loaded on first access
+struct DXCW_API mapped_file
+{
+    /// maps the file, returns false if it can't be opened or is empty
+    bool map(char const* path);
+    void unmap();
+
+    bool is_mapped() const { return data != nullptr; }
+
+    std::byte const* data = nullptr;
+    size_t size = 0;
+
+    // file and mapping handles on Windows, unused elsewhere
+    void* _native_file = nullptr;
+    void* _native_mapping = nullptr;
+};
+}
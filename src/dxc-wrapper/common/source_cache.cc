@@ -0,0 +1,162 @@
+#include "source_cache.hh"
+
+#include <cstdint>
+#include <cstring>
+
+#include <atomic>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <clean-core/assert.hh>
+
+#include <dxc-wrapper/common/mapped_file.hh>
+
+namespace
+{
+// pages are a multiple of this size on all supported platforms
+constexpr size_t sc_min_page_size = 4096;
+
+struct source_fingerprint
+{
+    uintmax_t size = 0;
+    std::filesystem::file_time_type write_time = {};
+
+    bool operator==(source_fingerprint const& rhs) const { return size == rhs.size && write_time == rhs.write_time; }
+};
+
+struct source_entry
+{
+    source_fingerprint fingerprint;
+    dxcw::detail::mapped_file file;
+    std::unique_ptr<char[]> terminated_copy; // only if the mapping has no space for a terminator
+    dxcw::detail::source_view view;
+};
+
+bool get_fingerprint(std::filesystem::path const& path, source_fingerprint& out_fingerprint)
+{
+    std::error_code ec;
+    out_fingerprint.size = std::filesystem::file_size(path, ec);
+    if (ec)
+        return false;
+
+    out_fingerprint.write_time = std::filesystem::last_write_time(path, ec);
+    return !ec;
+}
+
+bool load_entry(char const* path, source_entry& entry)
+{
+    if (!entry.file.map(path))
+        return false;
+
+    size_t const size = entry.file.size;
+    if (size % sc_min_page_size != 0)
+    {
+        // the remainder of the last page is zero-filled by the OS, which terminates the text
+        entry.view.text = reinterpret_cast<char const*>(entry.file.data);
+    }
+    else
+    {
+        entry.terminated_copy = std::make_unique<char[]>(size + 1);
+        std::memcpy(entry.terminated_copy.get(), entry.file.data, size);
+        entry.terminated_copy[size] = '\0';
+        entry.file.unmap();
+
+        entry.view.text = entry.terminated_copy.get();
+    }
+
+    entry.view.size = size;
+    return true;
+}
+}
+
+struct dxcw::detail::source_cache_state
+{
+    std::shared_mutex mutex;
+
+    // latest entry per canonical path
+    std::unordered_map<std::string, source_entry*> entries_by_path;
+
+    // all entries ever loaded, outdated ones are kept alive for views still in use
+    std::vector<std::unique_ptr<source_entry>> entries;
+
+    std::atomic<unsigned> num_reused_loads = {0};
+};
+
+void dxcw::detail::source_cache::initialize()
+{
+    CC_ASSERT(_state == nullptr && "double initialize");
+    _state = new source_cache_state();
+}
+
+void dxcw::detail::source_cache::destroy()
+{
+    if (_state == nullptr)
+        return;
+
+    for (auto& entry : _state->entries)
+    {
+        if (entry->file.is_mapped())
+            entry->file.unmap();
+    }
+
+    delete _state;
+    _state = nullptr;
+}
+
+dxcw::detail::source_view dxcw::detail::source_cache::load(char const* path)
+{
+    CC_CONTRACT(path);
+    CC_ASSERT(_state != nullptr && "Uninitialized dxcw::detail::source_cache");
+
+    std::error_code ec;
+    auto canonical_path = std::filesystem::weakly_canonical(path, ec);
+    if (ec)
+        canonical_path = path;
+
+    source_fingerprint fingerprint;
+    if (!get_fingerprint(canonical_path, fingerprint))
+        return {};
+
+    auto key = canonical_path.string();
+
+    {
+        std::shared_lock lock(_state->mutex);
+        auto const it = _state->entries_by_path.find(key);
+        if (it != _state->entries_by_path.end() && it->second->fingerprint == fingerprint)
+        {
+            ++_state->num_reused_loads;
+            return it->second->view;
+        }
+    }
+
+    std::unique_lock lock(_state->mutex);
+
+    // another thread might have loaded the file in the meantime
+    auto const it = _state->entries_by_path.find(key);
+    if (it != _state->entries_by_path.end() && it->second->fingerprint == fingerprint)
+    {
+        ++_state->num_reused_loads;
+        return it->second->view;
+    }
+
+    auto entry = std::make_unique<source_entry>();
+    entry->fingerprint = fingerprint;
+    if (!load_entry(key.c_str(), *entry))
+        return {};
+
+    auto const view = entry->view;
+    _state->entries_by_path[std::move(key)] = entry.get();
+    _state->entries.push_back(std::move(entry));
+    return view;
+}
+
+unsigned dxcw::detail::source_cache::get_num_reused_loads() const
+{
+    CC_ASSERT(_state != nullptr && "Uninitialized dxcw::detail::source_cache");
+    return _state->num_reused_loads.load();
+}
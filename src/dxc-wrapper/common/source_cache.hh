@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+
+#include <dxc-wrapper/common/api.hh>
+
+namespace dxcw::detail
+{
+struct source_cache_state;
+
+/// null-terminated text of a source file, valid until the cache it was loaded from is destroyed
+struct source_view
+{
+    char const* text = nullptr;
+    size_t size = 0; ///< without the terminator
+
+    bool is_valid() const { return text != nullptr; }
+};
+
+/// memory mapped source files shared between compilations
+///
+/// files are keyed by their canonical path and a fingerprint (size and modification time)
+/// all loads of an unchanged file return the same mapping, a changed file is mapped again
+/// mappings are never unmapped before destroy(), so views stay valid after their file was replaced (as editors save)
+/// modifying a file in place while it is mapped changes or invalidates its views, as with any file mapping
+/// the returned text is always null-terminated, files that end exactly on a page boundary are copied to add the terminator
+/// thread safe
+struct DXCW_API source_cache
+{
+public:
+    void initialize();
+
+    /// unmaps all files, invalidates all views
+    void destroy();
+
+    /// returns the text of the file at path, an invalid view if it can't be opened or is empty
+    source_view load(char const* path);
+
+    /// amount of loads that reused an existing mapping since initialize()
+    unsigned get_num_reused_loads() const;
+
+    bool is_initialized() const { return _state != nullptr; }
+
+    source_cache_state* _state = nullptr;
+};
+}
@@ -0,0 +1,467 @@
+#include "spirv_codec.hh"
+
+#include <cstdint>
+#include <cstring>
+
+#include <clean-core/assert.hh>
+
+namespace
+{
+constexpr uint32_t sc_spirv_magic = 0x07230203;
+constexpr uint32_t sc_encoded_magic = 0x564C4D53; // "SMLV"
+constexpr uint32_t sc_num_header_words = 5;
+
+// the most frequent opcodes get the smallest codes, all others are shifted behind them
+constexpr uint16_t sc_frequent_opcodes[] = {
+    61,  // OpLoad
+    62,  // OpStore
+    65,  // OpAccessChain
+    71,  // OpDecorate
+    72,  // OpMemberDecorate
+    81,  // OpCompositeExtract
+    133, // OpFMul
+    129, // OpFAdd
+    80,  // OpCompositeConstruct
+    79,  // OpVectorShuffle
+    12,  // OpExtInst
+    43,  // OpConstant
+    248, // OpLabel
+    249, // OpBranch
+    32,  // OpTypePointer
+    59,  // OpVariable
+};
+constexpr uint32_t sc_num_frequent_opcodes = sizeof(sc_frequent_opcodes) / sizeof(sc_frequent_opcodes[0]);
+
+constexpr uint8_t sc_no_trailing_ids = 0xFF;
+
+// which words of an instruction are ids, only affects the encoded size, not correctness
+struct instruction_layout
+{
+    bool has_type = false;
+    bool has_result = false;
+    bool is_annotation = false;      // the first operand is a decoration or name target
+    bool has_raw_literals = false;   // literal operands are strings or constant bits, not small numbers
+    uint8_t id_mask = 0;             // bit i: operand i (after type and result) is an id
+    uint8_t trailing_ids_from = sc_no_trailing_ids; // operands from this index on are ids
+};
+
+constexpr instruction_layout make_layout(bool has_type, bool has_result, uint8_t id_mask, uint8_t trailing_ids_from = sc_no_trailing_ids)
+{
+    instruction_layout res;
+    res.has_type = has_type;
+    res.has_result = has_result;
+    res.id_mask = id_mask;
+    res.trailing_ids_from = trailing_ids_from;
+    return res;
+}
+
+constexpr instruction_layout make_raw_layout(bool has_type, bool has_result, uint8_t id_mask)
+{
+    auto res = make_layout(has_type, has_result, id_mask);
+    res.has_raw_literals = true;
+    return res;
+}
+
+constexpr instruction_layout make_annotation_layout(bool has_raw_literals)
+{
+    auto res = make_layout(false, false, 0b1);
+    res.is_annotation = true;
+    res.has_raw_literals = has_raw_literals;
+    return res;
+}
+
+instruction_layout get_instruction_layout(uint32_t opcode)
+{
+    // value ops: result type and result id followed by operands
+    constexpr auto unary = make_layout(true, true, 0b1);
+    constexpr auto binary = make_layout(true, true, 0b11);
+    constexpr auto ternary = make_layout(true, true, 0b111);
+    constexpr auto all_ids = make_layout(true, true, 0, 0);
+
+    // conversions, negations, derivatives, relational unary ops
+    if ((opcode >= 109 && opcode <= 127) || (opcode >= 154 && opcode <= 157) || opcode == 168 || opcode == 200 || (opcode >= 207 && opcode <= 215))
+        return unary;
+
+    // arithmetic, comparisons, logical and bitwise ops
+    if ((opcode >= 128 && opcode <= 148) || (opcode >= 164 && opcode <= 167) || (opcode >= 170 && opcode <= 199))
+        return binary;
+
+    // atomics
+    if (opcode >= 227 && opcode <= 242)
+        return opcode == 228 ? make_layout(false, false, 0, 0) : all_ids;
+
+    switch (opcode)
+    {
+    case 3: // OpSource
+        return make_raw_layout(false, false, 0b100);
+    case 5: // OpName
+    case 6: // OpMemberName
+    case 5632: // OpDecorateString
+    case 5633: // OpMemberDecorateString
+        return make_annotation_layout(true);
+    case 71: // OpDecorate
+    case 72: // OpMemberDecorate
+    case 332: // OpDecorateId
+        return make_annotation_layout(false);
+    case 7:  // OpString
+    case 11: // OpExtInstImport
+        return make_raw_layout(false, true, 0);
+    case 10: // OpExtension
+        return make_raw_layout(false, false, 0);
+    case 12: // OpExtInst
+        return make_layout(true, true, 0b1, 2);
+    case 15: // OpEntryPoint
+        return make_raw_layout(false, false, 0b10);
+    case 16: // OpExecutionMode
+        return make_layout(false, false, 0b1);
+    case 19: // OpTypeVoid
+    case 20: // OpTypeBool
+    case 21: // OpTypeInt
+    case 22: // OpTypeFloat
+    case 26: // OpTypeSampler
+        return make_layout(false, true, 0);
+    case 23: // OpTypeVector
+    case 24: // OpTypeMatrix
+    case 25: // OpTypeImage
+    case 27: // OpTypeSampledImage
+    case 29: // OpTypeRuntimeArray
+        return make_layout(false, true, 0b1);
+    case 28: // OpTypeArray
+        return make_layout(false, true, 0b11);
+    case 30: // OpTypeStruct
+    case 33: // OpTypeFunction
+        return make_layout(false, true, 0, 0);
+    case 32: // OpTypePointer
+        return make_layout(false, true, 0b10);
+    case 41: // OpConstantTrue
+    case 42: // OpConstantFalse
+    case 46: // OpConstantNull
+    case 55: // OpFunctionParameter
+        return make_layout(true, true, 0);
+    case 43: // OpConstant
+    case 50: // OpSpecConstant
+        return make_raw_layout(true, true, 0);
+    case 44: // OpConstantComposite
+    case 51: // OpSpecConstantComposite
+    case 57: // OpFunctionCall
+    case 65: // OpAccessChain
+    case 66: // OpInBoundsAccessChain
+    case 80: // OpCompositeConstruct
+    case 245: // OpPhi
+        return all_ids;
+    case 54: // OpFunction
+    case 59: // OpVariable
+        return make_layout(true, true, 0b10);
+    case 60: // OpImageTexelPointer
+    case 169: // OpSelect
+    case 89:  // OpImageSampleDrefImplicitLod
+    case 90:  // OpImageSampleDrefExplicitLod
+    case 96:  // OpImageGather
+    case 97:  // OpImageDrefGather
+        return ternary;
+    case 61: // OpLoad
+    case 81: // OpCompositeExtract
+    case 83: // OpCopyObject
+    case 84: // OpTranspose
+    case 100: // OpImage
+    case 104: // OpImageQuerySize
+        return unary;
+    case 62: // OpStore
+    case 63: // OpCopyMemory
+        return make_layout(false, false, 0b11);
+    case 79: // OpVectorShuffle
+    case 82: // OpCompositeInsert
+    case 86: // OpSampledImage
+    case 87: // OpImageSampleImplicitLod
+    case 88: // OpImageSampleExplicitLod
+    case 95: // OpImageFetch
+    case 98: // OpImageRead
+    case 103: // OpImageQuerySizeLod
+        return binary;
+    case 99: // OpImageWrite
+        return make_layout(false, false, 0b111);
+    case 224: // OpControlBarrier
+    case 225: // OpMemoryBarrier
+        return make_layout(false, false, 0, 0);
+    case 246: // OpLoopMerge
+        return make_layout(false, false, 0b11);
+    case 247: // OpSelectionMerge
+    case 249: // OpBranch
+    case 254: // OpReturnValue
+        return make_layout(false, false, 0b1);
+    case 248: // OpLabel
+        return make_layout(false, true, 0);
+    case 250: // OpBranchConditional
+        return make_layout(false, false, 0b111);
+    case 251: // OpSwitch
+        return make_layout(false, false, 0b11);
+    default:
+        return {};
+    }
+}
+
+uint32_t encode_opcode(uint32_t opcode)
+{
+    for (auto i = 0u; i < sc_num_frequent_opcodes; ++i)
+    {
+        if (sc_frequent_opcodes[i] == opcode)
+            return i;
+    }
+
+    return opcode + sc_num_frequent_opcodes;
+}
+
+uint32_t zigzag(uint32_t value) { return (value << 1) ^ uint32_t(int32_t(value) >> 31); }
+uint32_t unzigzag(uint32_t value) { return (value >> 1) ^ (0u - (value & 1)); }
+
+bool is_id_operand(instruction_layout const& layout, uint32_t operand_index)
+{
+    return (operand_index < 8 && ((layout.id_mask >> operand_index) & 1) != 0) || operand_index >= layout.trailing_ids_from;
+}
+
+uint32_t read_word(std::byte const* ptr)
+{
+    uint32_t res;
+    std::memcpy(&res, ptr, sizeof(res));
+    return res;
+}
+
+std::byte* write_varint(std::byte* out, uint32_t value)
+{
+    while (value >= 0x80)
+    {
+        *out++ = std::byte(value | 0x80);
+        value >>= 7;
+    }
+
+    *out++ = std::byte(value);
+    return out;
+}
+
+bool read_varint(std::byte const*& in, std::byte const* in_end, uint32_t& out_value)
+{
+    uint32_t value = 0;
+    for (auto shift = 0u; shift < 35; shift += 7)
+    {
+        if (in >= in_end)
+            return false;
+
+        auto const byte = uint8_t(*in++);
+        value |= uint32_t(byte & 0x7F) << shift;
+
+        if ((byte & 0x80) == 0)
+        {
+            out_value = value;
+            return true;
+        }
+    }
+
+    return false;
+}
+}
+
+size_t dxcw::detail::spirv_encode(std::byte const* data, size_t num_bytes, std::byte* out_data)
+{
+    CC_ASSERT((num_bytes == 0 || (data && out_data)) && "invalid buffers");
+
+    if (num_bytes % 4 != 0 || num_bytes < sc_num_header_words * 4 || num_bytes / 4 > 0xFFFFFFFFu || read_word(data) != sc_spirv_magic)
+        return 0;
+
+    auto const num_words = uint32_t(num_bytes / 4);
+    auto const word = [&](uint32_t index) { return read_word(data + size_t(index) * 4); };
+
+    std::byte* out = out_data;
+    out = write_varint(out, sc_encoded_magic);
+    out = write_varint(out, num_words);
+    for (auto i = 1u; i < sc_num_header_words; ++i)
+        out = write_varint(out, word(i));
+
+    uint32_t last_result = 0;
+    uint32_t last_target = 0;
+
+    for (uint32_t pos = sc_num_header_words; pos < num_words;)
+    {
+        uint32_t const opcode = word(pos) & 0xFFFF;
+        uint32_t const num_instruction_words = word(pos) >> 16;
+
+        if (num_instruction_words == 0 || num_instruction_words > num_words - pos)
+            return 0;
+
+        uint32_t const num_operands = num_instruction_words - 1;
+        out = write_varint(out, encode_opcode(opcode) << 4 | (num_operands < 15 ? num_operands : 15));
+        if (num_operands >= 15)
+            out = write_varint(out, num_operands - 15);
+
+        auto const layout = get_instruction_layout(opcode);
+        uint32_t index = pos + 1;
+        uint32_t const end = pos + num_instruction_words;
+
+        if (layout.has_type && index < end)
+            out = write_varint(out, word(index++));
+
+        if (layout.has_result && index < end)
+        {
+            uint32_t const result = word(index++);
+            out = write_varint(out, zigzag(result - (last_result + 1)));
+            last_result = result;
+        }
+
+        for (uint32_t operand_index = 0; index < end; ++index, ++operand_index)
+        {
+            uint32_t const value = word(index);
+
+            if (is_id_operand(layout, operand_index))
+            {
+                if (layout.is_annotation && operand_index == 0)
+                {
+                    out = write_varint(out, zigzag(value - last_target));
+                    last_target = value;
+                }
+                else
+                {
+                    // operands mostly reference recently defined ids
+                    out = write_varint(out, zigzag(last_result - value));
+                }
+            }
+            else if (layout.has_raw_literals)
+            {
+                std::memcpy(out, &value, sizeof(value));
+                out += sizeof(value);
+            }
+            else
+            {
+                out = write_varint(out, value);
+            }
+        }
+
+        pos = end;
+    }
+
+    return size_t(out - out_data);
+}
+
+size_t dxcw::detail::spirv_get_decoded_size(std::byte const* data, size_t num_bytes)
+{
+    std::byte const* in = data;
+    std::byte const* const in_end = data + num_bytes;
+
+    uint32_t magic = 0, num_words = 0;
+    if (!read_varint(in, in_end, magic) || magic != sc_encoded_magic || !read_varint(in, in_end, num_words) || num_words < sc_num_header_words)
+        return 0;
+
+    return size_t(num_words) * 4;
+}
+
+bool dxcw::detail::spirv_decode(std::byte const* data, size_t num_bytes, std::byte* out_data, size_t out_num_bytes)
+{
+    std::byte const* in = data;
+    std::byte const* const in_end = data + num_bytes;
+
+    if (spirv_get_decoded_size(data, num_bytes) != out_num_bytes || out_num_bytes == 0)
+        return false;
+
+    auto const num_words = uint32_t(out_num_bytes / 4);
+    uint32_t pos = 0;
+    auto const write_word = [&](uint32_t value)
+    {
+        std::memcpy(out_data + size_t(pos) * 4, &value, sizeof(value));
+        ++pos;
+    };
+
+    // magic and word count, already validated
+    uint32_t value;
+    read_varint(in, in_end, value);
+    read_varint(in, in_end, value);
+
+    write_word(sc_spirv_magic);
+    for (auto i = 1u; i < sc_num_header_words; ++i)
+    {
+        if (!read_varint(in, in_end, value))
+            return false;
+
+        write_word(value);
+    }
+
+    uint32_t last_result = 0;
+    uint32_t last_target = 0;
+
+    while (pos < num_words)
+    {
+        uint32_t head;
+        if (!read_varint(in, in_end, head))
+            return false;
+
+        uint32_t const code = head >> 4;
+        uint32_t num_operands = head & 15;
+        if (num_operands == 15)
+        {
+            uint32_t num_extra_operands;
+            if (!read_varint(in, in_end, num_extra_operands) || num_extra_operands > 0xFFFF)
+                return false;
+
+            num_operands += num_extra_operands;
+        }
+
+        uint32_t const opcode = code < sc_num_frequent_opcodes ? sc_frequent_opcodes[code] : code - sc_num_frequent_opcodes;
+        if (opcode > 0xFFFF || num_operands >= 0xFFFF || num_operands >= num_words - pos)
+            return false;
+
+        write_word((num_operands + 1) << 16 | opcode);
+
+        auto const layout = get_instruction_layout(opcode);
+        uint32_t const end = pos + num_operands;
+
+        if (layout.has_type && pos < end)
+        {
+            if (!read_varint(in, in_end, value))
+                return false;
+
+            write_word(value);
+        }
+
+        if (layout.has_result && pos < end)
+        {
+            if (!read_varint(in, in_end, value))
+                return false;
+
+            last_result = last_result + 1 + unzigzag(value);
+            write_word(last_result);
+        }
+
+        for (uint32_t operand_index = 0; pos < end; ++operand_index)
+        {
+            if (is_id_operand(layout, operand_index))
+            {
+                if (!read_varint(in, in_end, value))
+                    return false;
+
+                if (layout.is_annotation && operand_index == 0)
+                {
+                    last_target = last_target + unzigzag(value);
+                    write_word(last_target);
+                }
+                else
+                {
+                    write_word(last_result - unzigzag(value));
+                }
+            }
+            else if (layout.has_raw_literals)
+            {
+                if (in_end - in < 4)
+                    return false;
+
+                write_word(read_word(in));
+                in += 4;
+            }
+            else
+            {
+                if (!read_varint(in, in_end, value))
+                    return false;
+
+                write_word(value);
+            }
+        }
+    }
+
+    return in == in_end;
+}
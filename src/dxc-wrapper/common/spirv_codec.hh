@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+
+#include <dxc-wrapper/common/api.hh>
+
+namespace dxcw::detail
+{
+/// lossless SPIR-V specific encoding (in the spirit of SMOL-V), used for archive entries
+///
+/// instructions are written as a varint of (remapped opcode, operand count), followed by their operands
+/// result ids are delta encoded against the previous result id, id operands against the result id of their instruction,
+/// decoration targets against the previous decoration target, and remaining literals as varints (or raw for strings and constants)
+/// the output is smaller than the module and compresses better with a generic codec (common/lz.hh) on top
+
+/// upper bound of the encoded size of a SPIR-V module of num_bytes bytes
+constexpr size_t spirv_get_max_encoded_size(size_t num_bytes) { return (num_bytes / 4) * 5 + 32; }
+
+/// encodes a SPIR-V module into out_data, which must hold spirv_get_max_encoded_size(num_bytes) bytes
+/// returns the encoded size, or 0 if the data is not a well-formed SPIR-V module
+DXCW_API size_t spirv_encode(std::byte const* data, size_t num_bytes, std::byte* out_data);
+
+/// returns the size of the decoded module, or 0 if the data is not an encoded module
+DXCW_API size_t spirv_get_decoded_size(std::byte const* data, size_t num_bytes);
+
+/// decodes a module of exactly out_num_bytes bytes into out_data
+/// the input is fully bounds checked, returns false if it is malformed or does not match out_num_bytes
+DXCW_API bool spirv_decode(std::byte const* data, size_t num_bytes, std::byte* out_data, size_t out_num_bytes);
+}
@@ -0,0 +1,776 @@
+#include "spirv_reflect.hh"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <clean-core/assert.hh>
+
+#include <dxc-wrapper/compiler.hh>
+#include <dxc-wrapper/reflection.hh>
+
+namespace
+{
+constexpr uint32_t sc_spirv_magic = 0x07230203;
+constexpr uint32_t sc_num_header_words = 5;
+constexpr uint32_t sc_max_id_bound = 1u << 22;
+constexpr uint32_t sc_none = dxcw::reflection_signature_element::no_value;
+
+enum spirv_op : uint32_t
+{
+    op_name = 5,
+    op_entry_point = 15,
+    op_execution_mode = 16,
+    op_type_bool = 20,
+    op_type_int = 21,
+    op_type_float = 22,
+    op_type_vector = 23,
+    op_type_matrix = 24,
+    op_type_image = 25,
+    op_type_sampler = 26,
+    op_type_sampled_image = 27,
+    op_type_array = 28,
+    op_type_runtime_array = 29,
+    op_type_struct = 30,
+    op_type_pointer = 32,
+    op_constant = 43,
+    op_spec_constant = 50,
+    op_function = 54,
+    op_variable = 59,
+    op_decorate = 71,
+    op_member_decorate = 72,
+    op_execution_mode_id = 331,
+    op_decorate_string = 5632,
+    op_type_acceleration_structure = 5341,
+};
+
+enum spirv_decoration : uint32_t
+{
+    decoration_block = 2,
+    decoration_buffer_block = 3,
+    decoration_row_major = 4,
+    decoration_array_stride = 6,
+    decoration_matrix_stride = 7,
+    decoration_builtin = 11,
+    decoration_non_writable = 24,
+    decoration_location = 30,
+    decoration_binding = 33,
+    decoration_descriptor_set = 34,
+    decoration_offset = 35,
+    decoration_user_semantic = 5635,
+};
+
+enum spirv_storage_class : uint32_t
+{
+    storage_uniform_constant = 0,
+    storage_input = 1,
+    storage_uniform = 2,
+    storage_output = 3,
+    storage_push_constant = 9,
+    storage_storage_buffer = 12,
+};
+
+enum spirv_execution_mode : uint32_t
+{
+    execution_mode_local_size = 17,
+    execution_mode_local_size_id = 38,
+};
+
+enum spirv_image_dim : uint32_t
+{
+    dim_buffer = 5,
+    dim_subpass_data = 6,
+};
+
+// everything known about an id from the declarations, positions are word indices of instructions, 0 if absent
+struct id_info
+{
+    uint32_t def_pos = 0; // type, constant or variable
+    uint32_t name_pos = 0;
+    uint32_t semantic_pos = 0;
+    uint32_t descriptor_set = sc_none;
+    uint32_t binding = sc_none;
+    uint32_t location = sc_none;
+    uint32_t builtin = sc_none;
+    uint32_t array_stride = 0;
+    bool is_block = false;
+    bool is_buffer_block = false;
+    bool is_non_writable = false;
+};
+
+struct member_decoration
+{
+    uint32_t struct_id;
+    uint32_t member;
+    uint32_t decoration;
+    uint32_t value;
+};
+
+uint32_t read_word(std::byte const* ptr)
+{
+    uint32_t res;
+    std::memcpy(&res, ptr, sizeof(res));
+    return res;
+}
+
+bool get_target(uint32_t execution_model, dxcw::target& out_target)
+{
+    switch (execution_model)
+    {
+    case 0:
+        out_target = dxcw::target::vertex;
+        return true;
+    case 1:
+        out_target = dxcw::target::hull;
+        return true;
+    case 2:
+        out_target = dxcw::target::domain;
+        return true;
+    case 3:
+        out_target = dxcw::target::geometry;
+        return true;
+    case 4:
+        out_target = dxcw::target::pixel;
+        return true;
+    case 5:
+        out_target = dxcw::target::compute;
+        return true;
+    case 5267: // TaskNV
+    case 5364: // TaskEXT
+        out_target = dxcw::target::amplification;
+        return true;
+    case 5268: // MeshNV
+    case 5365: // MeshEXT
+        out_target = dxcw::target::mesh;
+        return true;
+    case 5313:
+        out_target = dxcw::target::raygeneration;
+        return true;
+    case 5314:
+        out_target = dxcw::target::intersection;
+        return true;
+    case 5315:
+        out_target = dxcw::target::anyhit;
+        return true;
+    case 5316:
+        out_target = dxcw::target::closesthit;
+        return true;
+    case 5317:
+        out_target = dxcw::target::miss;
+        return true;
+    case 5318:
+        out_target = dxcw::target::callable;
+        return true;
+    default:
+        return false;
+    }
+}
+
+// the declarations of a module, positions are word indices of instructions
+struct spirv_module
+{
+    std::byte const* data = nullptr;
+    uint32_t num_words = 0;
+    std::vector<id_info> ids;
+    std::vector<member_decoration> member_decorations; // sorted by struct and member
+    std::vector<uint32_t> entry_point_positions;
+    std::vector<uint32_t> execution_mode_positions;
+    std::vector<uint32_t> variable_positions;
+
+    uint32_t word(uint32_t index) const { return read_word(data + size_t(index) * 4); }
+
+    uint32_t get_num_instruction_words(uint32_t pos) const { return word(pos) >> 16; }
+
+    bool is_id(uint32_t id) const { return id != 0 && id < ids.size(); }
+
+    uint32_t get_opcode(uint32_t id) const { return is_id(id) && ids[id].def_pos != 0 ? word(ids[id].def_pos) & 0xFFFF : 0; }
+
+    // the instruction defining an id if it has the given opcode, 0 otherwise
+    uint32_t get_def(uint32_t id, uint32_t opcode) const { return get_opcode(id) == opcode ? ids[id].def_pos : 0; }
+
+    uint32_t get_constant_value(uint32_t id) const
+    {
+        uint32_t const pos = get_opcode(id) == op_spec_constant ? ids[id].def_pos : get_def(id, op_constant);
+        return pos != 0 ? word(pos + 3) : 0;
+    }
+
+    // the literal string operand starting at the given word of an instruction, returns its length in words including the terminator
+    uint32_t get_string(uint32_t pos, uint32_t offset, char const*& out_text, size_t& out_length) const
+    {
+        uint32_t const num_instruction_words = get_num_instruction_words(pos);
+        if (offset >= num_instruction_words)
+        {
+            out_text = "";
+            out_length = 0;
+            return 0;
+        }
+
+        out_text = reinterpret_cast<char const*>(data + (size_t(pos) + offset) * 4);
+        size_t const max_length = size_t(num_instruction_words - offset) * 4;
+        out_length = size_t(std::find(out_text, out_text + max_length, '\0') - out_text);
+        return uint32_t(out_length / 4 + 1);
+    }
+
+    bool parse(uint32_t id_bound)
+    {
+        ids.resize(id_bound);
+
+        for (uint32_t pos = sc_num_header_words; pos < num_words;)
+        {
+            uint32_t const opcode = word(pos) & 0xFFFF;
+            uint32_t const num_instruction_words = word(pos) >> 16;
+
+            if (num_instruction_words == 0 || num_instruction_words > num_words - pos)
+                return false;
+
+            // all declarations precede the function definitions
+            if (opcode == op_function)
+                break;
+
+            switch (opcode)
+            {
+            case op_name:
+                if (num_instruction_words >= 3 && is_id(word(pos + 1)))
+                    ids[word(pos + 1)].name_pos = pos;
+                break;
+            case op_entry_point:
+                if (num_instruction_words < 4)
+                    return false;
+                entry_point_positions.push_back(pos);
+                break;
+            case op_execution_mode:
+            case op_execution_mode_id:
+                if (num_instruction_words >= 6)
+                    execution_mode_positions.push_back(pos);
+                break;
+            case op_decorate:
+                if (num_instruction_words >= 3 && is_id(word(pos + 1)))
+                    read_decoration(ids[word(pos + 1)], word(pos + 2), num_instruction_words >= 4 ? word(pos + 3) : 0);
+                break;
+            case op_decorate_string:
+                if (num_instruction_words >= 4 && is_id(word(pos + 1)) && word(pos + 2) == decoration_user_semantic)
+                    ids[word(pos + 1)].semantic_pos = pos;
+                break;
+            case op_member_decorate:
+                if (num_instruction_words >= 4)
+                    member_decorations.push_back({word(pos + 1), word(pos + 2), word(pos + 3), num_instruction_words >= 5 ? word(pos + 4) : 0});
+                break;
+            case op_type_bool:
+            case op_type_int:
+            case op_type_float:
+            case op_type_vector:
+            case op_type_matrix:
+            case op_type_image:
+            case op_type_sampler:
+            case op_type_sampled_image:
+            case op_type_array:
+            case op_type_runtime_array:
+            case op_type_struct:
+            case op_type_pointer:
+            case op_type_acceleration_structure:
+                if (num_instruction_words < 2 || !is_id(word(pos + 1)) || num_instruction_words < get_min_type_words(opcode))
+                    return false;
+                ids[word(pos + 1)].def_pos = pos;
+                break;
+            case op_constant:
+            case op_spec_constant:
+            case op_variable:
+                if (num_instruction_words < 4 || !is_id(word(pos + 2)))
+                    return false;
+                ids[word(pos + 2)].def_pos = pos;
+                if (opcode == op_variable)
+                    variable_positions.push_back(pos);
+                break;
+            default:
+                break;
+            }
+
+            pos += num_instruction_words;
+        }
+
+        std::sort(member_decorations.begin(), member_decorations.end(), is_member_less);
+        return true;
+    }
+
+    static uint32_t get_min_type_words(uint32_t opcode)
+    {
+        // result id and the operands read below
+        switch (opcode)
+        {
+        case op_type_int:
+            return 4;
+        case op_type_float:
+            return 3;
+        case op_type_vector:
+        case op_type_matrix:
+        case op_type_array:
+        case op_type_pointer:
+            return 4;
+        case op_type_image:
+            return 9;
+        case op_type_runtime_array:
+            return 3;
+        default:
+            return 2;
+        }
+    }
+
+    static bool is_member_less(member_decoration const& lhs, member_decoration const& rhs)
+    {
+        return lhs.struct_id != rhs.struct_id ? lhs.struct_id < rhs.struct_id : lhs.member < rhs.member;
+    }
+
+    static void read_decoration(id_info& info, uint32_t decoration, uint32_t value)
+    {
+        switch (decoration)
+        {
+        case decoration_block:
+            info.is_block = true;
+            break;
+        case decoration_buffer_block:
+            info.is_buffer_block = true;
+            break;
+        case decoration_array_stride:
+            info.array_stride = value;
+            break;
+        case decoration_builtin:
+            info.builtin = value;
+            break;
+        case decoration_non_writable:
+            info.is_non_writable = true;
+            break;
+        case decoration_location:
+            info.location = value;
+            break;
+        case decoration_binding:
+            info.binding = value;
+            break;
+        case decoration_descriptor_set:
+            info.descriptor_set = value;
+            break;
+        default:
+            break;
+        }
+    }
+
+    member_decoration const* find_member_decoration(uint32_t struct_id, uint32_t member, uint32_t decoration) const
+    {
+        auto it = std::lower_bound(member_decorations.begin(), member_decorations.end(), member_decoration{struct_id, member, 0, 0}, is_member_less);
+        for (; it != member_decorations.end() && it->struct_id == struct_id && it->member == member; ++it)
+        {
+            if (it->decoration == decoration)
+                return &*it;
+        }
+
+        return nullptr;
+    }
+
+    bool has_member_decoration(uint32_t struct_id, uint32_t decoration) const
+    {
+        auto it = std::lower_bound(member_decorations.begin(), member_decorations.end(), member_decoration{struct_id, 0, 0, 0}, is_member_less);
+        for (; it != member_decorations.end() && it->struct_id == struct_id; ++it)
+        {
+            if (it->decoration == decoration)
+                return true;
+        }
+
+        return false;
+    }
+
+    // size of a type in an explicitly laid out block, matrix_stride and is_row_major are the decorations of the member containing it
+    uint32_t get_type_size(uint32_t type_id, uint32_t matrix_stride, bool is_row_major, unsigned depth) const
+    {
+        if (depth > 32)
+            return 0;
+
+        uint32_t const pos = is_id(type_id) ? ids[type_id].def_pos : 0;
+        switch (get_opcode(type_id))
+        {
+        case op_type_bool:
+            return 4;
+        case op_type_int:
+        case op_type_float:
+            return word(pos + 2) / 8;
+        case op_type_vector:
+            return word(pos + 3) * get_type_size(word(pos + 2), 0, false, depth + 1);
+        case op_type_matrix:
+        {
+            // columns of vectors, row major matrices are laid out as one vector per row
+            uint32_t const column_type = word(pos + 2);
+            uint32_t const num_columns = word(pos + 3);
+            if (matrix_stride == 0)
+                return num_columns * get_type_size(column_type, 0, false, depth + 1);
+
+            uint32_t const column_pos = get_def(column_type, op_type_vector);
+            uint32_t const num_rows = column_pos != 0 ? word(column_pos + 3) : 0;
+            return (is_row_major ? num_rows : num_columns) * matrix_stride;
+        }
+        case op_type_array:
+        {
+            uint32_t const length = get_constant_value(word(pos + 3));
+            uint32_t const stride = ids[type_id].array_stride;
+            return length * (stride != 0 ? stride : get_type_size(word(pos + 2), matrix_stride, is_row_major, depth + 1));
+        }
+        case op_type_struct:
+        {
+            uint32_t size = 0;
+            for (uint32_t member = 0; member + 2 < get_num_instruction_words(pos); ++member)
+            {
+                auto const* const offset = find_member_decoration(type_id, member, decoration_offset);
+                auto const* const stride = find_member_decoration(type_id, member, decoration_matrix_stride);
+                bool const row_major = find_member_decoration(type_id, member, decoration_row_major) != nullptr;
+                uint32_t const member_size = get_type_size(word(pos + 2 + member), stride ? stride->value : 0, row_major, depth + 1);
+                size = std::max(size, (offset ? offset->value : size) + member_size);
+            }
+            return size;
+        }
+        default:
+            // runtime arrays, opaque types
+            return 0;
+        }
+    }
+
+    // the type of a variable without pointer and outer array, and the amount of array elements (0 for runtime arrays)
+    uint32_t get_value_type(uint32_t variable_pos, uint32_t& out_num_elements) const
+    {
+        out_num_elements = 1;
+        uint32_t const pointer_pos = get_def(word(variable_pos + 1), op_type_pointer);
+        if (pointer_pos == 0)
+            return 0;
+
+        uint32_t const type_id = word(pointer_pos + 3);
+        if (uint32_t const array_pos = get_def(type_id, op_type_array))
+        {
+            out_num_elements = get_constant_value(word(array_pos + 3));
+            return word(array_pos + 2);
+        }
+
+        if (uint32_t const runtime_array_pos = get_def(type_id, op_type_runtime_array))
+        {
+            out_num_elements = 0;
+            return word(runtime_array_pos + 2);
+        }
+
+        return type_id;
+    }
+
+    dxcw::resource_type get_resource_type(uint32_t variable_id, uint32_t type_id, uint32_t storage_class) const
+    {
+        uint32_t const type_pos = is_id(type_id) ? ids[type_id].def_pos : 0;
+        if (type_pos == 0)
+            return dxcw::resource_type::unknown;
+
+        if (storage_class == storage_uniform_constant)
+        {
+            switch (word(type_pos) & 0xFFFF)
+            {
+            case op_type_sampler:
+                return dxcw::resource_type::sampler;
+            case op_type_sampled_image:
+                return dxcw::resource_type::combined_texture_sampler;
+            case op_type_acceleration_structure:
+                return dxcw::resource_type::acceleration_structure;
+            case op_type_image:
+            {
+                // sampled type, dim, depth, arrayed, ms, sampled (1 - with sampler, 2 - storage)
+                bool const is_storage = word(type_pos + 7) == 2;
+                switch (word(type_pos + 3))
+                {
+                case dim_buffer:
+                    return is_storage ? dxcw::resource_type::rw_typed_buffer : dxcw::resource_type::typed_buffer;
+                case dim_subpass_data:
+                    return dxcw::resource_type::input_attachment;
+                default:
+                    return is_storage ? dxcw::resource_type::rw_texture : dxcw::resource_type::texture;
+                }
+            }
+            default:
+                return dxcw::resource_type::unknown;
+            }
+        }
+
+        auto const& type = ids[type_id];
+        if ((storage_class == storage_uniform && type.is_buffer_block) || (storage_class == storage_storage_buffer && type.is_block))
+        {
+            // DXC decorates the members of read-only buffers NonWritable
+            bool const is_read_only = ids[variable_id].is_non_writable || has_member_decoration(type_id, decoration_non_writable);
+            return is_read_only ? dxcw::resource_type::buffer : dxcw::resource_type::rw_buffer;
+        }
+
+        if (storage_class == storage_uniform && type.is_block)
+            return dxcw::resource_type::constant_buffer;
+
+        return dxcw::resource_type::unknown;
+    }
+
+    // word index of the first interface id of an entry point
+    uint32_t get_interface_start(uint32_t entry_point_pos) const
+    {
+        char const* name;
+        size_t length;
+        return 3 + get_string(entry_point_pos, 3, name, length);
+    }
+
+    // index of the first entry point listing the variable in its interface, 0 if there is none
+    // SPIR-V 1.4+ interfaces contain all global variables, earlier versions only inputs and outputs
+    uint16_t find_entry_point(uint32_t variable_id) const
+    {
+        for (uint32_t i = 0; i < uint32_t(entry_point_positions.size()); ++i)
+        {
+            uint32_t const pos = entry_point_positions[i];
+            for (uint32_t j = get_interface_start(pos); j < get_num_instruction_words(pos); ++j)
+            {
+                if (word(pos + j) == variable_id)
+                    return uint16_t(i);
+            }
+        }
+
+        return 0;
+    }
+
+    bool add_string(uint32_t pos, uint32_t offset, dxcw::shader_reflection& out, uint16_t& out_offset) const
+    {
+        char const* text;
+        size_t length;
+        get_string(pos, offset, text, length);
+        return out.add_name(text, length, out_offset);
+    }
+
+    // OpName of a variable, or of its type for unnamed variables
+    bool add_variable_name(uint32_t variable_id, uint32_t type_id, dxcw::shader_reflection& out, uint16_t& out_offset) const
+    {
+        uint32_t name_pos = ids[variable_id].name_pos;
+        if (name_pos == 0 && is_id(type_id))
+            name_pos = ids[type_id].name_pos;
+
+        if (name_pos == 0)
+            return out.add_name("", 0, out_offset);
+
+        return add_string(name_pos, 2, out, out_offset);
+    }
+
+    // UserSemantic (ie. "TEXCOORD3") is split into name and index, variables without one are named by OpName
+    bool add_semantic_name(uint32_t variable_id, uint32_t type_id, dxcw::shader_reflection& out, dxcw::reflection_signature_element& element) const
+    {
+        uint32_t const semantic_pos = ids[variable_id].semantic_pos;
+        if (semantic_pos == 0)
+            return add_variable_name(variable_id, type_id, out, element.name_offset);
+
+        char const* text;
+        size_t length;
+        get_string(semantic_pos, 3, text, length);
+
+        size_t name_length = length;
+        while (name_length > 0 && text[name_length - 1] >= '0' && text[name_length - 1] <= '9')
+            --name_length;
+
+        for (size_t i = name_length; i < length; ++i)
+            element.semantic_index = element.semantic_index * 10 + uint32_t(text[i] - '0');
+
+        return out.add_name(text, name_length, element.name_offset);
+    }
+
+    void read_component_type(uint32_t type_id, dxcw::reflection_signature_element& element) const
+    {
+        element.num_components = 1;
+        if (uint32_t const vector_pos = get_def(type_id, op_type_vector))
+        {
+            element.num_components = uint8_t(word(vector_pos + 3));
+            type_id = word(vector_pos + 2);
+        }
+
+        uint32_t const pos = is_id(type_id) ? ids[type_id].def_pos : 0;
+        switch (get_opcode(type_id))
+        {
+        case op_type_bool:
+            element.type = dxcw::component_type::boolean;
+            break;
+        case op_type_int:
+        {
+            // width, signedness
+            bool const is_signed = word(pos + 3) != 0;
+            uint32_t const width = word(pos + 2);
+            if (width == 16)
+                element.type = is_signed ? dxcw::component_type::int16 : dxcw::component_type::uint16;
+            else if (width == 32)
+                element.type = is_signed ? dxcw::component_type::int32 : dxcw::component_type::uint32;
+            else if (width == 64)
+                element.type = is_signed ? dxcw::component_type::int64 : dxcw::component_type::uint64;
+            break;
+        }
+        case op_type_float:
+        {
+            uint32_t const width = word(pos + 2);
+            if (width == 16)
+                element.type = dxcw::component_type::float16;
+            else if (width == 32)
+                element.type = dxcw::component_type::float32;
+            else if (width == 64)
+                element.type = dxcw::component_type::float64;
+            break;
+        }
+        default:
+            // structs and other aggregates
+            element.num_components = 0;
+            break;
+        }
+    }
+};
+
+bool add_entry_points(spirv_module const& module, dxcw::shader_reflection& out)
+{
+    if (module.entry_point_positions.size() > dxcw::shader_reflection::max_num_entry_points)
+        return false;
+
+    for (auto const pos : module.entry_point_positions)
+    {
+        auto& entry_point = out.entry_points[out.num_entry_points++];
+        entry_point = {};
+        if (!get_target(module.word(pos + 1), entry_point.target) || !module.add_string(pos, 3, out, entry_point.name_offset))
+            return false;
+    }
+
+    // entry point, mode, operands (literals, or constant ids for LocalSizeId)
+    for (auto const pos : module.execution_mode_positions)
+    {
+        bool const is_id_mode = (module.word(pos) & 0xFFFF) == op_execution_mode_id;
+        if (module.word(pos + 2) != (is_id_mode ? execution_mode_local_size_id : execution_mode_local_size))
+            continue;
+
+        for (uint32_t i = 0; i < uint32_t(module.entry_point_positions.size()); ++i)
+        {
+            if (module.word(module.entry_point_positions[i] + 2) != module.word(pos + 1))
+                continue;
+
+            for (uint32_t dim = 0; dim < 3; ++dim)
+            {
+                uint32_t const operand = module.word(pos + 3 + dim);
+                out.entry_points[i].thread_group_size[dim] = is_id_mode ? module.get_constant_value(operand) : operand;
+            }
+        }
+    }
+
+    return true;
+}
+
+bool add_resources(spirv_module const& module, dxcw::shader_reflection& out)
+{
+    for (auto const pos : module.variable_positions)
+    {
+        // result type, result id, storage class
+        uint32_t const variable_id = module.word(pos + 2);
+        uint32_t const storage_class = module.word(pos + 3);
+
+        if (storage_class != storage_uniform_constant && storage_class != storage_uniform && storage_class != storage_storage_buffer
+            && storage_class != storage_push_constant)
+            continue;
+
+        uint32_t num_elements;
+        uint32_t const type_id = module.get_value_type(pos, num_elements);
+
+        if (storage_class == storage_push_constant)
+        {
+            if (out.num_push_constants >= dxcw::shader_reflection::max_num_push_constants)
+                return false;
+
+            auto& push_constants = out.push_constants[out.num_push_constants++];
+            push_constants = {};
+            push_constants.entry_point_index = module.find_entry_point(variable_id);
+            push_constants.size = module.get_type_size(type_id, 0, false, 0);
+            if (!module.add_variable_name(variable_id, type_id, out, push_constants.name_offset))
+                return false;
+
+            continue;
+        }
+
+        if (out.num_bindings >= dxcw::shader_reflection::max_num_bindings)
+            return false;
+
+        auto& binding = out.bindings[out.num_bindings++];
+        binding = {};
+        binding.type = module.get_resource_type(variable_id, type_id, storage_class);
+        binding.space = module.ids[variable_id].descriptor_set;
+        binding.binding = module.ids[variable_id].binding;
+        binding.num_elements = num_elements;
+
+        if (binding.type == dxcw::resource_type::constant_buffer)
+            binding.size = module.get_type_size(type_id, 0, false, 0);
+
+        if (!module.add_variable_name(variable_id, type_id, out, binding.name_offset))
+            return false;
+    }
+
+    return true;
+}
+
+bool add_signature_elements(spirv_module const& module, dxcw::shader_reflection& out)
+{
+    for (uint32_t i = 0; i < uint32_t(module.entry_point_positions.size()); ++i)
+    {
+        uint32_t const pos = module.entry_point_positions[i];
+        for (uint32_t j = module.get_interface_start(pos); j < module.get_num_instruction_words(pos); ++j)
+        {
+            uint32_t const variable_id = module.word(pos + j);
+            uint32_t const variable_pos = module.get_def(variable_id, op_variable);
+            if (variable_pos == 0)
+                continue;
+
+            uint32_t const storage_class = module.word(variable_pos + 3);
+            if (storage_class != storage_input && storage_class != storage_output)
+                continue;
+
+            if (out.num_signature_elements >= dxcw::shader_reflection::max_num_signature_elements)
+                return false;
+
+            auto& element = out.signature_elements[out.num_signature_elements++];
+            element = {};
+            element.entry_point_index = uint16_t(i);
+            element.is_output = storage_class == storage_output;
+            element.location = module.ids[variable_id].location;
+            element.builtin = module.ids[variable_id].builtin;
+
+            // arrays (ie. per-vertex inputs, SV_ClipDistance) are described by their elements
+            uint32_t num_elements;
+            uint32_t type_id = module.get_value_type(variable_pos, num_elements);
+            while (uint32_t const array_pos = module.get_def(type_id, op_type_array))
+                type_id = module.word(array_pos + 2);
+
+            module.read_component_type(type_id, element);
+            if (!module.add_semantic_name(variable_id, type_id, out, element))
+                return false;
+        }
+    }
+
+    return true;
+}
+}
+
+bool dxcw::detail::spirv_reflect(std::byte const* data, size_t num_bytes, shader_reflection* out_reflection)
+{
+    CC_CONTRACT(out_reflection);
+    CC_ASSERT((num_bytes == 0 || data) && "invalid buffer");
+
+    if (num_bytes % 4 != 0 || num_bytes < sc_num_header_words * 4 || num_bytes / 4 > 0xFFFFFFFFu || read_word(data) != sc_spirv_magic)
+        return false;
+
+    // magic, version, generator, id bound, schema
+    uint32_t const id_bound = read_word(data + 12);
+    if (id_bound == 0 || id_bound > sc_max_id_bound)
+        return false;
+
+    auto& out = *out_reflection;
+    out.string_buffer_size = 0;
+    out.num_entry_points = 0;
+    out.num_bindings = 0;
+    out.num_push_constants = 0;
+    out.num_signature_elements = 0;
+
+    spirv_module module;
+    module.data = data;
+    module.num_words = uint32_t(num_bytes / 4);
+    if (!module.parse(id_bound))
+        return false;
+
+    return add_entry_points(module, out) && add_resources(module, out) && add_signature_elements(module, out);
+}
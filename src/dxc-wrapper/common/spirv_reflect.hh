@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstddef>
+
+#include <dxc-wrapper/common/api.hh>
+
+namespace dxcw
+{
+struct shader_reflection;
+}
+
+namespace dxcw::detail
+{
+/// reads entry points, resource bindings, push constants and stage inputs / outputs from a SPIR-V module
+///
+/// only the declarations preceding the first function are parsed, function bodies are skipped
+/// bindings are all variables in the UniformConstant, Uniform and StorageBuffer storage classes (DXC removes unused resources),
+/// stage inputs and outputs are the Input and Output variables in the interface of each entry point
+/// semantic names are read from the UserSemantic decorations of -fspv-reflect, other names from OpName (removed by strip_debug)
+
+/// returns false if the data is not a well-formed SPIR-V module or exceeds the capacity of out_reflection
+DXCW_API bool spirv_reflect(std::byte const* data, size_t num_bytes, shader_reflection* out_reflection);
+}
@@ -0,0 +1,181 @@
+#include "spirv_strip.hh"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <clean-core/assert.hh>
+
+namespace
+{
+constexpr uint32_t sc_spirv_magic = 0x07230203;
+constexpr uint32_t sc_num_header_words = 5;
+
+enum spirv_op : uint32_t
+{
+    op_source_continued = 2,
+    op_source = 3,
+    op_source_extension = 4,
+    op_name = 5,
+    op_member_name = 6,
+    op_string = 7,
+    op_line = 8,
+    op_extension = 10,
+    op_ext_inst_import = 11,
+    op_ext_inst = 12,
+    op_no_line = 317,
+    op_module_processed = 330,
+    op_decorate_id = 332,
+    op_decorate_string = 5632,
+    op_member_decorate_string = 5633,
+};
+
+enum spirv_decoration : uint32_t
+{
+    decoration_hlsl_counter_buffer = 5634,
+    decoration_user_semantic = 5635,
+    decoration_user_type = 5636,
+};
+
+uint32_t read_word(std::byte const* ptr)
+{
+    uint32_t res;
+    std::memcpy(&res, ptr, sizeof(res));
+    return res;
+}
+
+// true if the literal string operand starting at word offset of an instruction begins with prefix
+bool has_string_prefix(std::byte const* instruction, uint32_t num_instruction_words, uint32_t offset, char const* prefix)
+{
+    if (offset >= num_instruction_words)
+        return false;
+
+    auto const* const text = reinterpret_cast<char const*>(instruction + size_t(offset) * 4);
+    size_t const max_length = size_t(num_instruction_words - offset) * 4;
+    size_t const prefix_length = std::strlen(prefix);
+    return prefix_length <= max_length && std::memcmp(text, prefix, prefix_length) == 0;
+}
+
+bool is_debug_info_set(std::byte const* instruction, uint32_t num_instruction_words)
+{
+    // OpExtInstImport: result id, name
+    return has_string_prefix(instruction, num_instruction_words, 2, "OpenCL.DebugInfo.100")
+           || has_string_prefix(instruction, num_instruction_words, 2, "NonSemantic.Shader.DebugInfo.");
+}
+
+bool is_reflection_extension(std::byte const* instruction, uint32_t num_instruction_words)
+{
+    // OpExtension: name, full names including the terminator
+    return has_string_prefix(instruction, num_instruction_words, 1, "SPV_GOOGLE_hlsl_functionality1")
+           || has_string_prefix(instruction, num_instruction_words, 1, "SPV_GOOGLE_user_type");
+}
+}
+
+size_t dxcw::detail::spirv_strip(std::byte const* data, size_t num_bytes, bool strip_debug, bool strip_reflection, std::byte* out_data)
+{
+    CC_ASSERT((num_bytes == 0 || (data && out_data)) && "invalid buffers");
+
+    if (num_bytes % 4 != 0 || num_bytes < sc_num_header_words * 4 || num_bytes / 4 > 0xFFFFFFFFu || read_word(data) != sc_spirv_magic)
+        return 0;
+
+    auto const num_words = uint32_t(num_bytes / 4);
+    auto const word = [&](uint32_t index) { return read_word(data + size_t(index) * 4); };
+
+    // first pass: validate the layout, find the debug info sets and the strings referenced by other extended instructions (ie. debug printf)
+    std::vector<uint32_t> debug_sets;
+    std::vector<uint32_t> referenced_ids;
+    for (uint32_t pos = sc_num_header_words; pos < num_words;)
+    {
+        uint32_t const opcode = word(pos) & 0xFFFF;
+        uint32_t const num_instruction_words = word(pos) >> 16;
+
+        if (num_instruction_words == 0 || num_instruction_words > num_words - pos)
+            return 0;
+
+        if (opcode == op_ext_inst_import && num_instruction_words >= 2 && is_debug_info_set(data + size_t(pos) * 4, num_instruction_words))
+        {
+            debug_sets.push_back(word(pos + 1));
+        }
+        else if (opcode == op_ext_inst && num_instruction_words >= 5
+                 && std::find(debug_sets.begin(), debug_sets.end(), word(pos + 3)) == debug_sets.end())
+        {
+            // result type, result id, set, instruction, then operands
+            for (uint32_t i = 5; i < num_instruction_words; ++i)
+                referenced_ids.push_back(word(pos + i));
+        }
+
+        pos += num_instruction_words;
+    }
+
+    std::sort(referenced_ids.begin(), referenced_ids.end());
+
+    auto const f_is_stripped = [&](uint32_t pos, uint32_t opcode, uint32_t num_instruction_words) -> bool
+    {
+        if (strip_debug)
+        {
+            switch (opcode)
+            {
+            case op_source_continued:
+            case op_source:
+            case op_source_extension:
+            case op_name:
+            case op_member_name:
+            case op_line:
+            case op_no_line:
+            case op_module_processed:
+                return true;
+            case op_string:
+                return num_instruction_words >= 2 && !std::binary_search(referenced_ids.begin(), referenced_ids.end(), word(pos + 1));
+            case op_ext_inst_import:
+                return num_instruction_words >= 2 && std::find(debug_sets.begin(), debug_sets.end(), word(pos + 1)) != debug_sets.end();
+            case op_ext_inst:
+                return num_instruction_words >= 4 && std::find(debug_sets.begin(), debug_sets.end(), word(pos + 3)) != debug_sets.end();
+            default:
+                break;
+            }
+        }
+
+        if (strip_reflection)
+        {
+            switch (opcode)
+            {
+            case op_extension:
+                return is_reflection_extension(data + size_t(pos) * 4, num_instruction_words);
+            case op_decorate_id:
+                // target, decoration, ids
+                return num_instruction_words >= 3 && word(pos + 2) == decoration_hlsl_counter_buffer;
+            case op_decorate_string:
+                // target, decoration, strings
+                return num_instruction_words >= 3 && (word(pos + 2) == decoration_user_semantic || word(pos + 2) == decoration_user_type);
+            case op_member_decorate_string:
+                // target, member, decoration, strings
+                return num_instruction_words >= 4 && (word(pos + 3) == decoration_user_semantic || word(pos + 3) == decoration_user_type);
+            default:
+                break;
+            }
+        }
+
+        return false;
+    };
+
+    // second pass: copy the header and all remaining instructions
+    std::memcpy(out_data, data, sc_num_header_words * 4);
+    size_t out_size = sc_num_header_words * 4;
+
+    for (uint32_t pos = sc_num_header_words; pos < num_words;)
+    {
+        uint32_t const opcode = word(pos) & 0xFFFF;
+        uint32_t const num_instruction_words = word(pos) >> 16;
+
+        if (!f_is_stripped(pos, opcode, num_instruction_words))
+        {
+            std::memcpy(out_data + out_size, data + size_t(pos) * 4, size_t(num_instruction_words) * 4);
+            out_size += size_t(num_instruction_words) * 4;
+        }
+
+        pos += num_instruction_words;
+    }
+
+    return out_size;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstddef>
+
+#include <dxc-wrapper/common/api.hh>
+
+namespace dxcw::detail
+{
+/// removes instructions without influence on the executed code from a SPIR-V module
+///
+/// debug: OpSource*, OpName, OpMemberName, OpLine, OpNoLine, OpModuleProcessed, and the instructions of
+///        OpenCL.DebugInfo.100 and NonSemantic.Shader.DebugInfo.* (-fspv-debug), OpStrings are kept if other instructions reference them
+/// reflection: the decorations of -fspv-reflect (UserSemantic, UserTypeGOOGLE, HlslCounterBufferGOOGLE) and their extensions
+/// the id bound is unchanged, stripping never grows a module
+
+/// writes the stripped module to out_data, which must hold num_bytes bytes
+/// returns the stripped size, or 0 if the data is not a well-formed SPIR-V module
+DXCW_API size_t spirv_strip(std::byte const* data, size_t num_bytes, bool strip_debug, bool strip_reflection, std::byte* out_data);
+}
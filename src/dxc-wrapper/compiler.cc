@@ -1,8 +1,17 @@
 #include "compiler.hh"
 
+#include <algorithm>
+#include <atomic>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <cwchar>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 #ifdef DXCW_HAS_OPTICK
 #include <optick.h>
@@ -50,7 +59,7 @@ struct IUnknown;
 
 #include <dxc/dxcapi.h>
 
-#include <clean-core/alloc_array.hh>
+#include <clean-core/alloc_vector.hh>
 #include <clean-core/array.hh>
 #include <clean-core/assert.hh>
 #include <clean-core/capped_vector.hh>
@@ -58,6 +67,7 @@ struct IUnknown;
 #include <clean-core/native/wchar_conversion.hh>
 
 #include "common/log.hh"
+#include "common/spirv_strip.hh"
 
 #define DXCW_STR(S) #S
 #define DXCW_XSTR(S) DXCW_STR(S)
@@ -107,6 +117,22 @@ char get_shader_profile_char(dxcw::target target)
 
 char const* get_output_type_literal(dxcw::output output) { return (output == dxcw::output::dxil) ? "DXIL" : "SPIR-V"; }
 
+// adds the arguments building debug information (without -Od)
+void add_debug_info_args(std::vector<LPCWSTR>& out_args, dxcw::output output, dxcw::debug_info debug_info)
+{
+    // SPIR-V has no external PDBs, its debug information is always part of the module
+    if (output == dxcw::output::spirv || debug_info == dxcw::debug_info::embedded)
+    {
+        out_args.push_back(L"-Zi");           // -Zi: build debug information
+        out_args.push_back(L"-Qembed_debug"); // embed debug info as opposed to creating a PDB
+        return;
+    }
+
+    // the PDB is returned as DXC_OUT_PDB, named by the shader hash which is also stored in the binary
+    out_args.push_back(debug_info == dxcw::debug_info::pdb_slim ? L"-Zs" : L"-Zi");
+    out_args.push_back(L"-Qstrip_debug");
+}
+
 [[maybe_unused]] wchar_t const* get_library_export_name(dxcw::target tgt, unsigned& out_strlen)
 {
     using ct = dxcw::target;
@@ -146,85 +172,364 @@ void verify_hres(HRESULT hres) { CC_RUNTIME_ASSERT(SUCCEEDED(hres) && "DXC opera
             _ptr_->Release(); \
     }
 
-struct argument_memory
+// include handler that loads each file only once, can be shared by multiple compilations running in parallel
+struct cached_include_handler final : public IDxcIncludeHandler
 {
-    cc::alloc_array<LPCWSTR> pointers;
-    size_t num_arguments = 0;
+    explicit cached_include_handler(IDxcUtils* utils) : _utils(utils) {}
 
-    void initialize(size_t max_num_args, cc::allocator* alloc)
+    ~cached_include_handler()
     {
-        pointers = cc::alloc_array<LPCWSTR>::uninitialized(max_num_args, alloc);
-        num_arguments = 0;
+        for (auto const& [filename, blob] : _blobs)
+        {
+            if (blob)
+                blob->Release();
+        }
     }
 
+    HRESULT STDMETHODCALLTYPE LoadSource(LPCWSTR pFilename, IDxcBlob** ppIncludeSource) override
+    {
+        std::lock_guard lg(_mutex);
+
+        // failed lookups are cached as well, DXC probes every include path for each #include
+        auto [it, is_new] = _blobs.try_emplace(pFilename, nullptr);
+        if (is_new && FAILED(_utils->LoadFile(pFilename, nullptr, &it->second)))
+        {
+            it->second = nullptr;
+        }
+
+        *ppIncludeSource = it->second;
+        if (!it->second)
+            return E_FAIL;
+
+        it->second->AddRef();
+        return S_OK;
+    }
+
+    HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** ppvObject) override
+    {
+        if (IsEqualIID(riid, __uuidof(IDxcIncludeHandler)) || IsEqualIID(riid, __uuidof(IUnknown)))
+        {
+            AddRef();
+            *ppvObject = static_cast<IDxcIncludeHandler*>(this);
+            return S_OK;
+        }
+
+        *ppvObject = nullptr;
+        return E_NOINTERFACE;
+    }
+
+    ULONG STDMETHODCALLTYPE AddRef() override { return ++_refcount; }
+
+    ULONG STDMETHODCALLTYPE Release() override
+    {
+        ULONG const res = --_refcount;
+        if (res == 0)
+            delete this;
+        return res;
+    }
+
+private:
+    IDxcUtils* const _utils;
+    std::atomic<ULONG> _refcount = {1};
+    std::mutex _mutex;
+    std::unordered_map<std::wstring, IDxcBlobEncoding*> _blobs;
+};
+
+}
+
+// growable argument list for IDxcCompiler3::Compile
+// buffers only grow and are kept across compilations, reset() only clears them
+// arguments that only depend on output, target, shader model and debug flag are built once per combination (see add_shader_template_args)
+// converted text is referenced by offset until get_data() as the text buffer moves when growing
+struct dxcw::detail::argument_builder
+{
+    static constexpr size_t literal_offset = size_t(-1);
+
+    cc::alloc_vector<LPCWSTR> pointers;
+    cc::alloc_vector<size_t> text_offsets; // per argument, offset into text or literal_offset if pointers[i] is a static string
+    cc::alloc_vector<wchar_t> text;
+
+    // immutable arguments per (output, target, shader model, debug) tuple
+    struct argument_template
+    {
+        std::vector<LPCWSTR> args;
+        std::wstring profile;
+    };
+    std::unordered_map<uint32_t, argument_template> shader_templates;
+    // wide copies of include paths, keyed by their UTF-8 text
+    std::unordered_map<std::string, std::wstring> cached_texts;
+    std::string lookup_key;
+
+    static void build_shader_template(
+        argument_template& tmpl, dxcw::output output, dxcw::target target, int sm_minor, bool build_debug, dxcw::debug_info debug_info)
+    {
+        using namespace dxcw;
+
+        if (output == output::spirv)
+        {
+            // SPIR-V specific flags
+
+            // -fvk-use-dx-layout: no std140/std430/other vulkan-specific layouting, behave just like HLSL->D3D12
+            // -fvk-b/t/u/s-shift: shift registers up to avoid overlap, phi-specific
+            tmpl.args = {L"-spirv",       L"-fspv-target-env=vulkan1.1", L"-fvk-use-dx-layout", L"-fvk-b-shift", L"0",   L"all", L"-fvk-t-shift", L"1000",
+                         L"all",          L"-fvk-u-shift",               L"2000",               L"all",          L"-fvk-s-shift", L"3000", L"all"};
+
+            if (target == target::vertex || target == target::geometry || target == target::domain)
+            {
+                // -fvk-invert-y (only in vs/gs/ds): line up vulkans flipped viewport to behave just like HLSL->D3D12
+                tmpl.args.push_back(L"-fvk-invert-y");
+            }
+        }
+        else if (output == output::dxil)
+        {
+            // suppress warnings about [[vk::push_constant]] when compiling to dxil
+            tmpl.args.push_back(L"-Wno-ignored-attributes");
+        }
+
+        if (build_debug)
+        {
+            tmpl.args.push_back(L"-Od"); // disable optimization
+            add_debug_info_args(tmpl.args, output, debug_info);
+        }
+        else
+        {
+            tmpl.args.push_back(L"-O3"); // full optimization
+        }
+
+        // profile target, a string like vs_6_6
+        // first char is the "target" (shader stage)
+        // last int is the minor SM version
+        char buf[32];
+        int const len = snprintf(buf, sizeof(buf), "%cs_6_%d", get_shader_profile_char(target), sm_minor);
+        tmpl.profile.assign(buf, buf + len);
+
+        tmpl.args.push_back(L"-T");
+        tmpl.args.push_back(tmpl.profile.c_str());
+    }
+
+    explicit argument_builder(cc::allocator* alloc) : pointers(alloc), text_offsets(alloc), text(alloc)
+    {
+        pointers.reserve(64);
+        text_offsets.reserve(64);
+        text.reserve(4096);
+    }
+
+    void reset()
+    {
+        pointers.clear();
+        text_offsets.clear();
+        text.clear();
+    }
+
+    // adds a string that outlives the compilation (literals)
     void add_arg(wchar_t const* str)
     {
-        CC_ASSERT(num_arguments < pointers.size() && "write OOB");
-        pointers[num_arguments] = str;
-        ++num_arguments;
+        pointers.push_back(str);
+        text_offsets.push_back(literal_offset);
     }
 
     void add_multiple_args(wchar_t const* const* strs, size_t num)
     {
-        CC_ASSERT(num_arguments + num <= pointers.size() && "write OOB");
-        std::memcpy(pointers.data() + num_arguments, &strs[0], num * sizeof(wchar_t const*));
-        num_arguments += num;
+        for (auto i = 0u; i < num; ++i)
+            add_arg(strs[i]);
+    }
+
+    // converts and appends null-terminated text, returns its offset
+    size_t append_text(char const* str)
+    {
+        auto const offset = text.size();
+        // a wide string never has more characters than its UTF-8 source
+        auto const max_num_chars = std::strlen(str) + 1;
+        text.resize(offset + max_num_chars);
+
+        auto const num_wchars_written = cc::char_to_widechar(cc::span<wchar_t>(text.data() + offset, max_num_chars), str);
+        text.resize(offset + num_wchars_written + 1);
+        return offset;
+    }
+
+    void add_text_arg(size_t text_offset)
+    {
+        pointers.push_back(nullptr);
+        text_offsets.push_back(text_offset);
+    }
+
+    void add_converted_arg(char const* str) { add_text_arg(append_text(str)); }
+
+    // adds a converted string that is cached for the lifetime of the builder (include paths)
+    void add_cached_text_arg(char const* str)
+    {
+        // the lookup key is reused as well, include paths are looked up on every compilation
+        lookup_key.assign(str);
+        auto const [it, is_new] = cached_texts.try_emplace(lookup_key);
+        if (is_new)
+        {
+            auto const max_num_chars = std::strlen(str) + 1;
+            it->second.resize(max_num_chars);
+            auto const num_wchars_written = cc::char_to_widechar(cc::span<wchar_t>(it->second.data(), max_num_chars), str);
+            it->second.resize(num_wchars_written);
+        }
+
+        add_arg(it->second.c_str());
+    }
+
+    // adds all arguments depending only on output, shader stage, shader model and debug settings
+    void add_shader_template_args(dxcw::output output, dxcw::target target, dxcw::shader_model sm, bool build_debug, dxcw::debug_info debug_info)
+    {
+        int const sm_minor = get_shader_model_minor_version(sm);
+        uint32_t const debug_key = build_debug ? 1 + uint32_t(debug_info) : 0;
+        uint32_t const key = uint32_t(output) | uint32_t(target) << 8 | uint32_t(sm_minor) << 16 | debug_key << 24;
+
+        // templates are built in place and never move, the profile pointer stays valid
+        auto const [it, is_new] = shader_templates.try_emplace(key);
+        auto& tmpl = it->second;
+        if (is_new)
+        {
+            build_shader_template(tmpl, output, target, sm_minor, build_debug, debug_info);
+        }
+
+        for (LPCWSTR const arg : tmpl.args)
+            add_arg(arg);
+    }
+
+    // adds an -exports entry of the form <export name>=<internal name> or only <internal name>
+    void add_export_arg(char const* export_name, char const* internal_name)
+    {
+        CC_ASSERT(internal_name != nullptr && "internal name is required on library exports");
+
+        if (!export_name)
+        {
+            add_converted_arg(internal_name);
+            return;
+        }
+
+        auto const offset = append_text(export_name);
+        // replace the null terminator with the equals sign, the internal name follows directly
+        text.back() = L'=';
+        append_text(internal_name);
+        add_text_arg(offset);
     }
 
+    // resolves text offsets, the result is valid until the next modification
     LPCWSTR* get_data()
     {
-        if (num_arguments == 0)
+        if (pointers.empty())
         {
             return nullptr;
         }
 
+        for (auto i = 0u; i < pointers.size(); ++i)
+        {
+            if (text_offsets[i] != literal_offset)
+                pointers[i] = text.data() + text_offsets[i];
+        }
+
         return pointers.data();
     }
 
-    uint32_t get_num() const { return uint32_t(num_arguments); }
+    uint32_t get_num() const { return uint32_t(pointers.size()); }
 };
 
-struct widechar_memory
+// IDxcCompiler3 instances and argument memory of the additional threads of compile_shader_multi_result
+// created when more threads are used than before, and kept until the compiler is destroyed
+struct dxcw::detail::worker_compilers
 {
-    cc::alloc_array<wchar_t> buffer;
-    size_t num_chars = 0;
+    struct worker
+    {
+        IDxcCompiler3* compiler = nullptr;
+        std::unique_ptr<argument_builder> arguments;
+    };
+
+    std::vector<worker> workers;
+};
+
+namespace
+{
+IDxcResult* compile_shader_with(IDxcCompiler3* compiler,
+                                IDxcIncludeHandler* include_handler,
+                                dxcw::detail::argument_builder& args,
+                                dxcw::shader_description const& shader,
+                                dxcw::compilation_config const& config)
+{
+    using namespace dxcw;
+
+    size_t const raw_text_length = shader.raw_text_length > 0 ? shader.raw_text_length : std::strlen(shader.raw_text);
+    CC_ASSERT(raw_text_length > 0 && "DXCW shader src text empty");
 
-    void initialize(size_t max_num_chars, cc::allocator* alloc)
+    args.reset();
+
+    if (config.filename_for_errors)
     {
-        buffer = cc::alloc_array<wchar_t>::uninitialized(max_num_chars, alloc);
-        num_chars = 0;
+        // the filename for errors is simply any non-flag argument to the compilation
+        args.add_converted_arg(config.filename_for_errors);
     }
 
-    wchar_t const* add_text(wchar_t const* text, size_t strlen)
-    {
-        CC_ASSERT(num_chars + strlen <= buffer.size() && "text write OOB");
+    // output, stage, shader model and optimization flags
+    args.add_shader_template_args(config.output_format, shader.target, shader.sm, config.build_debug, config.debug_info);
 
-        wchar_t* const res = buffer.data() + num_chars;
-        std::memcpy(res, text, strlen * sizeof(wchar_t));
-        num_chars += strlen;
+    // entrypoint
+    args.add_arg(L"-E");
+    args.add_converted_arg(shader.entrypoint);
 
-        return res;
+    // include paths
+    for (char const* additional_include_path : config.additional_include_paths)
+    {
+        args.add_arg(L"-I");
+        args.add_cached_text_arg(additional_include_path);
     }
 
-    wchar_t const* convert_and_add_text(char const* text, int opt_num_src_chars = -1)
+    // defines
+    for (char const* const define : config.defines)
     {
-        auto const destination_span = cc::span(buffer).subspan(num_chars, buffer.size() - num_chars);
-        auto const num_wchars_written = cc::char_to_widechar(destination_span, text, opt_num_src_chars);
-        num_chars += num_wchars_written + 1;
-
-        return destination_span.data();
+        args.add_arg(L"-D");
+        args.add_converted_arg(define);
     }
 
-    wchar_t const* add_profile_text(dxcw::target target, dxcw::shader_model sm)
+    DxcBuffer source_buffer;
+    source_buffer.Ptr = shader.raw_text;
+    source_buffer.Size = raw_text_length;
+    source_buffer.Encoding = CP_UTF8;
+
+    IDxcResult* result = nullptr;
+    compiler->Compile(&source_buffer, args.get_data(), args.get_num(), include_handler, IID_PPV_ARGS(&result));
+    return result;
+}
+
+void log_result_errors(dxcw::compiler& compiler, IDxcResult* result, dxcw::compilation_config const& config, char const* opt_entrypoint)
+{
+    // Print errors and warning if present
+    IDxcBlobUtf8* pErrors = nullptr;
+    char* pErrorString = nullptr;
+    DEFER_RELEASE(pErrors);
+    if (compiler.get_result_error_string(result, &pErrors, &pErrorString))
     {
-        char buf[128];
-        // assemble a string like vs_6_6
-        // first char is the "target" (shader stage)
-        // last int is the minor SM version
-        snprintf(buf, sizeof(buf), "%cs_6_%d", get_shader_profile_char(target), get_shader_model_minor_version(sm));
-        return convert_and_add_text(buf);
+        if (compiler._diagnostic_callback)
+        {
+            compiler._diagnostic_callback(compiler._diagnostic_userdata, config, opt_entrypoint, pErrorString);
+            return;
+        }
+
+        if (opt_entrypoint)
+            DXCW_LOG_ERROR(R"(shader "{}", entrypoint "{}" ({}):)", config.filename_for_errors, opt_entrypoint, get_output_type_literal(config.output_format));
+        else
+            DXCW_LOG_ERROR(R"(shader library "{}" ({}):)", config.filename_for_errors, get_output_type_literal(config.output_format));
+
+        DXCW_LOG_ERROR("{}", pErrorString);
     }
-};
+}
+
+// extracts the external PDB of a successful compilation into out_pdb, if it is requested and the config produces one
+void get_requested_pdb(dxcw::compiler& compiler, IDxcResult* result, dxcw::compilation_config const& config, dxcw::external_pdb* out_pdb)
+{
+    if (!out_pdb)
+        return;
+
+    // SPIR-V has no external PDBs
+    if (!config.build_debug || config.debug_info == dxcw::debug_info::embedded || config.output_format != dxcw::output::dxil)
+        return;
+
+    if (!compiler.get_result_pdb(result, &out_pdb->data, out_pdb->name, sizeof(out_pdb->name)))
+        *out_pdb = dxcw::external_pdb{};
+}
 }
 
 void dxcw::compiler::initialize()
@@ -238,6 +543,8 @@ void dxcw::compiler::initialize()
     verify_hres(DxcCreateInstance(CLSID_DxcCompiler, IID_PPV_ARGS(&_compiler)));
     verify_hres(DxcCreateInstance(CLSID_DxcUtils, IID_PPV_ARGS(&_utils)));
     verify_hres(_lib->CreateIncludeHandler(&_include_handler));
+    _arguments = new detail::argument_builder(cc::system_allocator);
+    _workers = new detail::worker_compilers();
     // verify_hres(DxcCreateInstance(CLSID_DxcContainerReflection, IID_PPV_ARGS(&_reflection)));
 }
 
@@ -263,9 +570,17 @@ void dxcw::compiler::destroy()
     _utils = nullptr;
     _lib->Release();
     _lib = nullptr;
+    delete _arguments;
+    _arguments = nullptr;
+
+    for (auto& worker : _workers->workers)
+        worker.compiler->Release();
+
+    delete _workers;
+    _workers = nullptr;
 }
 
-IDxcResult* dxcw::compiler::compile_shader_result(shader_description const& shader, compilation_config const& config, cc::allocator* scratch_alloc)
+IDxcResult* dxcw::compiler::compile_shader_result(shader_description const& shader, compilation_config const& config, cc::allocator* /*scratch_alloc*/)
 {
 #ifdef DXCW_HAS_OPTICK
     OPTICK_EVENT();
@@ -275,97 +590,79 @@ IDxcResult* dxcw::compiler::compile_shader_result(shader_description const& shad
     CC_CONTRACT(shader.entrypoint);
     CC_ASSERT(_lib != nullptr && "Uninitialized dxcw::compiler");
 
-    IDxcBlobEncoding* encoding = nullptr;
-    DEFER_RELEASE(encoding);
+    return compile_shader_with(_compiler, _include_handler, *_arguments, shader, config);
+}
 
-    // nocheckin what's the use here?
-    auto const raw_text_length = uint32_t(std::strlen(shader.raw_text));
-    CC_ASSERT(raw_text_length > 0 && "DXCW shader src text empty");
-    _lib->CreateBlobWithEncodingFromPinned(shader.raw_text, raw_text_length, CP_UTF8, &encoding);
+void dxcw::compiler::compile_shader_multi_result(cc::string_view raw_text,
+                                                 cc::span<entrypoint_description const> entrypoints,
+                                                 compilation_config const& config,
+                                                 cc::span<IDxcResult*> out_results,
+                                                 unsigned max_num_threads)
+{
+#ifdef DXCW_HAS_OPTICK
+    OPTICK_EVENT();
+#endif
 
-    widechar_memory wmem;
-    size_t num_chars_defines = 0;
-    for (char const* const define : config.defines)
-    {
-        num_chars_defines += std::strlen(define) + 1;
-    }
-    wmem.initialize(1024 + 1024 + 1024 + num_chars_defines, scratch_alloc);
+    // an empty view would be passed on with length 0, which means null-terminated
+    CC_CONTRACT(!raw_text.empty());
+    CC_CONTRACT(out_results.size() >= entrypoints.size());
+    CC_ASSERT(_lib != nullptr && "Uninitialized dxcw::compiler");
 
-    argument_memory argmem;
-    argmem.initialize(30, scratch_alloc);
+    // all compilations share the source text and one include cache
+    auto* const include_handler = new cached_include_handler(_utils);
+    DEFER_RELEASE(include_handler);
 
-    if (config.filename_for_errors)
-    {
-        // the filename for errors is simply any non-flag argument to the compilation
-        argmem.add_arg(wmem.convert_and_add_text(config.filename_for_errors));
-    }
+    unsigned const num_entrypoints = unsigned(entrypoints.size());
+    if (max_num_threads == 0)
+        max_num_threads = std::max(1u, std::thread::hardware_concurrency());
 
-    if (config.output_format == output::spirv)
+    unsigned const num_threads = std::min(max_num_threads, num_entrypoints);
+
+    std::atomic<unsigned> next_entrypoint = {0};
+    auto const f_work = [&](IDxcCompiler3* dxc_compiler, detail::argument_builder& args)
     {
-        // SPIR-V specific flags
+        for (unsigned i = next_entrypoint.fetch_add(1); i < num_entrypoints; i = next_entrypoint.fetch_add(1))
+        {
+            CC_CONTRACT(entrypoints[i].entrypoint);
 
-        // -fvk-use-dx-layout: no std140/std430/other vulkan-specific layouting, behave just like HLSL->D3D12
-        // -fvk-b/t/u/s-shift: shift registers up to avoid overlap, phi-specific
-        wchar_t const* spirv_args[] = {
-            L"-spirv", L"-fspv-target-env=vulkan1.1", L"-fvk-use-dx-layout", L"-fvk-b-shift", L"0", L"all", L"-fvk-t-shift", L"1000", L"all", L"-fvk-u-shift", L"2000", L"all", L"-fvk-s-shift", L"3000", L"all"};
-        argmem.add_multiple_args(spirv_args, CC_COUNTOF(spirv_args));
+            shader_description shader = {};
+            shader.raw_text = raw_text.data();
+            shader.raw_text_length = raw_text.size();
+            shader.entrypoint = entrypoints[i].entrypoint;
+            shader.target = entrypoints[i].target;
+            shader.sm = entrypoints[i].sm;
 
-        if (shader.target == target::vertex || shader.target == target::geometry || shader.target == target::domain)
-        {
-            // -fvk-invert-y (only in vs/gs/ds): line up vulkans flipped viewport to behave just like HLSL->D3D12
-            argmem.add_arg(L"-fvk-invert-y");
+            out_results[i] = compile_shader_with(dxc_compiler, include_handler, args, shader, config);
         }
-    }
-    else if (config.output_format == output::dxil)
-    {
-        // suppress warnings about [[vk::push_constant]] when compiling to dxil
-        argmem.add_arg(L"-Wno-ignored-attributes");
-    }
-
-    // entrypoint
-    argmem.add_arg(L"-E");
-    argmem.add_arg(wmem.convert_and_add_text(shader.entrypoint));
+    };
 
-    // include paths
-    for (char const* additional_include_path : config.additional_include_paths)
+    // IDxcCompiler3 instances and argument memory are not shared between threads, each additional thread uses its own worker
+    auto& workers = _workers->workers;
+    while (workers.size() + 1 < num_threads)
     {
-        argmem.add_arg(L"-I");
-        argmem.add_arg(wmem.convert_and_add_text(additional_include_path));
+        auto& worker = workers.emplace_back();
+        verify_hres(DxcCreateInstance(CLSID_DxcCompiler, IID_PPV_ARGS(&worker.compiler)));
+        worker.arguments = std::make_unique<detail::argument_builder>(cc::system_allocator);
     }
 
-    if (config.build_debug)
+    std::vector<std::thread> threads;
+    threads.reserve(num_threads > 0 ? num_threads - 1 : 0);
+    for (auto i = 1u; i < num_threads; ++i)
     {
-        argmem.add_arg(L"-Od");           // disable optimization
-        argmem.add_arg(L"-Zi");           // -Zi: build debug information
-        argmem.add_arg(L"-Qembed_debug"); // embed debug info as opposed to creating a PDB
-    }
-    else
-    {
-        argmem.add_arg(L"-O3"); // full optimization
+        auto* const worker_compiler = workers[i - 1].compiler;
+        auto* const worker_arguments = workers[i - 1].arguments.get();
+        threads.emplace_back([&f_work, worker_compiler, worker_arguments] { f_work(worker_compiler, *worker_arguments); });
     }
 
-    // profile target
-    argmem.add_arg(L"-T");
-    argmem.add_arg(wmem.add_profile_text(shader.target, shader.sm));
+    f_work(_compiler, *_arguments);
 
-    // defines
-    for (char const* const define : config.defines)
+    for (auto& thread : threads)
     {
-        argmem.add_arg(L"-D");
-        argmem.add_arg(wmem.convert_and_add_text(define));
+        thread.join();
     }
-
-    DxcBuffer source_buffer;
-    source_buffer.Ptr = shader.raw_text;
-    source_buffer.Size = raw_text_length;
-    source_buffer.Encoding = CP_UTF8;
-
-    IDxcResult* result = nullptr;
-    _compiler->Compile(&source_buffer, argmem.get_data(), argmem.get_num(), _include_handler, IID_PPV_ARGS(&result));
-    return result;
 }
 
-IDxcResult* dxcw::compiler::compile_library_result(library_description const& library, compilation_config const& config, cc::allocator* scratch_alloc)
+IDxcResult* dxcw::compiler::compile_library_result(library_description const& library, compilation_config const& config, cc::allocator* /*scratch_alloc*/)
 {
 #ifdef DXCW_HAS_OPTICK
     OPTICK_EVENT();
@@ -374,28 +671,16 @@ IDxcResult* dxcw::compiler::compile_library_result(library_description const& li
     CC_CONTRACT(library.raw_text);
     CC_ASSERT(_lib != nullptr && "Uninitialized dxcw::compiler");
 
-    IDxcBlobEncoding* encoding = nullptr;
-    DEFER_RELEASE(encoding);
-
-    auto const raw_text_length = uint32_t(std::strlen(library.raw_text));
+    size_t const raw_text_length = library.raw_text_length > 0 ? library.raw_text_length : std::strlen(library.raw_text);
     CC_ASSERT(raw_text_length > 0 && "DXCW shader src text empty");
-    _lib->CreateBlobWithEncodingFromPinned(library.raw_text, raw_text_length, CP_UTF8, &encoding);
-
-    widechar_memory wmem;
-    size_t num_chars_defines = 0;
-    for (char const* const define : config.defines)
-    {
-        num_chars_defines += std::strlen(define) + 1;
-    }
-    wmem.initialize(1024 + 1024 + 1024 + num_chars_defines, scratch_alloc);
 
-    argument_memory argmem;
-    argmem.initialize(30 + library.exports.size() * 2, scratch_alloc);
+    auto& args = *_arguments;
+    args.reset();
 
     if (config.filename_for_errors)
     {
         // the filename for errors is simply any non-flag argument to the compilation
-        argmem.add_arg(wmem.convert_and_add_text(config.filename_for_errors));
+        args.add_converted_arg(config.filename_for_errors);
     }
 
     if (config.output_format == output::spirv)
@@ -411,103 +696,66 @@ IDxcResult* dxcw::compiler::compile_library_result(library_description const& li
                                        //                                       L"-fspv-extension=SPV_NV_ray_tracing",
                                        L"-fvk-use-dx-layout", L"-fspv-reflect", L"-fvk-b-shift", L"0", L"all", L"-fvk-t-shift", L"1000", L"all",
                                        L"-fvk-u-shift", L"2000", L"all", L"-fvk-s-shift", L"3000", L"all"};
-        argmem.add_multiple_args(spirv_args, CC_COUNTOF(spirv_args));
+        args.add_multiple_args(spirv_args, CC_COUNTOF(spirv_args));
     }
     else if (config.output_format == output::dxil)
     {
         // suppress warnings about [[vk::push_constant]] when compiling to dxil
-        argmem.add_arg(L"-Wno-ignored-attributes");
+        args.add_arg(L"-Wno-ignored-attributes");
     }
 
     // profile target
-    argmem.add_arg(L"-T");
-    argmem.add_arg(L"lib_" DXCW_DEFAULT_SHADER_MODEL_STR);
+    args.add_arg(L"-T");
+    args.add_arg(L"lib_" DXCW_DEFAULT_SHADER_MODEL_STR);
 
     // include paths
     for (char const* additional_include_path : config.additional_include_paths)
     {
-        argmem.add_arg(L"-I");
-        argmem.add_arg(wmem.convert_and_add_text(additional_include_path));
+        args.add_arg(L"-I");
+        args.add_cached_text_arg(additional_include_path);
     }
 
 
     if (config.build_debug)
     {
-        argmem.add_arg(L"-Od");           // disable optimization
-        argmem.add_arg(L"-Zi");           // -Zi: build debug information
-        argmem.add_arg(L"-Qembed_debug"); // embed debug info as opposed to creating a PDB
+        args.add_arg(L"-Od"); // disable optimization
+
+        std::vector<LPCWSTR> debug_args;
+        add_debug_info_args(debug_args, config.output_format, config.debug_info);
+        args.add_multiple_args(debug_args.data(), debug_args.size());
     }
     else
     {
-        argmem.add_arg(L"-O3"); // full optimization
+        args.add_arg(L"-O3"); // full optimization
     }
 
     // defines
     for (char const* const define : config.defines)
     {
-        argmem.add_arg(L"-D");
-        argmem.add_arg(wmem.convert_and_add_text(define));
+        args.add_arg(L"-D");
+        args.add_converted_arg(define);
     }
 
     // exports
-    auto export_text = cc::alloc_array<wchar_t>::uninitialized(library.exports.size() * 128, scratch_alloc);
-    unsigned num_chars_export_text = 0;
-
-    [[maybe_unused]] auto const f_add_export_wchars = [&](wchar_t const* text, unsigned strlen)
-    {
-        CC_ASSERT(num_chars_export_text + strlen <= export_text.size() && "text write OOB");
-        std::memcpy(export_text.data() + num_chars_export_text, text, strlen * sizeof(wchar_t));
-        num_chars_export_text += strlen;
-    };
-
-    auto const f_add_export_entry_text = [&](char const* export_name, char const* internal_name) -> wchar_t const*
-    {
-        CC_ASSERT(internal_name != nullptr && "internal name is required on library exports");
-
-        // from dxc.exe -help:
-        //   -exports <value>        Specify exports when compiling a library: export1[[,export1_clone,...]=internal_name][;...]
-        // form of export entries:
-        // <export name>=<internal name>, f.e. closest_hit=MainClosestHit
-        // or only the export value if it's the same
-        // <export name>
-
-        wchar_t const* const res = export_text.data() + num_chars_export_text;
-
-        if (export_name)
-        {
-            // convert and write the export name
-
-            auto const num_wchars_written
-                = cc::char_to_widechar(cc::span{export_text}.subspan(num_chars_export_text, export_text.size() - num_chars_export_text), export_name);
-            num_chars_export_text += unsigned(num_wchars_written) + 1;
-
-            // write the equals sign
-            export_text[num_chars_export_text] = L'=';
-            ++num_chars_export_text;
-        }
-
-        // convert and write the internal name
-        auto const num_wchars_written
-            = cc::char_to_widechar(cc::span{export_text}.subspan(num_chars_export_text, export_text.size() - num_chars_export_text), internal_name);
-        num_chars_export_text += unsigned(num_wchars_written) + 1;
-
-
-        return res;
-    };
-
+    // from dxc.exe -help:
+    //   -exports <value>        Specify exports when compiling a library: export1[[,export1_clone,...]=internal_name][;...]
+    // form of export entries:
+    // <export name>=<internal name>, f.e. closest_hit=MainClosestHit
+    // or only the export value if it's the same
+    // <export name>
     for (auto const& exp : library.exports)
     {
-        argmem.add_arg(L"-exports");
-        argmem.add_arg(f_add_export_entry_text(exp.export_name, exp.internal_name));
+        args.add_arg(L"-exports");
+        args.add_export_arg(exp.export_name, exp.internal_name);
     }
 
     DxcBuffer source_buffer;
     source_buffer.Ptr = library.raw_text;
-    source_buffer.Size = std::strlen(library.raw_text);
+    source_buffer.Size = raw_text_length;
     source_buffer.Encoding = CP_UTF8;
 
     IDxcResult* result = nullptr;
-    _compiler->Compile(&source_buffer, argmem.get_data(), argmem.get_num(), _include_handler, IID_PPV_ARGS(&result));
+    _compiler->Compile(&source_buffer, args.get_data(), args.get_num(), _include_handler, IID_PPV_ARGS(&result));
     return result;
 }
 
@@ -533,6 +781,48 @@ bool dxcw::compiler::get_result_binary(IDxcResult* result, binary* out_binary)
     return true;
 }
 
+bool dxcw::compiler::get_result_pdb(IDxcResult* result, binary* out_pdb, char* out_name, size_t max_name_length)
+{
+    CC_CONTRACT(out_pdb && out_name && max_name_length > 1);
+    if (!is_result_successful(result) || !result->HasOutput(DXC_OUT_PDB))
+        return false;
+
+    IDxcBlob* pPdb = nullptr;
+    IDxcBlobUtf16* pOutPdbName = nullptr;
+    DEFER_RELEASE(pOutPdbName);
+    if (FAILED(result->GetOutput(DXC_OUT_PDB, IID_PPV_ARGS(&pPdb), &pOutPdbName)) || pPdb == nullptr)
+        return false;
+
+    // DXC names the PDB by shader hash unless told otherwise, the binary references it by this name
+    out_name[0] = '\0';
+    if (pOutPdbName && pOutPdbName->GetStringLength() > 0)
+    {
+        int const num_chars = cc::widechar_to_char(cc::span<char>(out_name, max_name_length - 1), pOutPdbName->GetStringPointer());
+        out_name[std::clamp(num_chars, 0, int(max_name_length - 1))] = '\0';
+    }
+
+    IDxcBlob* pHash = nullptr;
+    DEFER_RELEASE(pHash);
+    if (out_name[0] == '\0' && SUCCEEDED(result->GetOutput(DXC_OUT_SHADER_HASH, IID_PPV_ARGS(&pHash), nullptr)) && pHash
+        && pHash->GetBufferSize() >= sizeof(DxcShaderHash))
+    {
+        auto const* const hash = static_cast<DxcShaderHash const*>(pHash->GetBufferPointer());
+        for (auto i = 0u; i < 16 && 2 * i + 2 < max_name_length; ++i)
+            std::snprintf(out_name + 2 * i, 3, "%02x", hash->HashDigest[i]);
+
+        std::snprintf(out_name + std::strlen(out_name), max_name_length - std::strlen(out_name), ".pdb");
+    }
+
+    if (out_name[0] == '\0')
+    {
+        pPdb->Release();
+        return false;
+    }
+
+    *out_pdb = binary{pPdb};
+    return true;
+}
+
 bool dxcw::compiler::get_result_error_string(IDxcResult* result, IDxcBlobUtf8** out_blob_to_free, char** out_error_string)
 {
     CC_CONTRACT(out_blob_to_free && out_error_string);
@@ -598,12 +888,12 @@ bool dxcw::compiler::get_result_reflection(IDxcResult* result, D3D12_SHADER_DESC
 
 #else
     // D3D12 is not available on linux
-    DXCW_LOG_ERROR("Shader reflection is unavailable without D3D12");
+    DXCW_LOG_ERROR("Shader reflection is unavailable without D3D12, use dxcw::reflect_binary for bindings and signatures");
     return false;
 #endif
 }
 
-dxcw::binary dxcw::compiler::compile_shader(const char* raw_text,
+dxcw::binary dxcw::compiler::compile_shader(cc::string_view raw_text,
     const char* entrypoint,
     dxcw::target target,
     dxcw::output output,
@@ -612,15 +902,17 @@ dxcw::binary dxcw::compiler::compile_shader(const char* raw_text,
     cc::span<char const* const> opt_additional_include_paths,
     char const* opt_filename_for_errors,
     cc::span<char const* const> opt_defines,
-    cc::allocator* scratch_alloc)
+    cc::allocator* /*scratch_alloc*/)
 {
 #ifdef DXCW_HAS_OPTICK
     OPTICK_EVENT();
 #endif
+    CC_CONTRACT(!raw_text.empty());
     CC_ASSERT(_lib != nullptr && "Uninitialized dxcw::compiler");
 
     shader_description shader = {};
-    shader.raw_text = raw_text;
+    shader.raw_text = raw_text.data();
+    shader.raw_text_length = raw_text.size();
     shader.entrypoint = entrypoint;
     shader.target = target;
     shader.sm = sm;
@@ -632,22 +924,23 @@ dxcw::binary dxcw::compiler::compile_shader(const char* raw_text,
     config.defines = opt_defines;
     config.filename_for_errors = opt_filename_for_errors;
 
-    IDxcResult* result = this->compile_shader_result(shader, config, scratch_alloc);
+    return this->compile_shader(shader, config);
+}
+
+dxcw::binary dxcw::compiler::compile_shader(shader_description const& shader, compilation_config const& config, external_pdb* opt_out_pdb)
+{
+#ifdef DXCW_HAS_OPTICK
+    OPTICK_EVENT();
+#endif
+    CC_ASSERT(_lib != nullptr && "Uninitialized dxcw::compiler");
+
+    IDxcResult* result = this->compile_shader_result(shader, config);
     DEFER_RELEASE(result);
 
-    // Print errors and warning if present
-    IDxcBlobUtf8* pErrors = nullptr;
-    char* pErrorString = nullptr;
-    DEFER_RELEASE(pErrors);
-    if (get_result_error_string(result, &pErrors, &pErrorString))
-    {
-        DXCW_LOG_ERROR(R"(shader "{}", entrypoint "{}" ({}):)", opt_filename_for_errors, entrypoint, get_output_type_literal(output));
-        DXCW_LOG_ERROR("{}", pErrorString);
+    log_result_errors(*this, result, config, shader.entrypoint);
 
-        //        DXCW_LOG_ERROR("include root: {}", opt_additional_include_paths);
-        //        DXCW_LOG_ERROR("working dir: {}", std::filesystem::current_path().string().c_str());
-        //        DXCW_LOG_ERROR("compiling primary source of {} chars", raw_text_length);
-    }
+    if (opt_out_pdb)
+        *opt_out_pdb = external_pdb{};
 
     // Return binary blob
     binary res = {};
@@ -656,10 +949,54 @@ dxcw::binary dxcw::compiler::compile_shader(const char* raw_text,
         DXCW_LOG_ERROR("compilation failed");
         return binary{nullptr};
     }
+
+    get_requested_pdb(*this, result, config, opt_out_pdb);
     return res;
 }
 
-dxcw::binary dxcw::compiler::compile_library(const char* raw_text,
+bool dxcw::compiler::compile_shader_multi(cc::string_view raw_text,
+                                          cc::span<entrypoint_description const> entrypoints,
+                                          compilation_config const& config,
+                                          cc::span<binary> out_binaries,
+                                          unsigned max_num_threads,
+                                          cc::span<external_pdb> opt_out_pdbs)
+{
+#ifdef DXCW_HAS_OPTICK
+    OPTICK_EVENT();
+#endif
+    CC_CONTRACT(out_binaries.size() >= entrypoints.size());
+    CC_CONTRACT(opt_out_pdbs.empty() || opt_out_pdbs.size() >= entrypoints.size());
+
+    std::vector<IDxcResult*> results(entrypoints.size(), nullptr);
+    this->compile_shader_multi_result(raw_text, entrypoints, config, cc::span<IDxcResult*>(results.data(), results.size()), max_num_threads);
+
+    bool all_succeeded = true;
+    for (auto i = 0u; i < entrypoints.size(); ++i)
+    {
+        IDxcResult* const result = results[i];
+        DEFER_RELEASE(result);
+
+        log_result_errors(*this, result, config, entrypoints[i].entrypoint);
+
+        external_pdb* const out_pdb = opt_out_pdbs.empty() ? nullptr : &opt_out_pdbs[i];
+        if (out_pdb)
+            *out_pdb = external_pdb{};
+
+        out_binaries[i] = binary{nullptr};
+        if (!get_result_binary(result, &out_binaries[i]))
+        {
+            DXCW_LOG_ERROR("compilation of entrypoint \"{}\" failed", entrypoints[i].entrypoint);
+            all_succeeded = false;
+            continue;
+        }
+
+        get_requested_pdb(*this, result, config, out_pdb);
+    }
+
+    return all_succeeded;
+}
+
+dxcw::binary dxcw::compiler::compile_library(cc::string_view raw_text,
                                              cc::span<const library_export> exports,
                                              dxcw::output output,
                                              bool build_debug,
@@ -668,11 +1005,12 @@ dxcw::binary dxcw::compiler::compile_library(const char* raw_text,
                                              cc::span<char const* const> opt_defines,
                                              cc::allocator* scratch_alloc)
 {
-
+    CC_CONTRACT(!raw_text.empty());
     CC_ASSERT(_lib != nullptr && "Uninitialized dxcw::compiler");
 
     library_description library = {};
-    library.raw_text = raw_text;
+    library.raw_text = raw_text.data();
+    library.raw_text_length = raw_text.size();
     library.exports = exports;
 
     compilation_config config = {};
@@ -685,19 +1023,7 @@ dxcw::binary dxcw::compiler::compile_library(const char* raw_text,
     IDxcResult* result = this->compile_library_result(library, config, scratch_alloc);
     DEFER_RELEASE(result);
 
-    // Print errors and warning if present
-    IDxcBlobUtf8* pErrors = nullptr;
-    char* pErrorString = nullptr;
-    DEFER_RELEASE(pErrors);
-    if (get_result_error_string(result, &pErrors, &pErrorString))
-    {
-        DXCW_LOG_ERROR(R"(shader library "{}" ({}):)", opt_filename_for_errors, get_output_type_literal(output));
-        DXCW_LOG_ERROR("{}", pErrorString);
-
-        //        DXCW_LOG_ERROR("include root: {}", opt_additional_include_paths);
-        //        DXCW_LOG_ERROR("working dir: {}", std::filesystem::current_path().string().c_str());
-        //        DXCW_LOG_ERROR("compiling primary source of {} chars", raw_text_length);
-    }
+    log_result_errors(*this, result, config, nullptr);
 
     // Return binary blob
     binary res = {};
@@ -709,6 +1035,86 @@ dxcw::binary dxcw::compiler::compile_library(const char* raw_text,
     return res;
 }
 
+dxcw::binary dxcw::compiler::strip_binary(binary const& input, output output, strip_flags flags)
+{
+    CC_ASSERT(_utils != nullptr && "Called on unitialized compiler");
+    CC_CONTRACT(input.internal_blob);
+
+    // the input is returned if there is nothing to strip or stripping fails
+    auto const f_keep_input = [&]
+    {
+        retain_blob(input.internal_blob);
+        return input;
+    };
+
+    if (flags == strip_none)
+        return f_keep_input();
+
+    if (output == output::spirv)
+    {
+        std::vector<std::byte> stripped(input.size);
+        size_t const stripped_size = detail::spirv_strip(input.data, input.size, flags & strip_debug, flags & strip_reflection, stripped.data());
+        if (stripped_size == 0)
+        {
+            DXCW_LOG_WARN("failed to strip SPIR-V binary, the module is malformed");
+            return f_keep_input();
+        }
+
+        IDxcBlobEncoding* blob = nullptr;
+        if (FAILED(_utils->CreateBlob(stripped.data(), UINT32(stripped_size), DXC_CP_ACP, &blob)))
+            return f_keep_input();
+
+        return binary{blob};
+    }
+
+    IDxcContainerBuilder* builder = nullptr;
+    DEFER_RELEASE(builder);
+    if (FAILED(DxcCreateInstance(CLSID_DxcContainerBuilder, IID_PPV_ARGS(&builder))) || FAILED(builder->Load(input.internal_blob)))
+    {
+        DXCW_LOG_WARN("failed to strip DXIL binary, the container can't be loaded");
+        return f_keep_input();
+    }
+
+    uint32_t parts[6];
+    unsigned num_parts = 0;
+    if (flags & strip_debug)
+    {
+        parts[num_parts++] = DXC_PART_PDB;
+        parts[num_parts++] = DXC_PART_PDB_NAME;
+        parts[num_parts++] = DXC_FOURCC('P', 'D', 'B', 'I');
+        parts[num_parts++] = DXC_FOURCC('S', 'R', 'C', 'I');
+    }
+    if (flags & strip_reflection)
+    {
+        parts[num_parts++] = DXC_PART_REFLECTION_DATA;
+        parts[num_parts++] = DXC_PART_PRIVATE_DATA;
+    }
+
+    // fails for parts the container does not have
+    bool has_removed_parts = false;
+    for (auto i = 0u; i < num_parts; ++i)
+        has_removed_parts |= SUCCEEDED(builder->RemovePart(parts[i]));
+
+    if (!has_removed_parts)
+        return f_keep_input();
+
+    // the builder recomputes the container hash
+    IDxcOperationResult* op_result = nullptr;
+    DEFER_RELEASE(op_result);
+    HRESULT status = E_FAIL;
+    if (FAILED(builder->SerializeContainer(&op_result)) || FAILED(op_result->GetStatus(&status)) || FAILED(status))
+    {
+        DXCW_LOG_WARN("failed to strip DXIL binary, the container can't be serialized");
+        return f_keep_input();
+    }
+
+    IDxcBlob* blob = nullptr;
+    if (FAILED(op_result->GetResult(&blob)) || blob == nullptr)
+        return f_keep_input();
+
+    return binary{blob};
+}
+
 bool dxcw::compiler::print_version() const
 {
     unsigned ver_maj = 0, ver_min = 0, ver_commit_i = 0;
@@ -790,6 +1196,14 @@ void dxcw::destroy_blob(IDxcBlob* blob)
     }
 }
 
+void dxcw::retain_blob(IDxcBlob* blob)
+{
+    if (blob != nullptr)
+    {
+        blob->AddRef();
+    }
+}
+
 void dxcw::destroy_result(IDxcResult* blob)
 {
     if (blob)
@@ -797,3 +1211,40 @@ void dxcw::destroy_result(IDxcResult* blob)
 }
 
 void dxcw::destroy(const dxcw::binary& b) { destroy_blob(b.internal_blob); }
+
+char const* dxcw::get_target_name(dxcw::target target)
+{
+    switch (target)
+    {
+    case dxcw::target::vertex:
+        return "vs";
+    case dxcw::target::hull:
+        return "hs";
+    case dxcw::target::domain:
+        return "ds";
+    case dxcw::target::geometry:
+        return "gs";
+    case dxcw::target::pixel:
+        return "ps";
+    case dxcw::target::compute:
+        return "cs";
+    case dxcw::target::raygeneration:
+        return "rgen";
+    case dxcw::target::intersection:
+        return "rint";
+    case dxcw::target::anyhit:
+        return "rahit";
+    case dxcw::target::closesthit:
+        return "rchit";
+    case dxcw::target::miss:
+        return "rmiss";
+    case dxcw::target::callable:
+        return "rcall";
+    case dxcw::target::mesh:
+        return "ms";
+    case dxcw::target::amplification:
+        return "as";
+    }
+
+    return "unknown";
+}
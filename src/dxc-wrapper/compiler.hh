@@ -5,6 +5,7 @@
 
 #include <clean-core/fwd.hh>
 #include <clean-core/span.hh>
+#include <clean-core/string_view.hh>
 
 #include <dxc-wrapper/common/api.hh>
 
@@ -20,6 +21,12 @@ typedef struct _D3D12_SHADER_DESC D3D12_SHADER_DESC;
 
 namespace dxcw
 {
+namespace detail
+{
+struct argument_builder;
+struct worker_compilers;
+}
+
 struct DXCW_API binary
 {
     binary() = default;
@@ -31,6 +38,8 @@ struct DXCW_API binary
 };
 
 DXCW_API void destroy_blob(IDxcBlob* blob);
+/// adds a reference to the blob, which must be released by an additional destroy_blob
+DXCW_API void retain_blob(IDxcBlob* blob);
 DXCW_API void destroy_result(IDxcResult* blob);
 DXCW_API void destroy(binary const& b);
 
@@ -55,6 +64,9 @@ enum class target : uint8_t
     amplification
 };
 
+/// short name of a target as used in shaderlists, ie. "vs" or "rgen", "unknown" for invalid values
+DXCW_API char const* get_target_name(target target);
+
 enum class output : uint8_t
 {
     dxil,
@@ -86,6 +98,17 @@ struct shader_description
 {
     // the HLSL code (ascii text)
     char const* raw_text = nullptr;
+    // length of raw_text in bytes, if 0 raw_text must be null-terminated
+    size_t raw_text_length = 0;
+    // name of the entrypoint function
+    char const* entrypoint = nullptr;
+    // shader stage
+    target target = target::vertex;
+    shader_model sm = shader_model::sm_use_default;
+};
+
+struct entrypoint_description
+{
     // name of the entrypoint function
     char const* entrypoint = nullptr;
     // shader stage
@@ -97,16 +120,39 @@ struct library_description
 {
     // the HLSL code (ascii text)
     char const* raw_text = nullptr;
+    // length of raw_text in bytes, if 0 raw_text must be null-terminated
+    size_t raw_text_length = 0;
     // internal and exported name per export
     cc::span<library_export const> exports = {};
 };
 
+// where the debug information of a debug build is stored
+// external PDBs are only produced for DXIL, SPIR-V binaries always contain their debug information
+enum class debug_info : uint8_t
+{
+    embedded, // inside the binary (-Zi, -Qembed_debug)
+    pdb,      // in a separate full PDB (-Zi, -Qstrip_debug), the binary only references it by name
+    pdb_slim, // in a separate slim PDB with sources and arguments only (-Zs), tools recompile to restore the full information
+};
+
+// parts of compiled binaries removed by compiler::strip_binary, combinable
+// debug information and reflection are not required to create pipelines, stripping them reduces load and upload times
+enum strip_flags : uint8_t
+{
+    strip_none = 0,
+    strip_debug = 1 << 0,      // DXIL: ILDB, ILDN, PDBI and SRCI parts, SPIR-V: names, line information and -fspv-debug instructions
+    strip_reflection = 1 << 1, // DXIL: STAT and PRIV parts, SPIR-V: -fspv-reflect decorations
+    strip_all = strip_debug | strip_reflection,
+};
+
 struct compilation_config
 {
     // output format, DXIL (D3D12) or SPIR-V (Vulkan)
     output output_format = output::dxil;
-    // disable optimizations (-Od) and embed PDB information into binary (-Zi, -Qembed_debug)
+    // disable optimizations (-Od) and build debug information (-Zi), stored as specified by debug_info
     bool build_debug = false;
+    // where the debug information of build_debug is stored
+    dxcw::debug_info debug_info = dxcw::debug_info::embedded;
 
     // additional paths used for #include directive resolution (optional)
     cc::span<char const* const> additional_include_paths = {};
@@ -116,6 +162,19 @@ struct compilation_config
     char const* filename_for_errors = nullptr;
 };
 
+// external PDB of a compilation with debug_info::pdb or pdb_slim
+struct external_pdb
+{
+    // the PDB, must be freed using dxcw::destroy
+    binary data = {};
+    // file name referenced by the binary, by shader hash (ie. "0c2f...e1.pdb"), PIX and RenderDoc look for it next to the binary
+    char name[256] = {};
+};
+
+// receives the diagnostics (errors and warnings) of a compilation instead of them being logged
+// entrypoint is nullptr for libraries
+using diagnostic_callback = void (*)(void* userdata, compilation_config const& config, char const* entrypoint, char const* diagnostics);
+
 struct DXCW_API compiler
 {
 public:
@@ -128,12 +187,24 @@ public:
     // Advanced API: Retrieve a IDxcResult* for detailed interaction
     IDxcResult* compile_library_result(library_description const& library, compilation_config const& config, cc::allocator* scratch_alloc = cc::system_allocator);
 
+    // Advanced API: Compile multiple entrypoints of the same HLSL code, writes one IDxcResult* per entrypoint (free using destroy_result)
+    // Includes are loaded once and shared between all entrypoints, which are compiled in parallel
+    // Must not be called concurrently on the same compiler
+    void compile_shader_multi_result(cc::string_view raw_text,
+                                     cc::span<entrypoint_description const> entrypoints,
+                                     compilation_config const& config,
+                                     cc::span<IDxcResult*> out_results,
+                                     unsigned max_num_threads = 0);
+
     // Returns true if the compilation succeeded
     bool is_result_successful(IDxcResult* result);
 
     // Extracts the binary from the result
     bool get_result_binary(IDxcResult* result, binary* out_binary);
 
+    // Extracts the external PDB and its file name (by shader hash, ie. "0c2f...e1.pdb") from the result, requires debug_info::pdb or pdb_slim
+    bool get_result_pdb(IDxcResult* result, binary* out_pdb, char* out_name, size_t max_name_length);
+
     // Extracts an error string, returns true if errors / warnings occured
     // If this returns true, must call free_result_error_blob on *out_blob_to_free
     bool get_result_error_string(IDxcResult* result, IDxcBlobUtf8** out_blob_to_free, char** out_error_string);
@@ -141,12 +212,13 @@ public:
     void free_result_error_blob(IDxcBlobUtf8* blob_to_free);
 
     // Extracts reflection data from the result (include <d3d12shader.h> for the struct, Windows only)
+    // bindings and signatures of DXIL and SPIR-V binaries can be reflected on all platforms with dxcw::reflect_binary (see reflection.hh)
     bool get_result_reflection(IDxcResult* result, D3D12_SHADER_DESC* out_shader_desc);
 
 
     ///
     /// \brief compiles HLSL code to a DXIL or SPIR-V shader binary
-    /// \param raw_text                         - the HLSL code (ascii text)
+    /// \param raw_text                         - the HLSL code (ascii text), not empty, does not need to be null-terminated
     /// \param entrypoint                       - name of the entrypoint function
     /// \param target                           - shader stage
     /// \param output                           - output format, DXIL (D3D12) or SPIR-V (Vulkan)
@@ -154,10 +226,10 @@ public:
     /// \param opt_additional_include_paths     - additional paths used for #include directive resolution (optional)
     /// \param opt_filename_for_errors          - filename that is logged if errors occur during compilation (optional)
     /// \param opt_defines                      - defines (ex.: "MYVAL=1", "WITH_IBL=0", "HAS_EMISSIVE") (optional)
-    /// \param scratch_alloc                    - allocator used for scratch memory required during compilation
+    /// \param scratch_alloc                    - unused, argument memory is owned by the compiler and reused across compilations
     /// \return binary data, can outlive compiler, must be freed using dxcw::destroy
     ///
-    [[nodiscard]] binary compile_shader(char const* raw_text,
+    [[nodiscard]] binary compile_shader(cc::string_view raw_text,
         char const* entrypoint,
         target target,
         output output,
@@ -168,19 +240,45 @@ public:
         cc::span<char const* const> opt_defines = {},
         cc::allocator* scratch_alloc = cc::system_allocator);
 
+    ///
+    /// \brief compiles HLSL code to a DXIL or SPIR-V shader binary, with all settings of a compilation_config
+    /// \param opt_out_pdb                      - receives the external PDB of a debug build with debug_info::pdb or pdb_slim (optional)
+    ///                                           its data is nullptr if there is none, otherwise it must be freed using dxcw::destroy
+    /// \return binary data, can outlive compiler, must be freed using dxcw::destroy
+    ///
+    [[nodiscard]] binary compile_shader(shader_description const& shader, compilation_config const& config, external_pdb* opt_out_pdb = nullptr);
+
+    ///
+    /// \brief compiles multiple entrypoints of the same HLSL code to DXIL or SPIR-V shader binaries
+    /// \param raw_text                         - the HLSL code (ascii text), shared by all entrypoints, not empty
+    ///                                           does not need to be null-terminated
+    /// \param entrypoints                      - entrypoint name, shader stage and shader model per binary
+    /// \param config                           - output format, debug flag, include paths and defines shared by all entrypoints
+    /// \param out_binaries                     - receives one binary per entrypoint (nullptr on failure), must be freed using dxcw::destroy
+    /// \param max_num_threads                  - maximum amount of entrypoints compiled in parallel, 0 - use the hardware concurrency
+    /// \param opt_out_pdbs                     - receives one external PDB per entrypoint like the single-entrypoint compile_shader (optional)
+    /// \return true if all entrypoints compiled successfully
+    ///
+    bool compile_shader_multi(cc::string_view raw_text,
+                              cc::span<entrypoint_description const> entrypoints,
+                              compilation_config const& config,
+                              cc::span<binary> out_binaries,
+                              unsigned max_num_threads = 0,
+                              cc::span<external_pdb> opt_out_pdbs = {});
+
     ///
     /// \brief compiles HLSL code to a DXIL or SPIR-V library binary
-    /// \param raw_text                         - the HLSL code (ascii text)
+    /// \param raw_text                         - the HLSL code (ascii text), not empty, does not need to be null-terminated
     /// \param exports                          - internal and exported name per export
     /// \param output                           - output format, DXIL (D3D12) or SPIR-V (Vulkan)
     /// \param build_debug                      - disable optimizations (-Od) and embed PDB information into binary (-Zi, -Qembed_debug)
     /// \param opt_additional_include_paths     - additional paths used for #include directive resolution (optional)
     /// \param opt_filename_for_errors          - filename that is logged if errors occur during compilation (optional)
     /// \param opt_defines                      - defines (ex.: "MYVAL=1", "WITH_IBL=0", "HAS_EMISSIVE") (optional)
-    /// \param scratch_alloc                    - allocator used for scratch memory required during compilation
+    /// \param scratch_alloc                    - unused, argument memory is owned by the compiler and reused across compilations
     /// \return binary data, can outlive compiler, must be freed using dxcw::destroy
     ///
-    [[nodiscard]] binary compile_library(char const* raw_text,
+    [[nodiscard]] binary compile_library(cc::string_view raw_text,
                                          cc::span<library_export const> exports,
                                          output output,
                                          bool build_debug = false,
@@ -190,6 +288,18 @@ public:
                                          cc::allocator* scratch_alloc = cc::system_allocator);
 
 
+    ///
+    /// \brief removes debug information and reflection from a compiled binary, without recompiling
+    /// DXIL containers are rebuilt and rehashed by DXC, SPIR-V modules are stripped natively (see common/spirv_strip.hh)
+    /// stripping debug information also removes the reference to an external PDB
+    /// \param input                            - a binary as returned by the compile functions, unchanged
+    /// \param output                           - output format of the binary
+    /// \param flags                            - the parts to remove
+    /// \return the stripped binary, the input with an additional reference if nothing can be stripped, must be freed using dxcw::destroy
+    ///
+    [[nodiscard]] binary strip_binary(binary const& input, output output, strip_flags flags);
+
+
     /// retreives the loaded DXC major and minor version
     bool get_version(unsigned& out_major, unsigned& out_minor) const;
 
@@ -212,5 +322,12 @@ public:
     IDxcUtils* _utils = nullptr;
     IDxcContainerReflection* _reflection = nullptr;
     IDxcIncludeHandler* _include_handler = nullptr;
+    // if set, compilation diagnostics are passed to this callback instead of being logged
+    diagnostic_callback _diagnostic_callback = nullptr;
+    void* _diagnostic_userdata = nullptr;
+    // compilation arguments, reused across compilations
+    detail::argument_builder* _arguments = nullptr;
+    // compilers and arguments of the additional threads of compile_shader_multi_result, reused across calls
+    detail::worker_compilers* _workers = nullptr;
 };
 }
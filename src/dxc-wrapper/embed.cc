@@ -0,0 +1,270 @@
+#include "embed.hh"
+
+#include <algorithm>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <clean-core/assert.hh>
+
+#include <dxc-wrapper/archive.hh>
+#include <dxc-wrapper/common/entry_name.hh>
+#include <dxc-wrapper/common/log.hh>
+#include <dxc-wrapper/compiler.hh>
+#include <dxc-wrapper/file_util.hh>
+
+namespace
+{
+// bytes per line of the generated arrays
+constexpr size_t sc_bytes_per_line = 24;
+
+struct embedded_entry
+{
+    std::string name;
+    std::string entrypoint;
+    dxcw::target target;
+    dxcw::output output;
+    uint16_t flags;
+    std::vector<std::byte> data;
+};
+
+// appends text as the content of a string literal
+void append_escaped(std::string& out, std::string const& text)
+{
+    for (char const c : text)
+    {
+        if (c == '"' || c == '\\')
+            out.push_back('\\');
+
+        out.push_back(c);
+    }
+}
+
+void append_byte_array(std::string& out, std::vector<std::byte> const& data)
+{
+    static constexpr char sc_hex_digits[] = "0123456789abcdef";
+
+    out.reserve(out.size() + data.size() * 5 + data.size() / sc_bytes_per_line * 6 + 64);
+
+    for (size_t i = 0; i < data.size(); ++i)
+    {
+        if (i % sc_bytes_per_line == 0)
+            out.append("\n    ");
+
+        auto const value = uint8_t(data[i]);
+        char const text[] = {'0', 'x', sc_hex_digits[value >> 4], sc_hex_digits[value & 15], ','};
+        out.append(text, sizeof(text));
+    }
+
+    out.append("\n");
+}
+
+bool write_generated_file(std::string const& content, std::string const& path)
+{
+    dxcw::binary file_content;
+    file_content.data = reinterpret_cast<std::byte const*>(content.data());
+    file_content.size = content.size();
+
+    if (!dxcw::write_binary_to_file(file_content, path.c_str()))
+    {
+        DXCW_LOG_ERROR("failed to write embedded shaders to {}", path);
+        return false;
+    }
+
+    return true;
+}
+}
+
+struct dxcw::detail::embed_writer_state
+{
+    std::mutex mutex;
+    std::string base_path;
+
+    std::vector<embedded_entry> entries;
+    // entry index per name and output, to replace entries that are added twice
+    std::unordered_map<std::string, size_t> entry_indices;
+};
+
+void dxcw::embed_writer::initialize(char const* base_path)
+{
+    CC_ASSERT(_state == nullptr && "double initialize");
+
+    _state = new detail::embed_writer_state();
+    _state->base_path = base_path ? base_path : "";
+    std::replace(_state->base_path.begin(), _state->base_path.end(), '\\', '/');
+}
+
+void dxcw::embed_writer::add(char const* output_path,
+                             char const* entrypoint,
+                             dxcw::target target,
+                             dxcw::output output,
+                             cc::span<std::byte const> data,
+                             uint16_t flags)
+{
+    CC_CONTRACT(output_path);
+    CC_ASSERT(_state != nullptr && "Uninitialized dxcw::embed_writer");
+
+    embedded_entry entry;
+    entry.name = detail::get_entry_name(_state->base_path, output_path);
+    entry.entrypoint = entrypoint ? entrypoint : "";
+    entry.target = target;
+    entry.output = output;
+    entry.flags = flags;
+    entry.data.assign(data.begin(), data.end());
+
+    auto key = entry.name;
+    key.push_back('\0');
+    key.push_back(char(output));
+
+    std::lock_guard lg(_state->mutex);
+    auto& state = *_state;
+
+    auto const [it, is_new] = state.entry_indices.try_emplace(std::move(key), state.entries.size());
+    if (is_new)
+        state.entries.push_back(std::move(entry));
+    else
+        state.entries[it->second] = std::move(entry);
+}
+
+bool dxcw::embed_writer::write(char const* path, char const* namespace_name) const
+{
+    CC_CONTRACT(path);
+    CC_CONTRACT(namespace_name);
+    CC_ASSERT(_state != nullptr && "Uninitialized dxcw::embed_writer");
+    auto const& state = *_state;
+
+    // sorted by name and output, the order the generated lookup relies on
+    std::vector<embedded_entry const*> entries;
+    entries.reserve(state.entries.size());
+    for (auto const& entry : state.entries)
+        entries.push_back(&entry);
+
+    std::sort(entries.begin(), entries.end(),
+              [](embedded_entry const* lhs, embedded_entry const* rhs)
+              {
+                  if (lhs->name != rhs->name)
+                      return lhs->name < rhs->name;
+                  return lhs->output < rhs->output;
+              });
+
+    std::string const header_path = std::string(path) + ".hh";
+    std::string const source_path = std::string(path) + ".cc";
+    std::string const header_filename = std::filesystem::path(header_path).filename().string();
+
+    std::string header = "// generated by dxc-wrapper, do not edit\n"
+                         "// compiled shader binaries embedded as constant data\n\n"
+                         "#pragma once\n\n"
+                         "#include <cstddef>\n"
+                         "#include <cstdint>\n\n";
+    header.append("namespace ").append(namespace_name).append("\n{\n");
+    header.append("struct shader_binary\n"
+                  "{\n"
+                  "    char const* name;          // output path relative to the shaderlist without ending, ie. \"bin/mat_ps\"\n"
+                  "    char const* entrypoint;    // empty for libraries\n"
+                  "    uint8_t target;            // dxcw::target\n"
+                  "    uint8_t output;            // dxcw::output, 0 - DXIL, 1 - SPIR-V\n"
+                  "    uint16_t flags;            // dxcw::archive_entry flags\n"
+                  "    unsigned char const* data; // 16 byte aligned\n"
+                  "    size_t size;\n"
+                  "};\n\n");
+    header.append("inline constexpr size_t num_binaries = ").append(std::to_string(entries.size())).append(";\n\n");
+    header.append("// sorted by name, then output\n"
+                  "extern shader_binary const binaries[];\n\n"
+                  "// returns nullptr if there is no binary with this name and output\n"
+                  "shader_binary const* find_binary(char const* name, uint8_t output);\n"
+                  "}\n");
+
+    std::string source = "// generated by dxc-wrapper, do not edit\n\n";
+    source.append("#include \"").append(header_filename).append("\"\n\n");
+    source.append("#include <cstring>\n\n");
+    source.append("namespace ").append(namespace_name).append("\n{\n");
+    source.append("namespace\n{\n");
+
+    // one array per unique binary, identical binaries reference the same one
+    std::vector<size_t> array_indices(entries.size());
+    std::unordered_map<uint64_t, std::vector<size_t>> arrays_by_hash;
+    size_t num_arrays = 0;
+    for (size_t i = 0; i < entries.size(); ++i)
+    {
+        auto const& entry = *entries[i];
+        auto& candidates = arrays_by_hash[hash_archive_content(entry.data.data(), entry.data.size())];
+
+        auto const it = std::find_if(candidates.begin(), candidates.end(), [&](size_t index) { return entries[index]->data == entry.data; });
+        if (it != candidates.end())
+        {
+            array_indices[i] = array_indices[*it];
+            continue;
+        }
+
+        candidates.push_back(i);
+        array_indices[i] = num_arrays++;
+
+        source.append("// ").append(entry.name).append(entry.output == dxcw::output::spirv ? " (SPIR-V)\n" : " (DXIL)\n");
+        source.append("alignas(16) constexpr unsigned char data_").append(std::to_string(array_indices[i])).append("[] = {");
+        if (entry.data.empty())
+            source.append("0");
+        else
+            append_byte_array(source, entry.data);
+        source.append("};\n\n");
+    }
+
+    source.append("}\n\n");
+
+    // the index, an array can't be empty
+    source.append("shader_binary const binaries[] = {\n");
+    for (size_t i = 0; i < entries.size(); ++i)
+    {
+        auto const& entry = *entries[i];
+        auto const data_name = "data_" + std::to_string(array_indices[i]);
+
+        source.append("    {\"");
+        append_escaped(source, entry.name);
+        source.append("\", \"");
+        append_escaped(source, entry.entrypoint);
+        source.append("\", ").append(std::to_string(unsigned(entry.target)));
+        source.append(", ").append(std::to_string(unsigned(entry.output)));
+        source.append(", ").append(std::to_string(unsigned(entry.flags)));
+        source.append(", ").append(data_name).append(", ").append(entry.data.empty() ? "0" : "sizeof(" + data_name + ")").append("},\n");
+    }
+
+    if (entries.empty())
+        source.append("    {\"\", \"\", 0, 0, 0, nullptr, 0},\n");
+
+    source.append("};\n\n");
+    source.append("shader_binary const* find_binary(char const* name, uint8_t output)\n"
+                  "{\n"
+                  "    size_t lo = 0;\n"
+                  "    size_t hi = num_binaries;\n"
+                  "    while (lo < hi)\n"
+                  "    {\n"
+                  "        size_t const mid = (lo + hi) / 2;\n"
+                  "        int cmp = std::strcmp(binaries[mid].name, name);\n"
+                  "        if (cmp == 0)\n"
+                  "            cmp = int(binaries[mid].output) - int(output);\n\n"
+                  "        if (cmp == 0)\n"
+                  "            return &binaries[mid];\n\n"
+                  "        if (cmp < 0)\n"
+                  "            lo = mid + 1;\n"
+                  "        else\n"
+                  "            hi = mid;\n"
+                  "    }\n\n"
+                  "    return nullptr;\n"
+                  "}\n"
+                  "}\n");
+
+    bool const header_success = write_generated_file(header, header_path);
+    bool const source_success = write_generated_file(source, source_path);
+
+    if (header_success && source_success)
+        DXCW_LOG("embedded {} binaries ({} unique) in {}", entries.size(), num_arrays, source_path);
+
+    return header_success && source_success;
+}
+
+void dxcw::embed_writer::destroy()
+{
+    delete _state;
+    _state = nullptr;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <clean-core/span.hh>
+
+#include <dxc-wrapper/common/api.hh>
+#include <dxc-wrapper/fwd.hh>
+
+namespace dxcw
+{
+namespace detail
+{
+struct embed_writer_state;
+}
+
+/// collects compiled binaries and writes them as C++ source, to bake shaders into an executable
+///
+/// write() generates a pair of files, <path>.hh and <path>.cc, in one pass:
+/// each unique binary becomes a 16 byte aligned constexpr byte array, identical binaries (ie. aliased permutations) share one array
+/// an index table lists name, entrypoint, target, output, flags and the data of each binary, sorted by name and output
+/// the generated code only depends on the standard library, targets and outputs are the underlying values of dxcw::target and dxcw::output
+/// files with unchanged content are not rewritten, so embedding an unchanged build does not trigger C++ rebuilds
+///
+/// Usage:
+/// dxcw::embed_writer writer;
+/// writer.initialize("res/");
+/// writer.add("res/bin/shader_vs", "main_vs", dxcw::target::vertex, dxcw::output::spirv, data);
+/// writer.write("src/gen/shaders"); // src/gen/shaders.hh and src/gen/shaders.cc
+/// writer.destroy();
+struct DXCW_API embed_writer
+{
+public:
+    /// names of added binaries are their output paths relative to base_path, which is usually the directory of the shaderlist
+    void initialize(char const* base_path);
+
+    /// copies a binary into the writer, output_path without file ending, thread safe
+    /// an existing entry with the same name and output is replaced
+    /// flags are archive_entry flags (ie. flag_library)
+    void add(char const* output_path, char const* entrypoint, dxcw::target target, dxcw::output output, cc::span<std::byte const> data, uint16_t flags = 0);
+
+    /// writes <path>.hh and <path>.cc declaring all added binaries in the given namespace, path without file ending
+    /// returns false if any of the files can't be written
+    bool write(char const* path, char const* namespace_name = "embedded_shaders") const;
+
+    void destroy();
+
+    bool is_initialized() const { return _state != nullptr; }
+
+    detail::embed_writer_state* _state = nullptr;
+};
+}
@@ -1,21 +1,44 @@
 #include "file_util.hh"
 
+#include <cerrno>
 #include <cstdio>
 #include <cstring>
 
+#include <algorithm>
+#include <atomic>
 #include <filesystem>
 #include <fstream>
+#include <mutex>
+#include <shared_mutex>
 #include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
 #include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 #include <clean-core/alloc_array.hh>
 #include <clean-core/alloc_vector.hh>
 #include <clean-core/assert.hh>
 #include <clean-core/string.hh>
 
+#include <dxc-wrapper/archive.hh>
 #include <dxc-wrapper/common/log.hh>
+#include <dxc-wrapper/common/mapped_file.hh>
+#include <dxc-wrapper/common/source_cache.hh>
 #include <dxc-wrapper/common/tinyjson.hh>
 #include <dxc-wrapper/compiler.hh>
+#include <dxc-wrapper/embed.hh>
+#include <dxc-wrapper/manifest.hh>
+#include <dxc-wrapper/output_writer.hh>
+
+#ifdef CC_OS_WINDOWS
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
 
 // use these over std::strncpy
 #ifdef CC_OS_WINDOWS
@@ -28,6 +51,116 @@
 
 namespace
 {
+// compilation jobs of a single compile_entries_parallel call, job indices and result counters stay in range
+constexpr uint64_t sc_max_num_jobs = 0x7FFFFFFF;
+
+std::atomic<unsigned> g_num_skipped_writes = {0};
+std::atomic<unsigned> g_next_temp_file_index = {0};
+
+// directories known to exist, outputs of a build go into few directories and most writes can skip creating them
+std::shared_mutex g_ensured_directories_mutex;
+std::unordered_set<std::string> g_ensured_directories;
+
+std::string get_parent_directory(char const* file_path)
+{
+    std::string_view const path = file_path;
+    auto const separator = path.find_last_of("/\\");
+    return separator == std::string_view::npos ? std::string() : std::string(path.substr(0, separator));
+}
+
+// creates the directory of an output file once per process, returns false if it can't be created
+bool ensure_parent_directory(char const* file_path)
+{
+    auto directory = get_parent_directory(file_path);
+    if (directory.empty())
+        return true;
+
+    {
+        std::shared_lock lock(g_ensured_directories_mutex);
+        if (g_ensured_directories.count(directory) > 0)
+            return true;
+    }
+
+    std::error_code ec;
+    std::filesystem::create_directories(directory, ec);
+    if (ec)
+        return false;
+
+    std::unique_lock lock(g_ensured_directories_mutex);
+    g_ensured_directories.insert(std::move(directory));
+    return true;
+}
+
+// removes the directory of an output file from the cache, ie. if it was deleted while the process is running
+void forget_parent_directory(char const* file_path)
+{
+    auto const directory = get_parent_directory(file_path);
+
+    std::unique_lock lock(g_ensured_directories_mutex);
+    g_ensured_directories.erase(directory);
+}
+
+// returns true if the file at path exists and has exactly the given content
+bool is_file_content_equal(char const* path, std::byte const* data, size_t size)
+{
+    std::error_code ec;
+    auto const existing_size = std::filesystem::file_size(path, ec);
+    if (ec || existing_size != size)
+        return false;
+
+    if (size == 0)
+        return true;
+
+    dxcw::detail::mapped_file file;
+    if (!file.map(path))
+        return false;
+
+    bool const is_equal = file.size == size && std::memcmp(file.data, data, size) == 0;
+    file.unmap();
+    return is_equal;
+}
+
+unsigned get_process_id()
+{
+#ifdef CC_OS_WINDOWS
+    return unsigned(::_getpid());
+#else
+    return unsigned(::getpid());
+#endif
+}
+
+// creates a new file next to path for writing, named by process id and a per-process counter so concurrent threads and processes
+// never share one, an existing file (ie. left behind by a crashed process with the same id) is never opened but skipped
+// returns nullptr on failure, out_temp_path receives the name of the created file
+std::FILE* create_temp_file(char const* path, char* out_temp_path, size_t temp_path_size)
+{
+    for (auto attempt = 0u; attempt < 16; ++attempt)
+    {
+        int const length = std::snprintf(out_temp_path, temp_path_size, "%s.%u.%u.tmp", path, get_process_id(), g_next_temp_file_index.fetch_add(1));
+        if (length < 0 || size_t(length) >= temp_path_size)
+            return nullptr;
+
+#ifdef CC_OS_WINDOWS
+        std::FILE* fp = nullptr;
+        errno_t const err = ::fopen_s(&fp, out_temp_path, "wbx");
+        if (err == 0 && fp)
+            return fp;
+
+        if (err != EEXIST)
+            return nullptr;
+#else
+        std::FILE* const fp = std::fopen(out_temp_path, "wbx");
+        if (fp)
+            return fp;
+
+        if (errno != EEXIST)
+            return nullptr;
+#endif
+    }
+
+    return nullptr;
+}
+
 cc::alloc_array<char> read_file(char const* path, cc::allocator* alloc)
 {
 #ifdef CC_OS_WINDOWS
@@ -41,14 +174,1362 @@ cc::alloc_array<char> read_file(char const* path, cc::allocator* alloc)
         return {};
 #endif
 
-    std::fseek(fp, 0, SEEK_END);
-    auto res = cc::alloc_array<char>::uninitialized(std::ftell(fp) + 1, alloc);
-    std::rewind(fp);
-    std::fread(&res[0], 1, res.size() - 1, fp);
-    std::fclose(fp);
+    std::fseek(fp, 0, SEEK_END);
+    auto res = cc::alloc_array<char>::uninitialized(std::ftell(fp) + 1, alloc);
+    std::rewind(fp);
+    std::fread(&res[0], 1, res.size() - 1, fp);
+    std::fclose(fp);
+
+    res[res.size() - 1] = '\0';
+    return res;
+}
+
+// writes the define value text of a json permutation value, returns nullptr if the type is not supported
+char const* get_json_define_value(json_t const* node)
+{
+    switch (json_getType(node))
+    {
+    case JSON_TEXT:
+    case JSON_INTEGER:
+    case JSON_REAL:
+        return json_getValue(node);
+    case JSON_BOOLEAN:
+        return json_getBoolean(node) ? "1" : "0";
+    default:
+        return nullptr;
+    }
+}
+
+// parses a "permutations" object of a binary, returns false on errors
+bool parse_permutation_matrix(json_t const* jp_permutations, dxcw::shaderlist_permutation_matrix& out_matrix, unsigned num_entry, unsigned num_bin)
+{
+    using matrix_t = dxcw::shaderlist_permutation_matrix;
+
+    out_matrix.num_axes = 0;
+    out_matrix.num_exclusions = 0;
+
+    if (json_getType(jp_permutations) != JSON_OBJ)
+    {
+        DXCW_LOG_WARN("property \"permutations\" of binary #{} on entry #{} is not an object", num_bin, num_entry);
+        return false;
+    }
+
+    json_t const* const jp_axes = json_getProperty(jp_permutations, "axes");
+    if (!jp_axes || json_getType(jp_axes) != JSON_OBJ)
+    {
+        DXCW_LOG_WARN("permutations of binary #{} on entry #{} lack the required \"axes\" object", num_bin, num_entry);
+        return false;
+    }
+
+    unsigned string_cursor = 0;
+    auto const f_add_string = [&](char const* str, uint16_t& out_offset) -> bool
+    {
+        auto const length = std::strlen(str);
+        if (string_cursor + length + 1 > sizeof(out_matrix.string_buffer))
+            return false;
+
+        std::memcpy(out_matrix.string_buffer + string_cursor, str, length + 1);
+        out_offset = uint16_t(string_cursor);
+        string_cursor += unsigned(length + 1);
+        return true;
+    };
+
+    // axes, ie. "WITH_IBL": [false, true]
+    // the product of all axis sizes is computed in 64 bit, 16 axes of 16 values would overflow any smaller index type
+    uint64_t num_permutations = 1;
+    for (json_t const* j_axis = json_getChild(jp_axes); j_axis; j_axis = json_getSibling(j_axis))
+    {
+        if (out_matrix.num_axes == matrix_t::max_num_axes)
+        {
+            DXCW_LOG_WARN("permutations of binary #{} on entry #{} exceed the maximum of {} axes", num_bin, num_entry, matrix_t::max_num_axes);
+            return false;
+        }
+
+        if (json_getType(j_axis) != JSON_ARRAY || json_getChild(j_axis) == nullptr)
+        {
+            DXCW_LOG_WARN("permutation axis \"{}\" of binary #{} on entry #{} is not a non-empty array", json_getName(j_axis), num_bin, num_entry);
+            return false;
+        }
+
+        unsigned const axis = out_matrix.num_axes;
+        if (!f_add_string(json_getName(j_axis), out_matrix.axis_name_offsets[axis]))
+            goto l_buffer_full;
+
+        out_matrix.axis_num_values[axis] = 0;
+        for (json_t const* j_value = json_getChild(j_axis); j_value; j_value = json_getSibling(j_value))
+        {
+            char const* const value = get_json_define_value(j_value);
+            if (!value)
+            {
+                DXCW_LOG_WARN("permutation axis \"{}\" of binary #{} on entry #{} contains a value that is not text, number or bool",
+                              json_getName(j_axis), num_bin, num_entry);
+                return false;
+            }
+
+            if (out_matrix.axis_num_values[axis] == matrix_t::max_num_values)
+            {
+                DXCW_LOG_WARN("permutation axis \"{}\" of binary #{} on entry #{} exceeds the maximum of {} values", json_getName(j_axis),
+                              num_bin, num_entry, matrix_t::max_num_values);
+                return false;
+            }
+
+            if (!f_add_string(value, out_matrix.axis_value_offsets[axis][out_matrix.axis_num_values[axis]]))
+                goto l_buffer_full;
+
+            ++out_matrix.axis_num_values[axis];
+        }
+
+        num_permutations *= out_matrix.axis_num_values[axis];
+        if (num_permutations > matrix_t::max_num_permutations)
+        {
+            DXCW_LOG_WARN("permutations of binary #{} on entry #{} exceed the maximum of {} permutations at axis \"{}\"", num_bin, num_entry,
+                          matrix_t::max_num_permutations, json_getName(j_axis));
+            out_matrix.num_axes = 0;
+            return false;
+        }
+
+        ++out_matrix.num_axes;
+    }
+
+    // exclusion rules, ie. { "WITH_IBL": false, "QUALITY": "HIGH" }
+    if (json_t const* const jp_exclude = json_getProperty(jp_permutations, "exclude"))
+    {
+        if (json_getType(jp_exclude) != JSON_ARRAY)
+        {
+            DXCW_LOG_WARN("property \"exclude\" in permutations of binary #{} on entry #{} is not an array", num_bin, num_entry);
+            return false;
+        }
+
+        for (json_t const* j_rule = json_getChild(jp_exclude); j_rule; j_rule = json_getSibling(j_rule))
+        {
+            if (json_getType(j_rule) != JSON_OBJ)
+            {
+                DXCW_LOG_WARN("an exclusion rule in permutations of binary #{} on entry #{} is not an object", num_bin, num_entry);
+                return false;
+            }
+
+            if (out_matrix.num_exclusions == matrix_t::max_num_exclusions)
+            {
+                DXCW_LOG_WARN("permutations of binary #{} on entry #{} exceed the maximum of {} exclusion rules", num_bin, num_entry,
+                              matrix_t::max_num_exclusions);
+                return false;
+            }
+
+            uint8_t* const rule = out_matrix.exclusions[out_matrix.num_exclusions];
+            std::memset(rule, matrix_t::any_value, matrix_t::max_num_axes);
+
+            for (json_t const* j_cond = json_getChild(j_rule); j_cond; j_cond = json_getSibling(j_cond))
+            {
+                char const* const value = get_json_define_value(j_cond);
+
+                unsigned axis = 0;
+                while (axis < out_matrix.num_axes && std::strcmp(out_matrix.get_axis_name(axis), json_getName(j_cond)) != 0)
+                    ++axis;
+
+                unsigned value_index = 0;
+                if (axis < out_matrix.num_axes && value)
+                {
+                    while (value_index < out_matrix.axis_num_values[axis] && std::strcmp(out_matrix.get_axis_value(axis, value_index), value) != 0)
+                        ++value_index;
+                }
+
+                if (axis == out_matrix.num_axes || !value || value_index == out_matrix.axis_num_values[axis])
+                {
+                    DXCW_LOG_WARN("exclusion rule in permutations of binary #{} on entry #{} references unknown axis or value \"{}\"", num_bin,
+                                  num_entry, json_getName(j_cond));
+                    return false;
+                }
+
+                rule[axis] = uint8_t(value_index);
+            }
+
+            ++out_matrix.num_exclusions;
+        }
+    }
+
+    return true;
+
+l_buffer_full:
+    DXCW_LOG_WARN("permutation names and values of binary #{} on entry #{} exceed {} characters", num_bin, num_entry, sizeof(out_matrix.string_buffer));
+    return false;
+}
+
+// parses the optional "strip" property of a json node, one of "none", "debug", "reflection" or "all"
+// out_flags is unchanged if the property is missing
+bool parse_strip_flags(json_t const* j_node, dxcw::strip_flags& out_flags)
+{
+    json_t const* const jp_strip = json_getProperty(j_node, "strip");
+    if (!jp_strip)
+        return true;
+
+    char const* const value = json_getType(jp_strip) == JSON_TEXT ? json_getValue(jp_strip) : "";
+    if (std::strcmp(value, "none") == 0)
+        out_flags = dxcw::strip_none;
+    else if (std::strcmp(value, "debug") == 0)
+        out_flags = dxcw::strip_debug;
+    else if (std::strcmp(value, "reflection") == 0)
+        out_flags = dxcw::strip_reflection;
+    else if (std::strcmp(value, "all") == 0)
+        out_flags = dxcw::strip_all;
+    else
+        return false;
+
+    return true;
+}
+
+// parses "defines", "shader_model", "debug", "debug_info" and "strip" of a json entry and one of its binaries into the binary entry
+// defines of both are concatenated, the other settings of the binary override the ones of the entry, which override default_strip
+bool parse_binary_settings(json_t const* j_entry,
+                           json_t const* j_bin,
+                           dxcw::strip_flags default_strip,
+                           dxcw::shaderlist_binary_entry_owning& out_binary,
+                           unsigned num_entry,
+                           unsigned num_bin)
+{
+    out_binary.num_defines = 0;
+    out_binary.sm = dxcw::shader_model::sm_use_default;
+    out_binary.build_debug = false;
+    out_binary.debug_info = dxcw::debug_info::embedded;
+    out_binary.strip = default_strip;
+
+    unsigned define_cursor = 0;
+
+    for (json_t const* const j_node : {j_entry, j_bin})
+    {
+        if (json_t const* const jp_defines = json_getProperty(j_node, "defines"))
+        {
+            if (json_getType(jp_defines) != JSON_ARRAY)
+            {
+                DXCW_LOG_WARN("property \"defines\" of binary #{} on entry #{} is not an array", num_bin, num_entry);
+                return false;
+            }
+
+            for (json_t const* j_define = json_getChild(jp_defines); j_define; j_define = json_getSibling(j_define))
+            {
+                if (json_getType(j_define) != JSON_TEXT)
+                {
+                    DXCW_LOG_WARN("a define of binary #{} on entry #{} is not text", num_bin, num_entry);
+                    return false;
+                }
+
+                char const* const define = json_getValue(j_define);
+                auto const length = std::strlen(define);
+
+                if (out_binary.num_defines == CC_COUNTOF(out_binary.define_offsets) || define_cursor + length + 1 > sizeof(out_binary.define_buffer))
+                {
+                    DXCW_LOG_WARN("defines of binary #{} on entry #{} exceed the maximum of {} defines or {} characters", num_bin, num_entry,
+                                  CC_COUNTOF(out_binary.define_offsets), sizeof(out_binary.define_buffer));
+                    return false;
+                }
+
+                std::memcpy(out_binary.define_buffer + define_cursor, define, length + 1);
+                out_binary.define_offsets[out_binary.num_defines++] = uint16_t(define_cursor);
+                define_cursor += unsigned(length + 1);
+            }
+        }
+
+        if (json_t const* const jp_sm = json_getProperty(j_node, "shader_model"))
+        {
+            if (json_getType(jp_sm) != JSON_TEXT || !dxcw::parse_shader_model(json_getValue(jp_sm), out_binary.sm))
+            {
+                DXCW_LOG_WARN("property \"shader_model\" of binary #{} on entry #{} is not a shader model like \"6_6\"", num_bin, num_entry);
+                return false;
+            }
+        }
+
+        if (json_t const* const jp_debug = json_getProperty(j_node, "debug"))
+        {
+            if (json_getType(jp_debug) != JSON_BOOLEAN)
+            {
+                DXCW_LOG_WARN("property \"debug\" of binary #{} on entry #{} is not a bool", num_bin, num_entry);
+                return false;
+            }
+
+            out_binary.build_debug = json_getBoolean(jp_debug);
+        }
+
+        if (json_t const* const jp_debug_info = json_getProperty(j_node, "debug_info"))
+        {
+            char const* const value = json_getType(jp_debug_info) == JSON_TEXT ? json_getValue(jp_debug_info) : "";
+            if (std::strcmp(value, "embedded") == 0)
+                out_binary.debug_info = dxcw::debug_info::embedded;
+            else if (std::strcmp(value, "pdb") == 0)
+                out_binary.debug_info = dxcw::debug_info::pdb;
+            else if (std::strcmp(value, "pdb_slim") == 0)
+                out_binary.debug_info = dxcw::debug_info::pdb_slim;
+            else
+            {
+                DXCW_LOG_WARN("property \"debug_info\" of binary #{} on entry #{} is not one of \"embedded\", \"pdb\" or \"pdb_slim\"", num_bin, num_entry);
+                return false;
+            }
+        }
+
+        if (!parse_strip_flags(j_node, out_binary.strip))
+        {
+            DXCW_LOG_WARN("property \"strip\" of binary #{} on entry #{} is not one of \"none\", \"debug\", \"reflection\" or \"all\"", num_bin, num_entry);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// shared state of compilation jobs, source files and destinations of compiled binaries
+struct job_context
+{
+    dxcw::detail::source_cache* sources = nullptr; // required, jobs with the same source share its mapping
+    dxcw::archive_writer* archive = nullptr;       // if present, binaries are written into the archive instead of separate files
+    dxcw::embed_writer* embed = nullptr;           // if present, binaries are embedded as C++ source instead of separate files
+    dxcw::output_writer* writer = nullptr;         // if present, separate files are written asynchronously
+    dxcw::manifest_writer* manifest = nullptr;     // if present, records every written binary in addition
+};
+
+// writes a binary to <path>.<ending>, or into the archive or embed writer if present
+// the binary can be destroyed right after, asynchronous writes keep their own reference
+// it is recorded in the manifest only if written, failed asynchronous writes are counted as errors once the writer is drained
+bool write_output(dxcw::binary const& binary,
+                  char const* path,
+                  char const* ending,
+                  char const* source_path,
+                  char const* entrypoint,
+                  dxcw::target target,
+                  dxcw::output output,
+                  job_context const& ctx,
+                  uint16_t archive_flags = 0)
+{
+    auto const data = cc::span<std::byte const>(binary.data, binary.size);
+
+    bool success = true;
+    if (ctx.archive)
+        success = ctx.archive->add(path, entrypoint, target, output, data, archive_flags);
+    else if (ctx.embed)
+        ctx.embed->add(path, entrypoint, target, output, data, archive_flags);
+    else if (ctx.writer)
+        ctx.writer->write(binary, path, ending);
+    else
+        success = dxcw::write_binary_to_file(binary, path, ending);
+
+    if (success && ctx.manifest)
+        ctx.manifest->add(path, ending, source_path, entrypoint, target, output, data, archive_flags);
+
+    return success;
+}
+
+// writes an external PDB next to the output at output_path, asynchronously if a writer is present
+// PDBs are separate files even if the outputs go into an archive or embedded source, debuggers look for them on disk
+bool write_pdb(dxcw::external_pdb const& pdb, char const* output_path, job_context const& ctx)
+{
+    auto path = get_parent_directory(output_path);
+    if (!path.empty())
+        path.push_back('/');
+    path.append(pdb.name);
+
+    // the name has its own ending, usually ".pdb"
+    auto const ending_pos = path.find_last_of('.');
+    if (!ctx.writer || ending_pos == std::string::npos || ending_pos < path.size() - std::strlen(pdb.name))
+        return dxcw::write_binary_to_file(pdb.data, path.c_str());
+
+    path[ending_pos] = '\0';
+    ctx.writer->write(pdb.data, path.c_str(), path.c_str() + ending_pos + 1);
+    return true;
+}
+
+// removes the parts selected by flags from a compiled binary, replacing it, and reports its size before and after
+void strip_output(dxcw::compiler& compiler,
+                  dxcw::binary& inout_binary,
+                  char const* path,
+                  char const* ending,
+                  dxcw::output output,
+                  dxcw::strip_flags flags)
+{
+    if (flags == dxcw::strip_none)
+        return;
+
+    auto const stripped = compiler.strip_binary(inout_binary, output, flags);
+    DXCW_LOG("stripped {}.{}: {} -> {} bytes", path, ending, inout_binary.size, stripped.size);
+
+    dxcw::destroy_blob(inout_binary.internal_blob);
+    inout_binary = stripped;
+}
+
+// compiles a shader and writes the same binaries to each of the output paths (without file ending), or into the archive if present
+bool compile_shader_to_files(dxcw::compiler& compiler,
+                             char const* source_path,
+                             char const* shader_target,
+                             char const* entrypoint,
+                             cc::span<char const* const> output_paths,
+                             dxcw::shader_model sm,
+                             bool build_debug,
+                             dxcw::debug_info debug_info,
+                             dxcw::strip_flags strip,
+                             cc::span<char const* const> opt_additional_include_paths,
+                             cc::span<char const* const> opt_defines,
+                             job_context const& ctx)
+{
+    auto const source = ctx.sources->load(source_path);
+
+    if (!source.is_valid())
+    {
+        DXCW_LOG_ERROR("failed to open shader source file at {}", source_path);
+        return false;
+    }
+
+    dxcw::shader_description shader = {};
+    shader.raw_text = source.text;
+    shader.raw_text_length = source.size;
+    shader.entrypoint = entrypoint;
+    shader.sm = sm;
+    if (!dxcw::parse_target(shader_target, shader.target))
+    {
+        return false;
+    }
+
+    dxcw::compilation_config config = {};
+    config.build_debug = build_debug;
+    config.debug_info = debug_info;
+    config.additional_include_paths = opt_additional_include_paths;
+    config.defines = opt_defines;
+    config.filename_for_errors = source_path;
+
+#ifdef CC_OS_WINDOWS
+    config.output_format = dxcw::output::dxil;
+    dxcw::external_pdb pdb;
+    auto dxil_binary = compiler.compile_shader(shader, config, &pdb);
+
+    if (dxil_binary.internal_blob == nullptr)
+        return false;
+
+    strip_output(compiler, dxil_binary, output_paths[0], "dxil", dxcw::output::dxil, strip);
+    for (char const* const output_path : output_paths)
+        write_output(dxil_binary, output_path, "dxil", source_path, entrypoint, shader.target, dxcw::output::dxil, ctx);
+
+    dxcw::destroy_blob(dxil_binary.internal_blob);
+
+    // the external PDB goes next to the first output, failing to write it fails the shader
+    if (pdb.data.internal_blob != nullptr)
+    {
+        bool const pdb_written = write_pdb(pdb, output_paths[0], ctx);
+        dxcw::destroy_blob(pdb.data.internal_blob);
+        if (!pdb_written)
+            return false;
+    }
+#endif
+    // On non-windows, DXIL can be compiled but not signed which makes it mostly useless
+    // requiring DXIL on linux would be a pretty strange path but can be supported with more tricks
+
+    config.output_format = dxcw::output::spirv;
+    auto spv_binary = compiler.compile_shader(shader, config);
+    if (spv_binary.internal_blob == nullptr)
+        return false;
+
+    strip_output(compiler, spv_binary, output_paths[0], "spv", dxcw::output::spirv, strip);
+    for (char const* const output_path : output_paths)
+        write_output(spv_binary, output_path, "spv", source_path, entrypoint, shader.target, dxcw::output::spirv, ctx);
+
+    dxcw::destroy_blob(spv_binary.internal_blob);
+    return true;
+}
+
+// identifiers in the code of a source file and all files it includes, skipping comments and string literals
+// identifiers in the bodies and signatures of function definitions are kept per function name (overloads are merged),
+// all other code - declarations, aggregates, initializers and preprocessor directives outside of function bodies - is global
+struct source_scan
+{
+    std::unordered_set<std::string> global_identifiers;
+    std::unordered_map<std::string, std::unordered_set<std::string>> function_identifiers;
+};
+
+bool is_identifier_start(char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_'; }
+
+bool is_identifier_char(char c) { return is_identifier_start(c) || (c >= '0' && c <= '9'); }
+
+// statements at brace depth 0 starting with these keywords never open a function body
+bool is_aggregate_keyword(std::string_view ident)
+{
+    return ident == "struct" || ident == "class" || ident == "interface" || ident == "cbuffer" || ident == "tbuffer" || ident == "namespace"
+           || ident == "enum" || ident == "union";
+}
+
+// scans a source file and all files it includes
+// returns false if the result is not reliable (unresolvable includes, token pasting or unbalanced braces)
+bool scan_source(char const* source_path, cc::span<char const* const> include_paths, source_scan& out_scan)
+{
+    std::error_code ec;
+    std::vector<std::filesystem::path> pending_files;
+    std::unordered_set<std::string> visited_files;
+
+    pending_files.push_back(std::filesystem::path(source_path));
+    visited_files.insert(pending_files.back().string());
+
+    while (!pending_files.empty())
+    {
+        auto const file_path = pending_files.back();
+        pending_files.pop_back();
+
+        auto const content = read_file(file_path.string().c_str(), cc::system_allocator);
+        if (content.empty())
+            return false;
+
+        char const* cursor = content.data();
+        char const* const end = content.data() + content.size() - 1;
+        bool is_line_start = true;
+
+        // braces, parentheses and brackets are only tracked outside of directives, function bodies start at brace depth 0
+        int brace_depth = 0;
+        int paren_depth = 0;
+        int bracket_depth = 0;
+        std::unordered_set<std::string>* body_identifiers = nullptr; // the function body the cursor is in, null if global
+        std::string body_function_name;
+
+        // the statement at brace depth 0 since the last ';' or '}', a function definition if it names a call before its '{'
+        std::vector<std::string> statement_identifiers;
+        std::string statement_function_name;
+        bool statement_is_data = false; // aggregates and initializers
+        bool is_previous_identifier = false;
+
+        // a preprocessor directive continues until an unescaped line end
+        bool is_directive = false;
+
+        auto const f_flush_statement = [&]
+        {
+            for (auto& ident : statement_identifiers)
+                out_scan.global_identifiers.insert(std::move(ident));
+
+            statement_identifiers.clear();
+            statement_function_name.clear();
+            statement_is_data = false;
+            paren_depth = 0;
+            bracket_depth = 0;
+        };
+
+        while (cursor < end)
+        {
+            char const c = *cursor;
+
+            if (c == '\n')
+            {
+                char const* last_char = cursor - 1;
+                if (last_char >= content.data() && *last_char == '\r')
+                    --last_char;
+
+                if (last_char < content.data() || *last_char != '\\')
+                    is_directive = false;
+
+                is_line_start = true;
+                ++cursor;
+            }
+            else if (c == ' ' || c == '\t' || c == '\r')
+            {
+                ++cursor;
+            }
+            else if (c == '/' && cursor[1] == '/')
+            {
+                while (cursor < end && *cursor != '\n')
+                    ++cursor;
+            }
+            else if (c == '/' && cursor[1] == '*')
+            {
+                cursor += 2;
+                while (cursor < end && !(cursor[0] == '*' && cursor[1] == '/'))
+                    ++cursor;
+                cursor = std::min(cursor + 2, end);
+            }
+            else if (c == '"')
+            {
+                ++cursor;
+                while (cursor < end && *cursor != '"' && *cursor != '\n')
+                    cursor += (cursor[0] == '\\' && cursor[1] != '\0') ? 2 : 1;
+                ++cursor;
+                is_line_start = false;
+                is_previous_identifier = false;
+            }
+            else if (c == '#' && cursor[1] == '#')
+            {
+                // token pasting can assemble any identifier
+                return false;
+            }
+            else if (c == '#' && is_line_start)
+            {
+                // preprocessor directive, resolve includes and scan the rest as usual
+                ++cursor;
+                while (cursor < end && (*cursor == ' ' || *cursor == '\t'))
+                    ++cursor;
+
+                is_line_start = false;
+                is_directive = true;
+                is_previous_identifier = false;
+
+                // conditionals within a function body only affect that body, other directives (ie. #define) affect all code that follows,
+                // a function body containing them is always considered reachable
+                bool const is_conditional
+                    = std::strncmp(cursor, "if", 2) == 0 || std::strncmp(cursor, "el", 2) == 0 || std::strncmp(cursor, "endif", 5) == 0;
+                if (body_identifiers && !is_conditional)
+                    out_scan.global_identifiers.insert(body_function_name);
+
+                if (std::strncmp(cursor, "include", 7) != 0)
+                    continue;
+
+                cursor += 7;
+                while (cursor < end && (*cursor == ' ' || *cursor == '\t'))
+                    ++cursor;
+
+                char const closing = (*cursor == '<') ? '>' : '"';
+                if (*cursor != '"' && *cursor != '<')
+                    return false; // include by macro
+
+                char const* const name_begin = ++cursor;
+                while (cursor < end && *cursor != closing && *cursor != '\n')
+                    ++cursor;
+
+                if (*cursor != closing)
+                    return false;
+
+                std::string const include_name(name_begin, cursor);
+                ++cursor;
+
+                // resolve relative to the including file first, then from the include paths
+                ec.clear();
+                auto include_path = std::filesystem::canonical(std::filesystem::path(file_path).remove_filename() / include_name, ec);
+                for (auto i = 0u; ec && i < include_paths.size(); ++i)
+                {
+                    ec.clear();
+                    include_path = std::filesystem::canonical(std::filesystem::path(include_paths[i]) / include_name, ec);
+                }
+
+                if (ec)
+                    return false;
+
+                if (visited_files.insert(include_path.string()).second)
+                    pending_files.push_back(include_path);
+            }
+            else if (is_identifier_start(c))
+            {
+                char const* const ident_begin = cursor;
+                while (cursor < end && is_identifier_char(*cursor))
+                    ++cursor;
+
+                std::string ident(ident_begin, cursor);
+                is_line_start = false;
+
+                if (body_identifiers)
+                {
+                    body_identifiers->insert(std::move(ident));
+                }
+                else if (is_directive)
+                {
+                    out_scan.global_identifiers.insert(std::move(ident));
+                }
+                else
+                {
+                    if (statement_identifiers.empty() && is_aggregate_keyword(ident))
+                        statement_is_data = true;
+
+                    statement_identifiers.push_back(std::move(ident));
+                    is_previous_identifier = true;
+                }
+            }
+            else
+            {
+                // skip numbers as a whole so suffixes are not mistaken for identifiers
+                if (c >= '0' && c <= '9')
+                {
+                    while (cursor < end && (is_identifier_char(*cursor) || *cursor == '.'))
+                        ++cursor;
+                }
+                else
+                {
+                    ++cursor;
+                }
+
+                is_line_start = false;
+
+                if (is_directive)
+                    continue;
+
+                if (c == '{')
+                {
+                    if (brace_depth++ == 0)
+                    {
+                        if (!statement_is_data && !statement_function_name.empty())
+                        {
+                            body_function_name = statement_function_name;
+                            body_identifiers = &out_scan.function_identifiers[body_function_name];
+                            body_identifiers->insert(statement_identifiers.begin(), statement_identifiers.end());
+                            statement_identifiers.clear();
+                            statement_function_name.clear();
+                            paren_depth = 0;
+                            bracket_depth = 0;
+                        }
+                        else
+                        {
+                            // aggregate or initializer, its contents are global
+                            f_flush_statement();
+                        }
+                    }
+                }
+                else if (c == '}')
+                {
+                    if (--brace_depth < 0)
+                        return false;
+
+                    if (brace_depth == 0)
+                    {
+                        body_identifiers = nullptr;
+                        f_flush_statement();
+                    }
+                }
+                else if (brace_depth == 0)
+                {
+                    // the first identifier called outside of attributes names the function, ie. "[numthreads(8, 8, 1)] void main_cs(...)"
+                    if (c == '(' && paren_depth == 0 && bracket_depth == 0 && is_previous_identifier && statement_function_name.empty())
+                        statement_function_name = statement_identifiers.back();
+
+                    if (c == '=' && paren_depth == 0 && bracket_depth == 0)
+                        statement_is_data = true;
+
+                    paren_depth += (c == '(') - (c == ')');
+                    bracket_depth += (c == '[') - (c == ']');
+
+                    if (c == ';' && paren_depth == 0 && bracket_depth == 0)
+                        f_flush_statement();
+                }
+
+                is_previous_identifier = false;
+            }
+        }
+
+        // braces spread across files or unbalanced by the preprocessor
+        if (brace_depth != 0)
+            return false;
+
+        f_flush_statement();
+    }
+
+    return true;
+}
+
+// collects the identifiers that can affect the code of an entrypoint: all global identifiers, and the identifiers of all functions reachable
+// from the entrypoint, the global code or the values of the fixed defines of the binary (ie. "SHADE=shade_ibl")
+// returns false if the entrypoint is not defined by name, ie. if its signature is produced by a macro
+bool get_entrypoint_identifiers(source_scan const& scan,
+                                dxcw::shaderlist_binary_entry_owning const& entry,
+                                std::unordered_set<std::string>& out_identifiers)
+{
+    if (scan.function_identifiers.count(entry.entrypoint) == 0)
+        return false;
+
+    out_identifiers.clear();
+    std::vector<std::string const*> pending;
+
+    auto const f_add = [&](std::string const& ident)
+    {
+        auto const [it, is_new] = out_identifiers.insert(ident);
+        if (is_new)
+            pending.push_back(&*it);
+    };
+
+    f_add(entry.entrypoint);
+    for (auto const& ident : scan.global_identifiers)
+        f_add(ident);
+
+    for (auto i = 0u; i < entry.num_defines; ++i)
+    {
+        char const* value = std::strchr(entry.get_define(i), '=');
+        while (value && *value != '\0')
+        {
+            char const* const ident_begin = value;
+            while (is_identifier_char(*value))
+                ++value;
+
+            if (value != ident_begin && is_identifier_start(*ident_begin))
+                f_add(std::string(ident_begin, value));
+
+            if (value == ident_begin)
+                ++value;
+        }
+    }
+
+    while (!pending.empty())
+    {
+        auto const it = scan.function_identifiers.find(*pending.back());
+        pending.pop_back();
+
+        if (it == scan.function_identifiers.end())
+            continue;
+
+        for (auto const& ident : it->second)
+            f_add(ident);
+    }
+
+    return true;
+}
+
+// an axis is referenced if its name occurs in the source identifiers or in the value of a fixed define of the binary (ie. "MODE=QUALITY")
+uint32_t get_referenced_axes_from_identifiers(dxcw::shaderlist_binary_entry_owning const& entry, std::unordered_set<std::string> const& identifiers)
+{
+    auto const& matrix = entry.permutations;
+
+    uint32_t res = 0;
+    for (auto axis = 0u; axis < matrix.num_axes; ++axis)
+    {
+        char const* const name = matrix.get_axis_name(axis);
+        if (identifiers.count(name) > 0)
+        {
+            res |= 1u << axis;
+            continue;
+        }
+
+        for (auto i = 0u; i < entry.num_defines; ++i)
+        {
+            char const* const define_value = std::strchr(entry.get_define(i), '=');
+            if (define_value && std::strstr(define_value + 1, name) != nullptr)
+            {
+                res |= 1u << axis;
+                break;
+            }
+        }
+    }
+    return res;
+}
+
+// decodes a permutation index into per-axis value indices
+void decode_permutation_index(dxcw::shaderlist_permutation_matrix const& matrix, unsigned index, uint8_t* out_value_indices)
+{
+    for (auto axis = 0u; axis < matrix.num_axes; ++axis)
+    {
+        out_value_indices[axis] = uint8_t(index % matrix.axis_num_values[axis]);
+        index /= matrix.axis_num_values[axis];
+    }
+}
+
+bool is_permutation_excluded(dxcw::shaderlist_permutation_matrix const& matrix, uint8_t const* value_indices)
+{
+    for (auto i = 0u; i < matrix.num_exclusions; ++i)
+    {
+        bool matches_all = true;
+        for (auto axis = 0u; axis < matrix.num_axes; ++axis)
+        {
+            uint8_t const rule_value = matrix.exclusions[i][axis];
+            if (rule_value != dxcw::shaderlist_permutation_matrix::any_value && rule_value != value_indices[axis])
+            {
+                matches_all = false;
+                break;
+            }
+        }
+
+        if (matches_all)
+            return true;
+    }
+
+    return false;
+}
+
+// calls f(index) for all non-excluded permutations that share the values of all referenced axes with the given one, in ascending order
+// stops early if f returns false
+template <class F>
+void for_each_equivalent_permutation(dxcw::shaderlist_permutation_matrix const& matrix, unsigned index, uint32_t referenced_axes, F&& f)
+{
+    uint8_t value_indices[dxcw::shaderlist_permutation_matrix::max_num_axes];
+    decode_permutation_index(matrix, index, value_indices);
+
+    unsigned strides[dxcw::shaderlist_permutation_matrix::max_num_axes];
+    unsigned base_index = 0;
+    unsigned stride = 1;
+    for (auto axis = 0u; axis < matrix.num_axes; ++axis)
+    {
+        strides[axis] = stride;
+
+        // start at value 0 on all unreferenced axes
+        if (referenced_axes & (1u << axis))
+            base_index += value_indices[axis] * stride;
+        else
+            value_indices[axis] = 0;
+
+        stride *= matrix.axis_num_values[axis];
+    }
+
+    // mixed radix counter over the unreferenced axes only, first axis fastest (yields ascending indices)
+    unsigned current_index = base_index;
+    while (true)
+    {
+        if (!is_permutation_excluded(matrix, value_indices))
+        {
+            if (!f(current_index))
+                return;
+        }
+
+        unsigned axis = 0;
+        for (; axis < matrix.num_axes; ++axis)
+        {
+            if (referenced_axes & (1u << axis))
+                continue;
+
+            if (value_indices[axis] + 1u < matrix.axis_num_values[axis])
+            {
+                ++value_indices[axis];
+                current_index += strides[axis];
+                break;
+            }
+
+            current_index -= value_indices[axis] * strides[axis];
+            value_indices[axis] = 0;
+        }
+
+        if (axis == matrix.num_axes)
+            return;
+    }
+}
+
+// compiles binaries without permutations that share a source, defines and debug flag
+// the source is read once, includes are loaded once and the entrypoints compile in parallel (up to num_threads)
+// returns the amount of failed binaries
+unsigned compile_binary_group(dxcw::compiler& compiler,
+                              cc::span<dxcw::shaderlist_binary_entry_owning const* const> group,
+                              cc::span<char const* const> opt_additional_include_paths,
+                              unsigned num_threads,
+                              job_context const& ctx)
+{
+    CC_CONTRACT(!group.empty());
+    auto const& first = *group[0];
+
+    auto const source = ctx.sources->load(first.pathin_absolute);
+    if (!source.is_valid())
+    {
+        DXCW_LOG_ERROR("failed to open shader source file at {}", first.pathin_absolute);
+        return unsigned(group.size());
+    }
+
+    cc::string_view const source_text(source.text, source.size);
+
+    unsigned num_failed = 0;
+    std::vector<dxcw::shaderlist_binary_entry_owning const*> members;
+    std::vector<dxcw::entrypoint_description> entrypoints;
+    members.reserve(group.size());
+    entrypoints.reserve(group.size());
+
+    for (auto const* const entry : group)
+    {
+        dxcw::target parsed_target;
+        if (!dxcw::parse_target(entry->target, parsed_target))
+        {
+            DXCW_LOG_WARN("error compiling {} ({}; {})", entry->pathin, entry->target, entry->entrypoint);
+            ++num_failed;
+            continue;
+        }
+
+        members.push_back(entry);
+        entrypoints.push_back(dxcw::entrypoint_description{entry->entrypoint, parsed_target, entry->sm});
+    }
+
+    char const* defines[CC_COUNTOF(first.define_offsets)];
+    for (auto i = 0u; i < first.num_defines; ++i)
+        defines[i] = first.get_define(i);
+
+    dxcw::compilation_config config = {};
+    config.build_debug = first.build_debug;
+    config.debug_info = first.debug_info;
+    config.additional_include_paths = opt_additional_include_paths;
+    config.defines = cc::span<char const* const>(defines, first.num_defines);
+    config.filename_for_errors = first.pathin_absolute;
+
+    std::vector<bool> succeeded(members.size(), true);
+    std::vector<dxcw::binary> binaries(members.size());
+    std::vector<dxcw::external_pdb> pdbs(members.size());
+
+    auto const f_compile_output = [&](dxcw::output output, char const* ending)
+    {
+        config.output_format = output;
+        compiler.compile_shader_multi(source_text, cc::span<dxcw::entrypoint_description const>(entrypoints.data(), entrypoints.size()), config,
+                                      cc::span<dxcw::binary>(binaries.data(), binaries.size()), num_threads,
+                                      cc::span<dxcw::external_pdb>(pdbs.data(), pdbs.size()));
+
+        for (auto i = 0u; i < members.size(); ++i)
+        {
+            if (binaries[i].internal_blob == nullptr)
+            {
+                succeeded[i] = false;
+                continue;
+            }
+
+            strip_output(compiler, binaries[i], members[i]->pathout_absolute, ending, output, members[i]->strip);
+            write_output(binaries[i], members[i]->pathout_absolute, ending, first.pathin_absolute, members[i]->entrypoint, entrypoints[i].target,
+                         output, ctx);
+            dxcw::destroy_blob(binaries[i].internal_blob);
+
+            // external PDBs go next to the output of their binary, failing to write one fails the binary
+            if (pdbs[i].data.internal_blob != nullptr)
+            {
+                if (!write_pdb(pdbs[i], members[i]->pathout_absolute, ctx))
+                    succeeded[i] = false;
+
+                dxcw::destroy_blob(pdbs[i].data.internal_blob);
+            }
+        }
+    };
+
+#ifdef CC_OS_WINDOWS
+    f_compile_output(dxcw::output::dxil, "dxil");
+#endif
+    // On non-windows, DXIL can be compiled but not signed which makes it mostly useless
+    f_compile_output(dxcw::output::spirv, "spv");
+
+    for (auto i = 0u; i < members.size(); ++i)
+    {
+        auto const& entry = *members[i];
+        if (succeeded[i])
+        {
+            DXCW_LOG("compiled {} ({}; {})", entry.pathin, entry.target, entry.entrypoint);
+        }
+        else
+        {
+            DXCW_LOG_WARN("error compiling {} ({}; {})", entry.pathin, entry.target, entry.entrypoint);
+            ++num_failed;
+        }
+    }
+
+    return num_failed;
+}
+
+// calls f(key, text, is_error) for each single diagnostic in DXC diagnostics output
+// a diagnostic starts at a line like "<file>:<line>:<column>: error: <message>" and contains the following code, caret and note lines
+// "In file included from" lines belong to the next diagnostic, the key only consists of file, line, severity and message
+template <class F>
+void for_each_diagnostic(char const* diagnostics, F&& f)
+{
+    constexpr std::string_view severities[] = {": fatal error: ", ": error: ", ": warning: "};
+
+    std::string key;
+    std::string text;
+    std::string pending_text;
+    bool is_error = false;
+
+    auto const f_flush = [&]
+    {
+        if (!key.empty())
+            f(key, text, is_error);
+
+        key.clear();
+        text.clear();
+    };
+
+    std::string_view rest = diagnostics;
+    while (!rest.empty())
+    {
+        auto const line_end = rest.find('\n');
+        auto const line = rest.substr(0, line_end);
+        rest = line_end == std::string_view::npos ? std::string_view{} : rest.substr(line_end + 1);
+
+        if (line.rfind("In file included from ", 0) == 0)
+        {
+            f_flush();
+            pending_text.append(line).push_back('\n');
+            continue;
+        }
+
+        // diagnostics without location start with the severity directly ("error: validation errors")
+        std::string_view location;
+        std::string_view severity;
+        std::string_view message;
+        for (auto const sev : severities)
+        {
+            auto const sev_without_colon = sev.substr(2);
+            if (line.rfind(sev_without_colon, 0) == 0)
+            {
+                severity = sev_without_colon;
+                message = line.substr(sev_without_colon.size());
+                break;
+            }
+
+            auto const pos = line.find(sev);
+            if (pos != std::string_view::npos)
+            {
+                location = line.substr(0, pos);
+                severity = sev.substr(2);
+                message = line.substr(pos + sev.size());
+                break;
+            }
+        }
+
+        if (severity.empty())
+        {
+            // code, caret or note line of the current diagnostic
+            (key.empty() ? pending_text : text).append(line).push_back('\n');
+            continue;
+        }
+
+        f_flush();
+
+        // strip the column, the same message can be reported at different columns of a macro expansion
+        auto const column_start = location.rfind(':');
+        if (column_start != std::string_view::npos && location.find_first_not_of("0123456789", column_start + 1) == std::string_view::npos)
+            location = location.substr(0, column_start);
+
+        key.append(location).append("\n").append(severity).append(message);
+        text = std::move(pending_text);
+        text.append(line).push_back('\n');
+        pending_text.clear();
+        is_error = severity != severities[2].substr(2);
+    }
+
+    f_flush();
+
+    // unrecognized output is treated as a single error
+    if (!pending_text.empty())
+        f(pending_text, pending_text, true);
+}
+
+// collects compiler diagnostics of many compilations, used as the dxcw::diagnostic_callback of compilers in compile_entries_parallel
+// identical diagnostics, as produced by an error in a header shared by many permutations, are logged only once
+struct diagnostic_collector
+{
+    struct unique_diagnostic
+    {
+        std::string text;
+        bool is_error = false;
+        std::vector<std::string> compilations;
+    };
+
+    std::mutex mutex;
+    std::unordered_map<std::string, size_t> indices;
+    std::vector<unique_diagnostic> diagnostics;
+    // compilation name and unmodified diagnostics per compilation, for the report file
+    std::vector<std::pair<std::string, std::string>> full_texts;
+
+    static void callback(void* userdata, dxcw::compilation_config const& config, char const* entrypoint, char const* diagnostics)
+    {
+        // name compilations by source, entrypoint, output and defines, which identifies the entry and the permutation
+        std::string name = config.filename_for_errors ? config.filename_for_errors : "<unnamed>";
+        name.append(" (").append(entrypoint ? entrypoint : "library").append("; ").append(config.output_format == dxcw::output::dxil ? "DXIL" : "SPIR-V");
+        for (char const* const define : config.defines)
+            name.append("; ").append(define);
+        name.push_back(')');
+
+        static_cast<diagnostic_collector*>(userdata)->add(std::move(name), diagnostics);
+    }
+
+    void add(std::string compilation_name, char const* text)
+    {
+        std::lock_guard lg(mutex);
+
+        for_each_diagnostic(text,
+                            [&](std::string const& key, std::string const& diagnostic_text, bool is_error)
+                            {
+                                auto const [it, is_new] = indices.try_emplace(key, diagnostics.size());
+                                if (is_new)
+                                {
+                                    auto const text_end = diagnostic_text.find_last_not_of('\n');
+                                    diagnostics.push_back(unique_diagnostic{diagnostic_text.substr(0, text_end + 1), is_error, {}});
+                                }
+
+                                // the same diagnostic can occur multiple times within one compilation
+                                auto& compilations = diagnostics[it->second].compilations;
+                                if (compilations.empty() || compilations.back() != compilation_name)
+                                    compilations.push_back(compilation_name);
+                            });
+
+        full_texts.emplace_back(std::move(compilation_name), text);
+    }
+
+    void log_summary()
+    {
+        constexpr size_t max_num_listed = 3;
+
+        for (auto& diag : diagnostics)
+        {
+            if (diag.is_error)
+                DXCW_LOG_ERROR("{}", diag.text);
+            else
+                DXCW_LOG_WARN("{}", diag.text);
+
+            std::sort(diag.compilations.begin(), diag.compilations.end());
+            for (auto i = 0u; i < diag.compilations.size() && i < max_num_listed; ++i)
+                DXCW_LOG("  in {}", diag.compilations[i]);
+
+            if (diag.compilations.size() > max_num_listed)
+                DXCW_LOG("  and {} more compilations ({} total)", diag.compilations.size() - max_num_listed, diag.compilations.size());
+        }
+    }
+
+    // writes the full diagnostics of all compilations, removes a stale report if there are none
+    bool write_report(char const* path)
+    {
+        if (full_texts.empty())
+        {
+            std::error_code ec;
+            std::filesystem::remove(path, ec);
+            return true;
+        }
+
+        std::sort(full_texts.begin(), full_texts.end());
+
+        std::ofstream file(path);
+        if (!file.good())
+        {
+            DXCW_LOG_ERROR("failed to write diagnostics report to {}", path);
+            return false;
+        }
+
+        for (auto const& [name, text] : full_texts)
+            file << "=== " << name << " ===\n" << text << "\n";
+
+        DXCW_LOG("{} unique diagnostics in {} compilations, full report written to {}", diagnostics.size(), full_texts.size(), path);
+        return true;
+    }
+};
+
+// compiles a library and writes its binaries to the output path (without file ending), or into the archive if present
+bool compile_library_to_files(dxcw::compiler& compiler,
+                              char const* source_path,
+                              cc::span<dxcw::library_export const> exports,
+                              char const* output_path,
+                              dxcw::strip_flags strip,
+                              cc::span<char const* const> opt_additional_include_paths,
+                              job_context const& ctx,
+                              cc::allocator* scratch_alloc)
+{
+    if (exports.empty())
+    {
+        DXCW_LOG_WARN("skipping compilation of library without exports at {}", source_path);
+        return false;
+    }
+
+    auto const source = ctx.sources->load(source_path);
+
+    if (!source.is_valid())
+    {
+        DXCW_LOG_ERROR("failed to open library source file at {}", source_path);
+        return false;
+    }
+
+    cc::string_view const source_text(source.text, source.size);
+
+#ifdef CC_OS_WINDOWS
+    auto dxil_binary = compiler.compile_library(source_text, exports, dxcw::output::dxil, false, opt_additional_include_paths, source_path, {}, scratch_alloc);
+
+    if (dxil_binary.internal_blob == nullptr)
+        return false;
+
+    strip_output(compiler, dxil_binary, output_path, "dxil", dxcw::output::dxil, strip);
+    write_output(dxil_binary, output_path, "dxil", source_path, nullptr, dxcw::target::vertex, dxcw::output::dxil, ctx,
+                 dxcw::archive_entry::flag_library);
+    dxcw::destroy_blob(dxil_binary.internal_blob);
+#endif
+    // On non-windows, DXIL can be compiled but not signed which makes it mostly useless
+    // requiring DXIL on linux would be a pretty strange path but can be supported with more tricks
+
+    auto spv_binary = compiler.compile_library(source_text, exports, dxcw::output::spirv, false, opt_additional_include_paths, source_path, {}, scratch_alloc);
+    if (spv_binary.internal_blob == nullptr)
+        return false;
+
+    strip_output(compiler, spv_binary, output_path, "spv", dxcw::output::spirv, strip);
+    write_output(spv_binary, output_path, "spv", source_path, nullptr, dxcw::target::vertex, dxcw::output::spirv, ctx,
+                 dxcw::archive_entry::flag_library);
+    dxcw::destroy_blob(spv_binary.internal_blob);
+    return true;
+}
+
+bool compile_library_entry_to_files(dxcw::compiler& compiler,
+                                    dxcw::shaderlist_library_entry_owning const& entry,
+                                    cc::span<char const* const> opt_additional_include_paths,
+                                    job_context const& ctx,
+                                    cc::allocator* scratch_alloc)
+{
+    auto exports = cc::alloc_array<dxcw::library_export>::uninitialized(entry.num_exports, scratch_alloc);
+
+    for (auto i = 0u; i < entry.num_exports; ++i)
+    {
+        exports[i].internal_name = entry.exports_internal_names[i];
+        exports[i].export_name = entry.exports_exported_names[i];
+    }
+
+    auto const success = compile_library_to_files(compiler, entry.pathin_absolute, exports, entry.pathout_absolute, entry.strip,
+                                                  opt_additional_include_paths, ctx, scratch_alloc);
+
+    if (success)
+        DXCW_LOG("compiled library {} ({} exports)", entry.pathin, entry.num_exports);
+    else
+        DXCW_LOG_WARN("error compiling library {} ({} exports)", entry.pathin, entry.num_exports);
+
+    return success;
+}
+
+enum class permutation_result
+{
+    excluded,
+    aliased,
+    failed,
+    succeeded
+};
+
+// compiles a single permutation of a binary entry
+// if it is the canonical permutation of its equivalence class (see referenced_axes), the binaries are also written for all others of the class
+permutation_result compile_binary_permutation(dxcw::compiler& compiler,
+                                              dxcw::shaderlist_binary_entry_owning const& entry,
+                                              unsigned permutation_index,
+                                              uint32_t referenced_axes,
+                                              cc::span<char const* const> opt_additional_include_paths,
+                                              job_context const& ctx)
+{
+    dxcw::shaderlist_permutation permutation;
+    if (!dxcw::get_permutation(entry, permutation_index, &permutation))
+        return permutation_result::excluded;
+
+    if (dxcw::get_canonical_permutation(entry, permutation_index, referenced_axes) != permutation_index)
+        return permutation_result::aliased;
+
+    // gather the output paths of all permutations that compile to identical binaries
+    std::vector<std::string> alias_paths;
+    for_each_equivalent_permutation(entry.permutations, permutation_index, referenced_axes,
+                                    [&](unsigned alias_index)
+                                    {
+                                        if (alias_index != permutation_index)
+                                        {
+                                            dxcw::shaderlist_permutation alias;
+                                            dxcw::get_permutation(entry, alias_index, &alias);
+                                            alias_paths.emplace_back(alias.pathout_absolute);
+                                        }
+                                        return true;
+                                    });
+
+    std::vector<char const*> output_paths;
+    output_paths.reserve(alias_paths.size() + 1);
+    output_paths.push_back(permutation.pathout_absolute);
+    for (auto const& path : alias_paths)
+        output_paths.push_back(path.c_str());
+
+    // fixed defines of the binary, followed by the defines of referenced axes (the others have no effect)
+    char const* defines[CC_COUNTOF(entry.define_offsets) + dxcw::shaderlist_permutation_matrix::max_num_axes];
+    unsigned num_defines = 0;
+    for (auto i = 0u; i < entry.num_defines; ++i)
+        defines[num_defines++] = entry.get_define(i);
+
+    for (auto axis = 0u; axis < permutation.num_defines; ++axis)
+    {
+        if (referenced_axes & (1u << axis))
+            defines[num_defines++] = permutation.defines[axis];
+    }
+
+    auto const success = compile_shader_to_files(compiler, entry.pathin_absolute, entry.target, entry.entrypoint, output_paths, entry.sm,
+                                                 entry.build_debug, entry.debug_info, entry.strip, opt_additional_include_paths,
+                                                 cc::span<char const* const>(defines, num_defines), ctx);
 
-    res[res.size() - 1] = '\0';
-    return res;
+    if (entry.permutations.num_axes == 0)
+    {
+        if (success)
+            DXCW_LOG("compiled {} ({}; {})", entry.pathin, entry.target, entry.entrypoint);
+        else
+            DXCW_LOG_WARN("error compiling {} ({}; {})", entry.pathin, entry.target, entry.entrypoint);
+    }
+    else
+    {
+        if (success)
+            DXCW_LOG("compiled {} ({}; {}; permutation {}, {} aliases)", entry.pathin, entry.target, entry.entrypoint, permutation_index,
+                     alias_paths.size());
+        else
+            DXCW_LOG_WARN("error compiling {} ({}; {}; permutation {})", entry.pathin, entry.target, entry.entrypoint, permutation.pathout_absolute);
+    }
+
+    return success ? permutation_result::succeeded : permutation_result::failed;
 }
 }
 
@@ -58,7 +1539,12 @@ bool dxcw::write_binary_to_file(const dxcw::binary& binary, const char* path, co
     CC_CONTRACT(ending);
 
     char outpath[1024];
-    std::snprintf(outpath, sizeof(outpath), "%s.%s", path, ending);
+    int const length = std::snprintf(outpath, sizeof(outpath), "%s.%s", path, ending);
+    if (length < 0 || size_t(length) >= sizeof(outpath))
+    {
+        DXCW_LOG_ERROR("output path {}.{} exceeds {} characters", path, ending, sizeof(outpath) - 1);
+        return false;
+    }
 
     return write_binary_to_file(binary, outpath);
 }
@@ -69,20 +1555,33 @@ bool dxcw::write_binary_to_file(const dxcw::binary& binary, const char* path)
     if (binary.data == nullptr)
         return false;
 
-    // recursively create directories required for the output
-    std::filesystem::create_directories(std::filesystem::path(path).remove_filename());
+    // recursively create directories required for the output, usually already done for the entire shaderlist
+    ensure_parent_directory(path);
 
-#ifdef CC_OS_WINDOWS
-    std::FILE* fp = nullptr;
-    errno_t err = ::fopen_s(&fp, path, "wb");
-    if (err != 0)
+    // rewriting identical content would only bump the modification time and retrigger hot reloading
+    if (is_file_content_equal(path, binary.data, binary.size))
     {
-        fp = nullptr;
+        ++g_num_skipped_writes;
+        return true;
     }
 
-#else
-    std::FILE* fp = std::fopen(path, "wb");
-#endif
+    // write next to the output and rename over it, the output is replaced atomically
+    // the temporary name appends ".<process id>.<index>.tmp" to the path
+    char temp_path[1040];
+    if (std::strlen(path) + sizeof(".4294967295.4294967295.tmp") > sizeof(temp_path))
+    {
+        DXCW_LOG_ERROR("output path {} is too long for a temporary file", path);
+        return false;
+    }
+
+    std::FILE* fp = create_temp_file(path, temp_path, sizeof(temp_path));
+    if (!fp)
+    {
+        // the directory might have been removed since it was cached
+        forget_parent_directory(path);
+        if (ensure_parent_directory(path))
+            fp = create_temp_file(path, temp_path, sizeof(temp_path));
+    }
 
     if (!fp)
     {
@@ -90,54 +1589,48 @@ bool dxcw::write_binary_to_file(const dxcw::binary& binary, const char* path)
         return false;
     }
 
-    std::fwrite(binary.data, 1, binary.size, fp);
-    std::fclose(fp);
+    bool const written = std::fwrite(binary.data, 1, binary.size, fp) == binary.size;
+    bool const closed = std::fclose(fp) == 0;
+
+    std::error_code ec;
+    if (written && closed)
+    {
+        std::filesystem::rename(temp_path, path, ec);
+    }
+
+    if (!written || !closed || ec)
+    {
+        std::filesystem::remove(temp_path, ec);
+        DXCW_LOG_ERROR("failed to write shader to {}", path);
+        return false;
+    }
+
     return true;
 }
 
+unsigned dxcw::get_num_skipped_writes() { return g_num_skipped_writes.load(); }
+
 bool dxcw::compile_shader(dxcw::compiler& compiler,
                           const char* source_path,
                           const char* shader_target,
                           const char* entrypoint,
                           const char* output_path,
                           cc::span<char const* const> opt_additional_include_paths,
-                          cc::allocator* scratch_alloc)
+                          cc::allocator* /*scratch_alloc*/,
+                          cc::span<char const* const> opt_defines)
 {
-    auto const content = read_file(source_path, scratch_alloc);
-
-    if (content.empty())
-    {
-        DXCW_LOG_ERROR("failed to open shader source file at {}", source_path);
-        return false;
-    }
-
-    dxcw::target parsed_target;
-    if (!parse_target(shader_target, parsed_target))
-    {
-        return false;
-    }
+    dxcw::detail::source_cache sources;
+    sources.initialize();
 
-#ifdef CC_OS_WINDOWS
-    auto dxil_binary = compiler.compile_shader(content.data(), entrypoint, parsed_target, dxcw::output::dxil, dxcw::shader_model::sm_use_default,
-                                               false, opt_additional_include_paths, source_path, {}, scratch_alloc);
-
-    if (dxil_binary.internal_blob == nullptr)
-        return false;
-
-    dxcw::write_binary_to_file(dxil_binary, output_path, "dxil");
-    dxcw::destroy_blob(dxil_binary.internal_blob);
-#endif
-    // On non-windows, DXIL can be compiled but not signed which makes it mostly useless
-    // requiring DXIL on linux would be a pretty strange path but can be supported with more tricks
+    job_context ctx;
+    ctx.sources = &sources;
 
-    auto spv_binary = compiler.compile_shader(content.data(), entrypoint, parsed_target, dxcw::output::spirv, dxcw::shader_model::sm_use_default,
-                                              false, opt_additional_include_paths, source_path, {}, scratch_alloc);
-    if (spv_binary.internal_blob == nullptr)
-        return false;
+    char const* const output_paths[] = {output_path};
+    bool const success = compile_shader_to_files(compiler, source_path, shader_target, entrypoint, output_paths, dxcw::shader_model::sm_use_default,
+                                                 false, dxcw::debug_info::embedded, dxcw::strip_none, opt_additional_include_paths, opt_defines, ctx);
 
-    dxcw::write_binary_to_file(spv_binary, output_path, "spv");
-    dxcw::destroy_blob(spv_binary.internal_blob);
-    return true;
+    sources.destroy();
+    return success;
 }
 
 bool dxcw::compile_library(dxcw::compiler& compiler,
@@ -147,56 +1640,45 @@ bool dxcw::compile_library(dxcw::compiler& compiler,
                            cc::span<char const* const> opt_additional_include_paths,
                            cc::allocator* scratch_alloc)
 {
-    if (exports.empty())
-    {
-        DXCW_LOG_WARN("skipping compilation of library without exports at {}", source_path);
-        return false;
-    }
-
-    auto const content = read_file(source_path, scratch_alloc);
-
-    if (content.empty())
-    {
-        DXCW_LOG_ERROR("failed to open library source file at {}", source_path);
-        return false;
-    }
-
-#ifdef CC_OS_WINDOWS
-    auto dxil_binary = compiler.compile_library(content.data(), exports, dxcw::output::dxil, false, opt_additional_include_paths, source_path, {}, scratch_alloc);
+    dxcw::detail::source_cache sources;
+    sources.initialize();
 
-    if (dxil_binary.internal_blob == nullptr)
-        return false;
-
-    dxcw::write_binary_to_file(dxil_binary, output_path, "dxil");
-    dxcw::destroy_blob(dxil_binary.internal_blob);
-#endif
-    // On non-windows, DXIL can be compiled but not signed which makes it mostly useless
-    // requiring DXIL on linux would be a pretty strange path but can be supported with more tricks
+    job_context ctx;
+    ctx.sources = &sources;
 
-    auto spv_binary = compiler.compile_library(content.data(), exports, dxcw::output::spirv, false, opt_additional_include_paths, source_path, {}, scratch_alloc);
-    if (spv_binary.internal_blob == nullptr)
-        return false;
+    bool const success = compile_library_to_files(compiler, source_path, exports, output_path, dxcw::strip_none, opt_additional_include_paths, ctx,
+                                                  scratch_alloc);
 
-    dxcw::write_binary_to_file(spv_binary, output_path, "spv");
-    dxcw::destroy_blob(spv_binary.internal_blob);
-    return true;
+    sources.destroy();
+    return success;
 }
 
 
 bool dxcw::compile_binary_entry(dxcw::compiler& compiler,
                                 const dxcw::shaderlist_binary_entry_owning& entry,
                                 cc::span<char const* const> opt_additional_include_paths,
-                                cc::allocator* scratch_alloc)
+                                cc::allocator* /*scratch_alloc*/)
 {
-    auto const success = dxcw::compile_shader(compiler, entry.pathin_absolute, entry.target, entry.entrypoint, entry.pathout_absolute,
-                                              opt_additional_include_paths, scratch_alloc);
+    bool all_succeeded = true;
 
-    if (success)
-        DXCW_LOG("compiled {} ({}; {})", entry.pathin, entry.target, entry.entrypoint);
-    else
-        DXCW_LOG_WARN("error compiling {} ({}; {})", entry.pathin, entry.target, entry.entrypoint);
+    uint32_t const referenced_axes = get_referenced_permutation_axes(entry, opt_additional_include_paths);
 
-    return success;
+    // all permutations share the mapping of the source
+    dxcw::detail::source_cache sources;
+    sources.initialize();
+
+    job_context ctx;
+    ctx.sources = &sources;
+
+    unsigned const num_permutations = get_num_permutations(entry);
+    for (auto i = 0u; i < num_permutations; ++i)
+    {
+        if (compile_binary_permutation(compiler, entry, i, referenced_axes, opt_additional_include_paths, ctx) == permutation_result::failed)
+            all_succeeded = false;
+    }
+
+    sources.destroy();
+    return all_succeeded;
 }
 
 bool dxcw::compile_library_entry(dxcw::compiler& compiler,
@@ -204,21 +1686,15 @@ bool dxcw::compile_library_entry(dxcw::compiler& compiler,
                                  cc::span<char const* const> opt_additional_include_paths,
                                  cc::allocator* scratch_alloc)
 {
-    auto exports = cc::alloc_array<library_export>::uninitialized(entry.num_exports, scratch_alloc);
+    dxcw::detail::source_cache sources;
+    sources.initialize();
 
-    for (auto i = 0u; i < entry.num_exports; ++i)
-    {
-        exports[i].internal_name = entry.exports_internal_names[i];
-        exports[i].export_name = entry.exports_exported_names[i];
-    }
-
-    auto const success = dxcw::compile_library(compiler, entry.pathin_absolute, exports, entry.pathout_absolute, opt_additional_include_paths, scratch_alloc);
+    job_context ctx;
+    ctx.sources = &sources;
 
-    if (success)
-        DXCW_LOG("compiled library {} ({} exports)", entry.pathin, entry.num_exports);
-    else
-        DXCW_LOG_WARN("error compiling library {} ({} exports)", entry.pathin, entry.num_exports);
+    bool const success = compile_library_entry_to_files(compiler, entry, opt_additional_include_paths, ctx, scratch_alloc);
 
+    sources.destroy();
     return success;
 }
 
@@ -289,254 +1765,110 @@ bool dxcw::compile_shaderlist(dxcw::compiler& compiler, const char* shaderlist_f
             bool const success = compile_shader(compiler, pathin_absolute.string().c_str(), target.c_str(), entrypoint.c_str(),
                                                 (base_path_fs / pathout).string().c_str(), additonalIncludes, scratch_alloc);
 
-            if (!success)
-                ++num_errors;
-        }
-        else
-        {
-            DXCW_LOG_WARN("failed to parse shaderlist line {}:", num_lines);
-            DXCW_LOG_WARN("\"{}\"", line.c_str());
-            ++num_errors;
-        }
-    }
-
-    if (out_results)
-        *out_results = {num_shaders, 0, num_errors};
-
-    return true;
-}
-
-bool dxcw::compile_shaderlist_json(dxcw::compiler& compiler, const char* json_file, dxcw::shaderlist_compilation_result* out_results, cc::allocator* scratch_alloc)
-{
-    auto content = read_file(json_file, scratch_alloc);
-    if (content.empty())
-    {
-        DXCW_LOG_ERROR("failed to open shaderlist json file at {}", json_file);
-        return false;
-    }
-
-    // set the working directory to the folder containing the list this was invoked with
-    std::error_code ec;
-    auto const base_path_fs = std::filesystem::canonical(std::filesystem::path(json_file).remove_filename(), ec);
-    if (ec)
-    {
-        DXCW_LOG_ERROR("failed to make path canonical for shaderlist json file at {}", json_file);
-        return false;
-    }
-
-    auto const base_path_string = base_path_fs.string();
-    cc::alloc_array<json_t> json_nodes(512, scratch_alloc);
-
-    json_t const* const j_root = json_create(content.data(), json_nodes.data(), unsigned(json_nodes.size()));
-    if (j_root == nullptr || j_root->type != JSON_OBJ)
-    {
-        DXCW_LOG_ERROR("fatal json parse error in shaderlist json {} ({} chars)", json_file, content.size());
-        return false;
-    }
-
-    json_t const* j_entries_arr = json_getProperty(j_root, "entries");
-    unsigned num_valid_entries = 0;
-    unsigned num_entries = 0;
-    int num_shaders = 0;
-    int num_libraries = 0;
-    int num_errors = 0;
-
-    auto const f_get_string_prop = [](json_t const* node, char const* property_name) -> char const*
-    {
-        if (!node)
-            return nullptr;
-        auto const prop = json_getProperty(node, property_name);
-        if (!prop || prop->type != JSON_TEXT)
-            return nullptr;
-        return json_getValue(prop);
-    };
-
-    if (j_entries_arr == nullptr)
-    {
-        DXCW_LOG_ERROR("missing root property \"entries\"");
-        goto l_parse_error;
-    }
-
-    if (json_getType(j_entries_arr) != JSON_ARRAY)
-    {
-        DXCW_LOG_ERROR("root property \"entries\" must be an array");
-        goto l_parse_error;
-    }
-
-    // loop over all entry nodes in "entries": [ ... ] array
-    for (json_t const* j_entry = json_getChild(j_entries_arr); j_entry; j_entry = json_getSibling(j_entry))
-    {
-        ++num_entries;
-        if (json_getType(j_entry) != JSON_OBJ)
-        {
-            DXCW_LOG_WARN("skipping non-object element #{} in \"entries\" array", num_entries);
-            continue;
-        }
-
-        char const* const str_source = f_get_string_prop(j_entry, "source");
-        if (!str_source)
-        {
-            DXCW_LOG_WARN("skipping entry #{} without required \"source\" property", num_entries);
-            continue;
-        }
-
-        // "canonize" path - ie. make it absolute and check if the file exists
-        ec = {};
-        auto const pathin_absolute = std::filesystem::canonical(base_path_fs / str_source, ec);
-        if (ec)
-        {
-            DXCW_LOG_WARN("shader source {} not found (shader json entry #{})", str_source, num_entries);
-            ++num_errors;
-            continue;
-        }
-
-        ++num_valid_entries;
-
-        json_t const* const jp_binaries = json_getProperty(j_entry, "binaries");
-        if (jp_binaries)
-        {
-            if (json_getType(jp_binaries) != JSON_ARRAY)
-            {
-                DXCW_LOG_WARN("entry #{} property \"binaries\" is not an array", num_entries);
-            }
-            else
-            {
-                unsigned num_bins = 0;
-                for (json_t const* j_bin = json_getChild(jp_binaries); j_bin; j_bin = json_getSibling(j_bin))
-                {
-                    ++num_bins;
-                    char const* const str_target = f_get_string_prop(j_bin, "target");
-                    char const* const str_entrypoint = f_get_string_prop(j_bin, "entrypoint");
-                    char const* const str_output = f_get_string_prop(j_bin, "output");
-                    if (!str_target || !str_entrypoint || !str_output)
-                    {
-                        DXCW_LOG_WARN("skipping binary #{} on entry #{} without required \"target\", \"entrypoint\", or \"output\" text properties",
-                                      num_bins, num_entries);
-                        continue;
-                    }
-
-                    // all good, compile the shader binary
-                    ++num_shaders;
-
-                    char const* additonalIncludes[] = {base_path_string.c_str()};
-
-                    bool const success = compile_shader(compiler, pathin_absolute.string().c_str(), str_target, str_entrypoint,
-                                                        (base_path_fs / str_output).string().c_str(), additonalIncludes, scratch_alloc);
-
-                    if (!success)
-                        ++num_errors;
-                }
-            }
-        }
-
-        json_t const* const jp_library = json_getProperty(j_entry, "library");
-        if (jp_library)
-        {
-            if (json_getType(jp_library) != JSON_OBJ)
-            {
-                DXCW_LOG_WARN("entry #{} property \"library\" is not an object", num_entries);
-            }
-            else
-            {
-                char const* const str_output = f_get_string_prop(jp_library, "output");
-                if (!str_output)
-                {
-                    DXCW_LOG_WARN("skipping library of entry #{} which lacks required \"output\" text property", num_entries);
-                    continue;
-                }
+            if (!success)
+                ++num_errors;
+        }
+        else
+        {
+            DXCW_LOG_WARN("failed to parse shaderlist line {}:", num_lines);
+            DXCW_LOG_WARN("\"{}\"", line.c_str());
+            ++num_errors;
+        }
+    }
 
-                json_t const* const jp_exports = json_getProperty(jp_library, "exports");
-                if (!jp_exports)
-                {
-                    DXCW_LOG_WARN(R"(skipping library of entry #{} which lacks required "exports" array property)", num_entries);
-                    continue;
-                }
+    if (out_results)
+        *out_results = {num_shaders, 0, num_errors};
 
-                if (jp_exports->type != JSON_ARRAY)
-                {
-                    DXCW_LOG_WARN(R"("exports" property in library of entry #{} is not an array)", num_entries);
-                    continue;
-                }
+    return true;
+}
 
-                // determine the total amount of exports
-                unsigned num_exports = 0;
-                for (json_t const* j_exp = json_getChild(jp_exports); j_exp; j_exp = json_getSibling(j_exp))
-                {
-                    if (j_exp->type != JSON_TEXT && j_exp->type != JSON_OBJ)
-                    {
-                        DXCW_LOG_WARN(R"(an export element in library of entry #{} is neither string nor object)", num_entries);
-                        continue;
-                    }
+bool dxcw::compile_shaderlist_json(dxcw::compiler& compiler,
+                                   const char* json_file,
+                                   dxcw::shaderlist_compilation_result* out_results,
+                                   cc::allocator* scratch_alloc,
+                                   const char* opt_archive_path,
+                                   const char* opt_embed_path)
+{
+    // set the working directory to the folder containing the list this was invoked with
+    std::error_code ec;
+    auto const base_path_fs = std::filesystem::canonical(std::filesystem::path(json_file).remove_filename(), ec);
+    if (ec)
+    {
+        DXCW_LOG_ERROR("failed to make path canonical for shaderlist json file at {}", json_file);
+        return false;
+    }
 
-                    ++num_exports;
-                }
+    auto const base_path_string = base_path_fs.string();
+    char const* additonalIncludes[] = {base_path_string.c_str()};
 
-                if (num_exports == 0)
-                {
-                    DXCW_LOG_WARN("skipping library of entry #{} which specifies no exports", num_entries);
-                    continue;
-                }
+    cc::alloc_vector<shaderlist_binary_entry_owning> binaries(scratch_alloc);
+    cc::alloc_vector<shaderlist_library_entry_owning> libraries(scratch_alloc);
 
-                // allocate and extract entries
-                auto export_array = cc::alloc_array<dxcw::library_export>::uninitialized(num_exports, scratch_alloc);
-                unsigned export_array_cursor = 0;
+    // parse the shaderlist
+    unsigned num_binaries = 0, num_libraries = 0, num_parse_errors = 0;
+    bool not_enough_space = false;
+    do
+    {
+        if (!parse_shaderlist_json(json_file, binaries, num_binaries, libraries, num_libraries, scratch_alloc, &num_parse_errors))
+            return false;
 
-                auto const f_add_export = [&](char const* internal_name, char const* exported_name)
-                {
-                    export_array[export_array_cursor] = library_export{internal_name, exported_name};
-                    ++export_array_cursor;
-                };
+        // the vectors might currently not have enough space for all entries
+        not_enough_space = (num_binaries > binaries.size()) || (num_libraries > libraries.size());
 
-                for (json_t const* j_exp = json_getChild(jp_exports); j_exp; j_exp = json_getSibling(j_exp))
-                {
-                    if (j_exp->type != JSON_TEXT && j_exp->type != JSON_OBJ)
-                    {
-                        continue;
-                    }
+        if (not_enough_space)
+        {
+            binaries.resize(num_binaries);
+            libraries.resize(num_libraries);
+        }
+    } while (not_enough_space);
 
-                    if (j_exp->type == JSON_TEXT)
-                    {
-                        f_add_export(j_exp->u.value, nullptr);
-                    }
-                    else if (j_exp->type == JSON_OBJ)
-                    {
-                        char const* str_internal = f_get_string_prop(j_exp, "internal");
-                        char const* str_export = f_get_string_prop(j_exp, "export");
+    // compile all binary permutations and libraries
+    shaderlist_compilation_result results = {};
+    archive_writer archive;
+    if (opt_archive_path && !archive.initialize(opt_archive_path, base_path_string.c_str()))
+        return false;
 
-                        if (!str_internal)
-                        {
-                            DXCW_LOG_WARN(R"(an export element in library of entry #{} does not specify the required "internal" property - name of the export in HLSL)",
-                                          num_entries);
-                            continue;
-                        }
+    embed_writer embed;
+    if (opt_embed_path)
+        embed.initialize(base_path_string.c_str());
 
-                        f_add_export(str_internal, str_export);
-                    }
-                }
+    // outputs in an archive or embedded source are recorded with that file as their path
+    auto const embed_source_path = opt_embed_path ? std::string(opt_embed_path) + ".cc" : std::string();
+    char const* const container_path = opt_archive_path ? opt_archive_path : (opt_embed_path ? embed_source_path.c_str() : nullptr);
 
-                // all good, compile the library
-                ++num_libraries;
+    manifest_writer manifest;
+    manifest.initialize(base_path_string.c_str(), additonalIncludes, container_path);
 
-                char const* additonalIncludes[] = {base_path_string.c_str()};
+    auto const report_path = get_diagnostics_report_path(json_file);
+    compile_entries_parallel(compiler, cc::span<shaderlist_binary_entry_owning const>(binaries.data(), num_binaries),
+                             cc::span<shaderlist_library_entry_owning const>(libraries.data(), num_libraries), additonalIncludes, &results, 0,
+                             report_path.str, archive.is_initialized() ? &archive : nullptr, embed.is_initialized() ? &embed : nullptr, &manifest);
 
-                bool const success = compile_library(compiler, pathin_absolute.string().c_str(), export_array,
-                                                     (base_path_fs / str_output).string().c_str(), additonalIncludes, scratch_alloc);
+    if (archive.is_initialized() && !archive.finalize())
+        ++results.num_errors;
 
-                if (!success)
-                    ++num_errors;
-            }
-        }
+    if (embed.is_initialized())
+    {
+        if (!embed.write(opt_embed_path))
+            ++results.num_errors;
+
+        embed.destroy();
     }
 
+    // a manifest must only list outputs that were written, the previous one is kept if any failed
+    if (results.num_errors > 0)
+        DXCW_LOG_WARN("shader manifest {} not written, the build has errors", get_manifest_path(json_file).str);
+    else if (!manifest.write(get_manifest_path(json_file).str))
+        ++results.num_errors;
+
+    manifest.destroy();
+
     if (out_results)
     {
-        *out_results = {num_shaders, num_libraries, num_errors};
+        *out_results = results;
+        out_results->num_errors += int(num_parse_errors);
     }
     return true;
-
-l_parse_error:
-    DXCW_LOG_ERROR("parse error in json shader list {}", json_file);
-    return false;
 }
 
 unsigned dxcw::parse_shaderlist(const char* shaderlist_file, dxcw::shaderlist_binary_entry_owning* out_entries, unsigned max_num_out)
@@ -599,6 +1931,13 @@ unsigned dxcw::parse_shaderlist(const char* shaderlist_file, dxcw::shaderlist_bi
                 DXCW_STRNCPY(write_entry.pathout_absolute, pathout_absolute.c_str(), sizeof(write_entry.pathout_absolute));
                 DXCW_STRNCPY(write_entry.target, target.c_str(), sizeof(write_entry.target));
                 DXCW_STRNCPY(write_entry.entrypoint, entrypoint.c_str(), sizeof(write_entry.entrypoint));
+                write_entry.num_defines = 0;
+                write_entry.sm = dxcw::shader_model::sm_use_default;
+                write_entry.build_debug = false;
+                write_entry.debug_info = dxcw::debug_info::embedded;
+                write_entry.strip = dxcw::strip_none;
+                write_entry.permutations.num_axes = 0;
+                write_entry.permutations.num_exclusions = 0;
             }
 
             ++num_shaders;
@@ -619,7 +1958,8 @@ bool dxcw::parse_shaderlist_json(const char* shaderlist_file,
                                  unsigned& out_num_binaries,
                                  cc::span<dxcw::shaderlist_library_entry_owning> out_libraries,
                                  unsigned& out_num_libraries,
-                                 cc::allocator* scratch_alloc)
+                                 cc::allocator* scratch_alloc,
+                                 unsigned* out_num_errors)
 {
     auto content = read_file(shaderlist_file, scratch_alloc);
     if (content.empty())
@@ -638,7 +1978,9 @@ bool dxcw::parse_shaderlist_json(const char* shaderlist_file,
     }
 
     auto const base_path_string = base_path_fs.string();
-    cc::alloc_array<json_t> json_nodes(512, scratch_alloc);
+    auto scratch_binary = cc::alloc_array<shaderlist_binary_entry_owning>::uninitialized(1, scratch_alloc);
+    // permutation axes and rules take up many nodes, scale the pool with the file size
+    cc::alloc_array<json_t> json_nodes(std::max<size_t>(512, content.size() / 2), scratch_alloc);
 
     json_t const* const j_root = json_create(content.data(), json_nodes.data(), unsigned(json_nodes.size()));
     if (j_root == nullptr || j_root->type != JSON_OBJ)
@@ -654,6 +1996,14 @@ bool dxcw::parse_shaderlist_json(const char* shaderlist_file,
     out_num_libraries = 0;
     int num_errors = 0;
 
+    // stripping of the whole shaderlist, refined by entries and binaries
+    auto shaderlist_strip = dxcw::strip_none;
+    if (!parse_strip_flags(j_root, shaderlist_strip))
+    {
+        DXCW_LOG_WARN("root property \"strip\" is not one of \"none\", \"debug\", \"reflection\" or \"all\", nothing is stripped");
+        ++num_errors;
+    }
+
     auto const f_get_string_prop = [](json_t const* node, char const* property_name) -> char const*
     {
         if (!node)
@@ -731,17 +2081,33 @@ bool dxcw::parse_shaderlist_json(const char* shaderlist_file,
                         continue;
                     }
 
-                    // all good, write the shader binary info
-                    if (out_num_binaries < out_binaries.size())
+                    // all good, write the shader binary info (or only validate it if there is no space left)
+                    auto& write_entry = (out_num_binaries < out_binaries.size()) ? out_binaries[out_num_binaries] : scratch_binary[0];
+                    auto const pathout_absolute = (base_path_fs / str_output).string();
+
+                    DXCW_STRNCPY(write_entry.pathin, str_source, sizeof(write_entry.pathin));
+                    DXCW_STRNCPY(write_entry.pathin_absolute, pathin_absolute.string().c_str(), sizeof(write_entry.pathin_absolute));
+                    DXCW_STRNCPY(write_entry.pathout_absolute, pathout_absolute.c_str(), sizeof(write_entry.pathout_absolute));
+                    DXCW_STRNCPY(write_entry.target, str_target, sizeof(write_entry.target));
+                    DXCW_STRNCPY(write_entry.entrypoint, str_entrypoint, sizeof(write_entry.entrypoint));
+
+                    // settings of the entry, refined by the binary
+                    if (!parse_binary_settings(j_entry, j_bin, shaderlist_strip, write_entry, num_entries, num_bins))
+                    {
+                        DXCW_LOG_WARN("skipping binary #{} on entry #{} with invalid \"defines\", \"shader_model\", \"debug\", \"debug_info\" or \"strip\" properties",
+                                      num_bins, num_entries);
+                        ++num_errors;
+                        continue;
+                    }
+
+                    write_entry.permutations.num_axes = 0;
+                    write_entry.permutations.num_exclusions = 0;
+                    json_t const* const jp_permutations = json_getProperty(j_bin, "permutations");
+                    if (jp_permutations && !parse_permutation_matrix(jp_permutations, write_entry.permutations, num_entries, num_bins))
                     {
-                        auto& write_entry = out_binaries[out_num_binaries];
-                        auto const pathout_absolute = (base_path_fs / str_output).string();
-
-                        DXCW_STRNCPY(write_entry.pathin, str_source, sizeof(write_entry.pathin));
-                        DXCW_STRNCPY(write_entry.pathin_absolute, pathin_absolute.string().c_str(), sizeof(write_entry.pathin_absolute));
-                        DXCW_STRNCPY(write_entry.pathout_absolute, pathout_absolute.c_str(), sizeof(write_entry.pathout_absolute));
-                        DXCW_STRNCPY(write_entry.target, str_target, sizeof(write_entry.target));
-                        DXCW_STRNCPY(write_entry.entrypoint, str_entrypoint, sizeof(write_entry.entrypoint));
+                        DXCW_LOG_WARN("skipping binary #{} on entry #{} with invalid permutations", num_bins, num_entries);
+                        ++num_errors;
+                        continue;
                     }
 
                     ++out_num_binaries;
@@ -799,6 +2165,16 @@ bool dxcw::parse_shaderlist_json(const char* shaderlist_file,
                     continue;
                 }
 
+                // stripping of the entry, refined by the library
+                auto library_strip = shaderlist_strip;
+                if (!parse_strip_flags(j_entry, library_strip) || !parse_strip_flags(jp_library, library_strip))
+                {
+                    DXCW_LOG_WARN("skipping library of entry #{} whose \"strip\" property is not one of \"none\", \"debug\", \"reflection\" or \"all\"",
+                                  num_entries);
+                    ++num_errors;
+                    continue;
+                }
+
 
                 if (num_exports > (sizeof(shaderlist_library_entry_owning::exports_internal_names) / sizeof(char const*)))
                 {
@@ -816,6 +2192,7 @@ bool dxcw::parse_shaderlist_json(const char* shaderlist_file,
                     DXCW_STRNCPY(write_entry.pathin_absolute, pathin_absolute.string().c_str(), sizeof(write_entry.pathin_absolute));
                     DXCW_STRNCPY(write_entry.pathout_absolute, pathout_absolute.c_str(), sizeof(write_entry.pathout_absolute));
                     write_entry.num_exports = uint8_t(num_exports);
+                    write_entry.strip = library_strip;
 
                     unsigned exports_cursor = 0;
                     unsigned exports_strbuf_cursor = 0;
@@ -884,6 +2261,9 @@ bool dxcw::parse_shaderlist_json(const char* shaderlist_file,
         }
     }
 
+    if (out_num_errors)
+        *out_num_errors = unsigned(num_errors);
+
     return true;
 
 l_parse_error:
@@ -891,6 +2271,364 @@ l_parse_error:
     return false;
 }
 
+unsigned dxcw::get_num_permutations(const dxcw::shaderlist_binary_entry_owning& entry)
+{
+    uint64_t res = 1;
+    for (auto i = 0u; i < entry.permutations.num_axes; ++i)
+    {
+        res *= entry.permutations.axis_num_values[i];
+    }
+
+    CC_ASSERT(res <= shaderlist_permutation_matrix::max_num_permutations && "permutation matrix exceeds max_num_permutations");
+    return unsigned(res);
+}
+
+bool dxcw::get_permutation(const dxcw::shaderlist_binary_entry_owning& entry, unsigned index, dxcw::shaderlist_permutation* out_permutation)
+{
+    CC_CONTRACT(out_permutation);
+    auto const& matrix = entry.permutations;
+    auto& perm = *out_permutation;
+
+    perm.num_defines = matrix.num_axes;
+    decode_permutation_index(matrix, index, perm.value_indices);
+
+    // write defines ("AXIS=value") and the output path ("<output>__AXIS_value")
+    unsigned define_cursor = 0;
+    unsigned path_cursor = unsigned(std::strlen(entry.pathout_absolute));
+    CC_ASSERT(path_cursor < sizeof(perm.pathout_absolute) && "output path too long");
+    std::memcpy(perm.pathout_absolute, entry.pathout_absolute, path_cursor + 1);
+
+    for (auto axis = 0u; axis < matrix.num_axes; ++axis)
+    {
+        char const* const name = matrix.get_axis_name(axis);
+        char const* const value = matrix.get_axis_value(axis, perm.value_indices[axis]);
+
+        int const num_define_chars
+            = std::snprintf(perm.define_buffer + define_cursor, sizeof(perm.define_buffer) - define_cursor, "%s=%s", name, value);
+        CC_ASSERT(num_define_chars > 0 && define_cursor + num_define_chars < sizeof(perm.define_buffer) && "permutation defines too long");
+        perm.defines[axis] = perm.define_buffer + define_cursor;
+        define_cursor += unsigned(num_define_chars) + 1;
+
+        int const num_path_chars
+            = std::snprintf(perm.pathout_absolute + path_cursor, sizeof(perm.pathout_absolute) - path_cursor, "__%s_%s", name, value);
+        CC_ASSERT(num_path_chars > 0 && path_cursor + num_path_chars < sizeof(perm.pathout_absolute) && "permutation output path too long");
+        path_cursor += unsigned(num_path_chars);
+    }
+
+    return !is_permutation_excluded(matrix, perm.value_indices);
+}
+
+uint32_t dxcw::get_referenced_permutation_axes(const dxcw::shaderlist_binary_entry_owning& entry, cc::span<char const* const> include_paths)
+{
+    auto const& matrix = entry.permutations;
+    uint32_t const all_axes = (1u << matrix.num_axes) - 1;
+
+    if (matrix.num_axes == 0)
+        return 0;
+
+    source_scan scan;
+    std::unordered_set<std::string> identifiers;
+    if (!scan_source(entry.pathin_absolute, include_paths, scan) || !get_entrypoint_identifiers(scan, entry, identifiers))
+        return all_axes;
+
+    return get_referenced_axes_from_identifiers(entry, identifiers);
+}
+
+unsigned dxcw::get_canonical_permutation(const dxcw::shaderlist_binary_entry_owning& entry, unsigned index, uint32_t referenced_axes)
+{
+    unsigned res = index;
+    for_each_equivalent_permutation(entry.permutations, index, referenced_axes,
+                                    [&](unsigned equivalent_index)
+                                    {
+                                        res = equivalent_index;
+                                        return false;
+                                    });
+    return res;
+}
+
+bool dxcw::compile_entries_parallel(dxcw::compiler& compiler,
+                                    cc::span<const dxcw::shaderlist_binary_entry_owning> binaries,
+                                    cc::span<const dxcw::shaderlist_library_entry_owning> libraries,
+                                    cc::span<char const* const> opt_additional_include_paths,
+                                    dxcw::shaderlist_compilation_result* out_results,
+                                    unsigned num_threads,
+                                    char const* opt_diagnostics_report_path,
+                                    dxcw::archive_writer* opt_archive,
+                                    dxcw::embed_writer* opt_embed,
+                                    dxcw::manifest_writer* opt_manifest)
+{
+    // binaries without permutations that share source, defines and debug flag are compiled as one group job
+    // binaries with permutations get one job per permutation index, libraries follow after all binary jobs
+    std::vector<std::vector<dxcw::shaderlist_binary_entry_owning const*>> binary_groups;
+    std::vector<unsigned> permuted_binaries;
+    {
+        std::unordered_map<std::string, size_t> group_indices;
+        std::string key;
+        for (auto i = 0u; i < binaries.size(); ++i)
+        {
+            auto const& binary = binaries[i];
+            if (binary.permutations.num_axes > 0)
+            {
+                permuted_binaries.push_back(i);
+                continue;
+            }
+
+            key = binary.pathin_absolute;
+            key += binary.build_debug ? "\n1" : "\n0";
+            key += char('0' + int(binary.debug_info));
+            for (auto d = 0u; d < binary.num_defines; ++d)
+            {
+                key += '\n';
+                key += binary.get_define(d);
+            }
+
+            auto const [it, is_new] = group_indices.try_emplace(key, binary_groups.size());
+            if (is_new)
+                binary_groups.emplace_back();
+
+            binary_groups[it->second].push_back(&binary);
+        }
+    }
+
+    // job index ranges per permuted binary, permuted_binaries[i] owns jobs [job_offsets[i], job_offsets[i + 1]) after the group jobs
+    // the sum is computed in 64 bit, binaries that would exceed the maximum amount of jobs are skipped
+    int num_rejected_binaries = 0;
+    std::vector<unsigned> job_offsets(1, 0);
+    {
+        uint64_t const num_fixed_jobs = binary_groups.size() + libraries.size();
+        size_t num_accepted = 0;
+        for (auto const binary_index : permuted_binaries)
+        {
+            uint64_t const next_offset = uint64_t(job_offsets.back()) + get_num_permutations(binaries[binary_index]);
+            if (num_fixed_jobs + next_offset > sc_max_num_jobs)
+            {
+                DXCW_LOG_WARN("skipping permutations of {} ({}; {}), the shaderlist exceeds the maximum of {} compilation jobs",
+                              binaries[binary_index].pathin, binaries[binary_index].target, binaries[binary_index].entrypoint, sc_max_num_jobs);
+                ++num_rejected_binaries;
+                continue;
+            }
+
+            permuted_binaries[num_accepted++] = binary_index;
+            job_offsets.push_back(unsigned(next_offset));
+        }
+
+        permuted_binaries.resize(num_accepted);
+    }
+
+    // permutations that only differ in axes never referenced by the code reachable from their entrypoint share a single compilation
+    // sources are scanned once each, the reachable identifiers are resolved once per source, entrypoint and fixed defines
+    std::vector<uint32_t> referenced_axes(binaries.size(), 0);
+    {
+        struct cached_scan
+        {
+            bool is_reliable = false;
+            source_scan scan;
+        };
+
+        struct cached_identifiers
+        {
+            bool is_reliable = false;
+            std::unordered_set<std::string> identifiers;
+        };
+
+        std::unordered_map<std::string, cached_scan> scans_by_source;
+        std::unordered_map<std::string, cached_identifiers> identifiers_by_entrypoint;
+        std::string key;
+        for (auto i = 0u; i < binaries.size(); ++i)
+        {
+            auto const& binary = binaries[i];
+            if (binary.permutations.num_axes == 0)
+                continue;
+
+            auto const [scan_it, is_new_scan] = scans_by_source.try_emplace(binary.pathin_absolute);
+            if (is_new_scan)
+                scan_it->second.is_reliable = scan_source(binary.pathin_absolute, opt_additional_include_paths, scan_it->second.scan);
+
+            key = binary.pathin_absolute;
+            key += '\n';
+            key += binary.entrypoint;
+            for (auto d = 0u; d < binary.num_defines; ++d)
+            {
+                key += '\n';
+                key += binary.get_define(d);
+            }
+
+            auto const [it, is_new] = identifiers_by_entrypoint.try_emplace(key);
+            if (is_new)
+            {
+                auto& cached = it->second;
+                cached.is_reliable = scan_it->second.is_reliable && get_entrypoint_identifiers(scan_it->second.scan, binary, cached.identifiers);
+            }
+
+            referenced_axes[i] = it->second.is_reliable ? get_referenced_axes_from_identifiers(binary, it->second.identifiers)
+                                                        : (1u << binary.permutations.num_axes) - 1;
+        }
+    }
+
+    unsigned const num_group_jobs = unsigned(binary_groups.size());
+    unsigned const num_binary_jobs = num_group_jobs + job_offsets.back();
+    unsigned const num_jobs = num_binary_jobs + unsigned(libraries.size());
+
+    if (num_threads == 0)
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+
+    // with fewer jobs than threads, groups can additionally compile their entrypoints in parallel
+    unsigned const num_threads_per_group = std::max(1u, num_threads / std::max(1u, num_jobs));
+    num_threads = std::min(num_threads, std::max(1u, num_jobs));
+
+    unsigned const num_skipped_writes_before = g_num_skipped_writes.load();
+
+    // files are written on separate threads, compiling threads only queue them
+    // sources are mapped once and shared by all jobs and threads
+    dxcw::detail::source_cache sources;
+    sources.initialize();
+
+    dxcw::output_writer writer;
+    job_context ctx;
+    ctx.sources = &sources;
+    ctx.archive = opt_archive;
+    ctx.embed = opt_embed;
+    ctx.manifest = opt_manifest;
+    if (!opt_archive && !opt_embed)
+    {
+        writer.initialize();
+        ctx.writer = &writer;
+
+        // create all output directories in one pass, writes then only open, write and close
+        // permutation outputs share the directory of their binary
+        for (auto const& binary : binaries)
+            ensure_parent_directory(binary.pathout_absolute);
+
+        for (auto const& library : libraries)
+            ensure_parent_directory(library.pathout_absolute);
+    }
+
+    std::atomic<unsigned> next_job = {0};
+    std::atomic<int> num_shaders = {0};
+    std::atomic<int> num_errors = {num_rejected_binaries};
+    std::atomic<int> num_aliased = {0};
+
+    auto const f_work = [&](dxcw::compiler& thread_compiler)
+    {
+        for (unsigned job = next_job.fetch_add(1); job < num_jobs; job = next_job.fetch_add(1))
+        {
+            if (job < num_group_jobs)
+            {
+                auto const& group = binary_groups[job];
+                num_shaders += int(group.size());
+                num_errors += int(compile_binary_group(thread_compiler, cc::span<dxcw::shaderlist_binary_entry_owning const* const>(group.data(), group.size()),
+                                                       opt_additional_include_paths, num_threads_per_group, ctx));
+            }
+            else if (job < num_binary_jobs)
+            {
+                unsigned const permutation_job = job - num_group_jobs;
+                auto const offset_index = unsigned(std::upper_bound(job_offsets.begin(), job_offsets.end(), permutation_job) - job_offsets.begin()) - 1;
+                unsigned const binary_index = permuted_binaries[offset_index];
+                auto const res = compile_binary_permutation(thread_compiler, binaries[binary_index], permutation_job - job_offsets[offset_index],
+                                                            referenced_axes[binary_index], opt_additional_include_paths, ctx);
+
+                if (res != permutation_result::excluded)
+                    ++num_shaders;
+                if (res == permutation_result::aliased)
+                    ++num_aliased;
+                if (res == permutation_result::failed)
+                    ++num_errors;
+            }
+            else
+            {
+                if (!compile_library_entry_to_files(thread_compiler, libraries[job - num_binary_jobs], opt_additional_include_paths, ctx, cc::system_allocator))
+                    ++num_errors;
+            }
+        }
+    };
+
+    // diagnostics of all compilations are collected and logged once after all jobs are done
+    diagnostic_collector diagnostics;
+
+    std::vector<std::thread> threads;
+    threads.reserve(num_threads - 1);
+    for (auto i = 1u; i < num_threads; ++i)
+    {
+        threads.emplace_back(
+            [&]
+            {
+                dxcw::compiler thread_compiler;
+                thread_compiler.initialize();
+                thread_compiler._diagnostic_callback = &diagnostic_collector::callback;
+                thread_compiler._diagnostic_userdata = &diagnostics;
+                f_work(thread_compiler);
+                thread_compiler.destroy();
+            });
+    }
+
+    auto const prev_diagnostic_callback = compiler._diagnostic_callback;
+    auto const prev_diagnostic_userdata = compiler._diagnostic_userdata;
+    compiler._diagnostic_callback = &diagnostic_collector::callback;
+    compiler._diagnostic_userdata = &diagnostics;
+
+    f_work(compiler);
+
+    compiler._diagnostic_callback = prev_diagnostic_callback;
+    compiler._diagnostic_userdata = prev_diagnostic_userdata;
+
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    diagnostics.log_summary();
+    if (opt_diagnostics_report_path)
+    {
+        diagnostics.write_report(opt_diagnostics_report_path);
+    }
+
+    if (num_aliased.load() > 0)
+    {
+        DXCW_LOG("{} permutations only differ in unreferenced defines and were written as aliases", num_aliased.load());
+    }
+
+    if (writer.is_initialized())
+    {
+        // writes still queued can fail, they are only counted once the writer is drained
+        writer.flush();
+        num_errors += int(writer.get_num_failed_writes());
+        writer.destroy();
+    }
+
+    sources.destroy();
+
+    int const num_skipped_writes = int(g_num_skipped_writes.load() - num_skipped_writes_before);
+    if (num_skipped_writes > 0)
+    {
+        DXCW_LOG("{} outputs were unchanged and not rewritten", num_skipped_writes);
+    }
+
+    if (out_results)
+    {
+        *out_results = {num_shaders.load(), int(libraries.size()), num_errors.load(), num_skipped_writes};
+    }
+
+    return num_errors.load() == 0;
+}
+
+
+dxcw::fixed_string dxcw::get_diagnostics_report_path(const char* shaderlist_file)
+{
+    auto const path = std::filesystem::path(shaderlist_file).replace_extension(".diagnostics.txt").string();
+
+    fixed_string res;
+    std::snprintf(res.str, sizeof(res.str), "%s", path.c_str());
+    return res;
+}
+
+dxcw::fixed_string dxcw::get_manifest_path(const char* shaderlist_file)
+{
+    auto const path = std::filesystem::path(shaderlist_file).replace_extension(".manifest").string();
+
+    fixed_string res;
+    std::snprintf(res.str, sizeof(res.str), "%s", path.c_str());
+    return res;
+}
 
 cc::alloc_vector<dxcw::fixed_string> dxcw::parse_includes(const char* source_path, cc::span<char const* const> include_paths, cc::allocator* alloc)
 {
@@ -1032,6 +2770,32 @@ cc::alloc_vector<dxcw::fixed_string> dxcw::parse_includes(const char* source_pat
     return res_includes;
 }
 
+bool dxcw::parse_shader_model(const char* str, dxcw::shader_model& out_sm)
+{
+    if (!str)
+    {
+        return false;
+    }
+
+    // accepts "6_6", "6.6" and "sm_6_6"
+    if (std::strncmp(str, "sm_", 3) == 0)
+        str += 3;
+
+    if (str[0] != '6' || (str[1] != '_' && str[1] != '.') || str[2] < '0' || str[2] > '9' || str[3] != '\0')
+    {
+        return false;
+    }
+
+    auto const minor = str[2] - '0';
+    if (minor > int(dxcw::shader_model::sm_6_8))
+    {
+        return false;
+    }
+
+    out_sm = dxcw::shader_model(minor);
+    return true;
+}
+
 bool dxcw::parse_target(const char* str, dxcw::target& out_tgt)
 {
     if (!str)
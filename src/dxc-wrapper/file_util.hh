@@ -12,17 +12,26 @@ namespace dxcw
 struct shaderlist_compilation_result;
 struct shaderlist_binary_entry_owning;
 struct shaderlist_library_entry_owning;
+struct shaderlist_permutation;
 struct include_entry;
 struct fixed_string;
 
 /// Parses the target from a string, ie "vs" -> dxcw::target::vertex
 DXCW_API bool parse_target(char const* str, dxcw::target& out_tgt);
 
+/// Parses a shader model from a string, ie "6_6" or "6.6" -> dxcw::shader_model::sm_6_6
+DXCW_API bool parse_shader_model(char const* str, dxcw::shader_model& out_sm);
+
 /// Writes a compiled binary to disk, creates folders if nonexisting
+/// the binary is written to a temporary file that replaces the output, readers never see partially written files
+/// if the output already has identical content, it is not written at all and keeps its modification time
 DXCW_API bool write_binary_to_file(dxcw::binary const& binary, char const* path, char const* ending);
 
 DXCW_API bool write_binary_to_file(dxcw::binary const& binary, char const* path);
 
+/// amount of writes skipped by write_binary_to_file because the output already had identical content, since process start
+DXCW_API unsigned get_num_skipped_writes();
+
 /// compile a shader and directly write both target versions to file, returns true on success
 /// output_path without file ending
 ///
@@ -34,7 +43,8 @@ DXCW_API bool compile_shader(dxcw::compiler& compiler,
                              char const* entrypoint,
                              char const* output_path,
                              cc::span<char const* const> opt_additional_include_paths = {},
-                             cc::allocator* scratch_alloc = cc::system_allocator);
+                             cc::allocator* scratch_alloc = cc::system_allocator,
+                             cc::span<char const* const> opt_defines = {});
 
 DXCW_API bool compile_library(dxcw::compiler& compiler,
                               char const* source_path,
@@ -43,6 +53,7 @@ DXCW_API bool compile_library(dxcw::compiler& compiler,
                               cc::span<char const* const> opt_additional_include_paths = {},
                               cc::allocator* scratch_alloc = cc::system_allocator);
 
+/// compiles all permutations of a binary entry, returns true if all of them succeeded
 DXCW_API bool compile_binary_entry(compiler& compiler,
                                    dxcw::shaderlist_binary_entry_owning const& entry,
                                    cc::span<char const* const> opt_additional_include_paths,
@@ -77,16 +88,59 @@ DXCW_API bool compile_shaderlist(dxcw::compiler& compiler,
 /// out_num_errors optionally receives amount of non-fatal parse and compile errors
 ///
 /// shaderlist file: JSON array of objects
+/// "defines" (array of strings), "shader_model" (ie. "6_6"), "debug" (bool) and "debug_info" are optional on entries and binaries,
+/// binaries append to the defines of their entry and override its shader model and debug settings
+/// "debug_info" is one of "embedded" (default), "pdb" or "pdb_slim", external PDBs are written next to the outputs (see dxcw::debug_info)
+/// "strip" is one of "none" (default), "debug", "reflection" or "all", optional on the root, entries, binaries and libraries
+/// the most specific "strip" applies, stripping happens after compilation and logs the size of each output before and after (see dxcw::strip_flags)
+///
+/// if opt_archive_path is set, all binaries are written into a single packed archive at this path instead (see archive.hh)
+/// names in the archive are the output paths relative to the folder of the shaderlist
+/// if opt_embed_path is set, all binaries are written as C++ source to <opt_embed_path>.hh and .cc instead (see embed.hh)
+/// a manifest of all written binaries is written to get_manifest_path(json_file) (see manifest.hh)
 DXCW_API bool compile_shaderlist_json(dxcw::compiler& compiler,
                                       char const* json_file,
                                       shaderlist_compilation_result* out_results = nullptr,
-                                      cc::allocator* scratch_alloc = cc::system_allocator);
+                                      cc::allocator* scratch_alloc = cc::system_allocator,
+                                      char const* opt_archive_path = nullptr,
+                                      char const* opt_embed_path = nullptr);
+
+/// compile all binaries (including all of their permutations) and libraries on multiple threads
+///
+/// the calling thread uses the given compiler, each additional thread initializes its own
+/// jobs are resolved lazily from the entries, permutations are never expanded up front
+/// binaries without permutations sharing a source, defines and debug flag are compiled together (see compiler::compile_shader_multi)
+/// identical diagnostics of multiple compilations (ie. an error in a shared header) are logged once, listing the affected compilations
+/// returns true if all compilations succeeded
+/// num_threads: 0 - use the hardware concurrency
+/// opt_diagnostics_report_path: file receiving the full diagnostics of each compilation, removed if there are none (optional)
+/// opt_archive: if set, binaries are written into this archive instead of separate files (optional, the caller finalizes it)
+/// opt_embed: if set, binaries are added to this embed writer instead of separate files (optional, the caller writes it)
+/// opt_manifest: if set, all written binaries are recorded in this manifest writer (optional, the caller writes it)
+DXCW_API bool compile_entries_parallel(dxcw::compiler& compiler,
+                                       cc::span<shaderlist_binary_entry_owning const> binaries,
+                                       cc::span<shaderlist_library_entry_owning const> libraries,
+                                       cc::span<char const* const> opt_additional_include_paths,
+                                       shaderlist_compilation_result* out_results = nullptr,
+                                       unsigned num_threads = 0,
+                                       char const* opt_diagnostics_report_path = nullptr,
+                                       archive_writer* opt_archive = nullptr,
+                                       embed_writer* opt_embed = nullptr,
+                                       manifest_writer* opt_manifest = nullptr);
+
+/// path of the diagnostics report written when compiling a shaderlist, the shaderlist path with the extension ".diagnostics.txt"
+DXCW_API fixed_string get_diagnostics_report_path(char const* shaderlist_file);
+
+/// path of the manifest written when compiling a shaderlist, without file ending, the shaderlist path with the extension ".manifest"
+/// the manifest itself is written to <path>.json and <path>.bin (see manifest_writer)
+DXCW_API fixed_string get_manifest_path(char const* shaderlist_file);
 
 struct shaderlist_compilation_result
 {
     int num_shaders_detected;
     int num_libraries_detected;
     int num_errors;
+    int num_skipped_writes = 0; // outputs that already had identical content and were not rewritten
 };
 
 /// parse a shaderlist and write its entries to an array, no I/O writes
@@ -100,13 +154,69 @@ DXCW_API bool parse_shaderlist_json(char const* shaderlist_file,
                                     unsigned& out_num_binaries,
                                     cc::span<shaderlist_library_entry_owning> out_libraries,
                                     unsigned& out_num_libraries,
-                                    cc::allocator* scratch_alloc = cc::system_allocator);
+                                    cc::allocator* scratch_alloc = cc::system_allocator,
+                                    unsigned* out_num_errors = nullptr);
+
+
+/// returns the amount of permutation indices of a binary entry (product of all axis sizes, 1 if it has no permutations)
+/// at most shaderlist_permutation_matrix::max_num_permutations for parsed entries
+/// some of these indices can be excluded by rules, see get_permutation
+DXCW_API unsigned get_num_permutations(shaderlist_binary_entry_owning const& entry);
+
+/// resolves a permutation index of a binary entry to its defines and unique output path
+/// returns false if the permutation is excluded by a rule (out_permutation is still written)
+DXCW_API bool get_permutation(shaderlist_binary_entry_owning const& entry, unsigned index, shaderlist_permutation* out_permutation);
+
+
+/// returns a bitmask of the permutation axes of a binary entry whose names occur in the code reachable from its entrypoint (bit i - axis i)
+/// reachable code is all global code and preprocessor directives of the source and its includes, and the functions called from there or
+/// from the entrypoint (textually, every identifier naming a function counts as a call)
+/// all axes are considered referenced if this can't be determined reliably (ie. includes that can't be resolved, token pasting,
+/// unbalanced braces or an entrypoint whose definition is produced by a macro)
+/// permutations that only differ in unreferenced axes compile to identical binaries
+DXCW_API uint32_t get_referenced_permutation_axes(shaderlist_binary_entry_owning const& entry, cc::span<char const* const> include_paths);
+
+/// returns the lowest non-excluded permutation index which only differs from the given one in axes not contained in referenced_axes
+/// permutations with the same canonical index are compiled once, the canonical one writes the outputs for all of them
+DXCW_API unsigned get_canonical_permutation(shaderlist_binary_entry_owning const& entry, unsigned index, uint32_t referenced_axes);
 
 
 /// recursively parses all #include directories, resolves them to absolute paths, and returns a unique list
 DXCW_API cc::alloc_vector<fixed_string> parse_includes(char const* source_path, cc::span<char const* const> include_paths, cc::allocator* allocator = cc::system_allocator);
 
 
+/// named define axes and exclusion rules of a binary entry, ie.
+///
+/// "permutations": {
+///     "axes": { "WITH_IBL": [false, true], "QUALITY": ["LOW", "HIGH"] },
+///     "exclude": [ { "WITH_IBL": false, "QUALITY": "HIGH" } ]
+/// }
+///
+/// the cartesian product is never stored, a permutation is decoded from its index (mixed radix, first axis fastest)
+struct shaderlist_permutation_matrix
+{
+    static constexpr unsigned max_num_axes = 16;
+    static constexpr unsigned max_num_values = 16;
+    static constexpr unsigned max_num_exclusions = 32;
+    static constexpr unsigned max_num_permutations = 1u << 20; // product of all axis sizes, larger matrices are rejected when parsing
+    static constexpr uint8_t any_value = 0xFF;
+
+    // axis names and value texts, null-terminated, referenced by offset
+    char string_buffer[2048];
+    uint16_t axis_name_offsets[max_num_axes];
+    uint16_t axis_value_offsets[max_num_axes][max_num_values];
+    uint8_t axis_num_values[max_num_axes];
+    uint8_t num_axes = 0;
+
+    // per rule and axis the value index the rule matches, or any_value
+    // a permutation is excluded if it matches all axes of any rule
+    uint8_t exclusions[max_num_exclusions][max_num_axes];
+    uint8_t num_exclusions = 0;
+
+    char const* get_axis_name(unsigned axis) const { return string_buffer + axis_name_offsets[axis]; }
+    char const* get_axis_value(unsigned axis, unsigned value) const { return string_buffer + axis_value_offsets[axis][value]; }
+};
+
 struct shaderlist_binary_entry_owning
 {
     char pathin[1024];
@@ -114,6 +224,30 @@ struct shaderlist_binary_entry_owning
     char pathout_absolute[1024];
     char target[4];
     char entrypoint[64];
+
+    // fixed defines of the entry and the binary ("NAME=value" or "NAME"), null-terminated, referenced by offset
+    char define_buffer[1024];
+    uint16_t define_offsets[32];
+    uint8_t num_defines;
+
+    dxcw::shader_model sm;
+    bool build_debug;
+    dxcw::debug_info debug_info;
+    dxcw::strip_flags strip; // applied after compilation, see compiler::strip_binary
+
+    shaderlist_permutation_matrix permutations;
+
+    char const* get_define(unsigned i) const { return define_buffer + define_offsets[i]; }
+};
+
+/// a single resolved permutation of a binary entry
+struct shaderlist_permutation
+{
+    char pathout_absolute[1024];     // output path of the entry with a suffix per axis, ie. "bin/mat_ps__WITH_IBL_1__QUALITY_HIGH"
+    char define_buffer[2048];        // "AXIS=value" strings
+    char const* defines[shaderlist_permutation_matrix::max_num_axes]; // point into define_buffer
+    uint8_t value_indices[shaderlist_permutation_matrix::max_num_axes];
+    uint8_t num_defines;
 };
 
 struct shaderlist_library_entry_owning
@@ -125,6 +259,7 @@ struct shaderlist_library_entry_owning
     char const* exports_internal_names[32]; // point into entrypoint_buffer
     char const* exports_exported_names[32]; // point into entrypoint_buffer or nullptr
     uint8_t num_exports;
+    dxcw::strip_flags strip; // applied after compilation, see compiler::strip_binary
 };
 
 struct fixed_string
@@ -5,9 +5,18 @@
 namespace dxcw
 {
 struct binary;
+struct external_pdb;
 struct library_export;
 struct compiler;
+struct archive_writer;
+struct embed_writer;
+struct manifest_writer;
+struct output_writer;
+struct shader_reflection;
 
 enum class target : uint8_t;
 enum class output : uint8_t;
+enum class shader_model;
+enum class debug_info : uint8_t;
+enum strip_flags : uint8_t;
 }
@@ -0,0 +1,322 @@
+#include "manifest.hh"
+
+#include <cstdio>
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <clean-core/alloc_vector.hh>
+#include <clean-core/assert.hh>
+
+#include <dxc-wrapper/archive.hh>
+#include <dxc-wrapper/common/crc32c.hh>
+#include <dxc-wrapper/common/entry_name.hh>
+#include <dxc-wrapper/common/log.hh>
+#include <dxc-wrapper/common/mapped_file.hh>
+#include <dxc-wrapper/compiler.hh>
+#include <dxc-wrapper/file_util.hh>
+
+namespace
+{
+struct manifest_entry
+{
+    std::string name;
+    std::string path;
+    std::string entrypoint;
+    dxcw::target target;
+    dxcw::output output;
+    uint16_t flags;
+    uint64_t size;
+    uint64_t content_hash;
+    uint64_t source_hash;
+    uint32_t checksum;
+};
+
+// source hash, computed by the first output of the source while others wait for it
+struct source_hash_slot
+{
+    std::once_flag once;
+    uint64_t hash = 0;
+};
+
+// hash of the contents of a file, 0 if it can't be read
+uint64_t hash_file(char const* path)
+{
+    dxcw::detail::mapped_file file;
+    if (!file.map(path))
+        return 0;
+
+    auto const hash = dxcw::hash_archive_content(file.data, file.size);
+    file.unmap();
+    return hash;
+}
+
+// hash of a source file and all files it includes, in include order
+uint64_t hash_source_dependencies(char const* source_path, cc::span<char const* const> include_paths)
+{
+    uint64_t hash = hash_file(source_path);
+
+    auto const includes = dxcw::parse_includes(source_path, include_paths);
+    for (auto const& include : includes)
+        hash = (hash ^ hash_file(include.str)) * 0x100000001b3ull;
+
+    return hash;
+}
+
+// appends text as the content of a JSON string
+void append_escaped(std::string& out, std::string const& text)
+{
+    for (char const c : text)
+    {
+        if (c == '"' || c == '\\')
+        {
+            out.push_back('\\');
+            out.push_back(c);
+        }
+        else if (uint8_t(c) < 0x20)
+        {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", unsigned(uint8_t(c)));
+            out.append(escaped);
+        }
+        else
+        {
+            out.push_back(c);
+        }
+    }
+}
+
+void append_hash(std::string& out, uint64_t hash)
+{
+    char text[24];
+    std::snprintf(text, sizeof(text), "\"0x%016llx\"", static_cast<unsigned long long>(hash));
+    out.append(text);
+}
+
+void append_checksum(std::string& out, uint32_t checksum)
+{
+    char text[16];
+    std::snprintf(text, sizeof(text), "\"0x%08x\"", unsigned(checksum));
+    out.append(text);
+}
+
+bool write_manifest_file(std::string const& content, std::string const& path)
+{
+    dxcw::binary file_content;
+    file_content.data = reinterpret_cast<std::byte const*>(content.data());
+    file_content.size = content.size();
+
+    if (!dxcw::write_binary_to_file(file_content, path.c_str()))
+    {
+        DXCW_LOG_ERROR("failed to write shader manifest to {}", path);
+        return false;
+    }
+
+    return true;
+}
+}
+
+struct dxcw::detail::manifest_writer_state
+{
+    std::mutex mutex;
+    std::string base_path;
+    std::string container_path; // relative to base_path, empty if outputs are separate files
+    std::vector<std::string> include_paths;
+    std::vector<char const*> include_path_ptrs; // point into include_paths
+
+    std::vector<manifest_entry> entries;
+    // entry index per name and output, to replace entries that are added twice
+    std::unordered_map<std::string, size_t> entry_indices;
+    // source hash per source path, sources are shared by many outputs
+    std::unordered_map<std::string, std::unique_ptr<source_hash_slot>> source_hashes;
+};
+
+void dxcw::manifest_writer::initialize(char const* base_path, cc::span<char const* const> include_paths, char const* opt_container_path)
+{
+    CC_ASSERT(_state == nullptr && "double initialize");
+
+    _state = new detail::manifest_writer_state();
+    _state->base_path = base_path ? base_path : "";
+    std::replace(_state->base_path.begin(), _state->base_path.end(), '\\', '/');
+
+    if (opt_container_path)
+        _state->container_path = detail::get_entry_name(_state->base_path, opt_container_path);
+
+    _state->include_paths.assign(include_paths.begin(), include_paths.end());
+    for (auto const& include_path : _state->include_paths)
+        _state->include_path_ptrs.push_back(include_path.c_str());
+}
+
+void dxcw::manifest_writer::add(char const* output_path,
+                                char const* ending,
+                                char const* source_path,
+                                char const* entrypoint,
+                                dxcw::target target,
+                                dxcw::output output,
+                                cc::span<std::byte const> data,
+                                uint16_t flags)
+{
+    CC_CONTRACT(output_path);
+    CC_CONTRACT(ending);
+    CC_CONTRACT(source_path);
+    CC_ASSERT(_state != nullptr && "Uninitialized dxcw::manifest_writer");
+
+    manifest_entry entry;
+    entry.name = detail::get_entry_name(_state->base_path, output_path);
+    entry.path = _state->container_path.empty() ? entry.name + '.' + ending : _state->container_path;
+    entry.entrypoint = entrypoint ? entrypoint : "";
+    entry.target = target;
+    entry.output = output;
+    entry.flags = uint16_t(flags & ~archive_entry::codec_flags);
+    entry.size = data.size();
+    entry.content_hash = hash_archive_content(data.data(), data.size());
+    entry.checksum = detail::crc32c(data.data(), data.size());
+
+    auto key = entry.name;
+    key.push_back('\0');
+    key.push_back(char(output));
+
+    auto& state = *_state;
+
+    // the slot is looked up under the lock, but hashed outside of it so outputs of other sources are not blocked by the file reads
+    source_hash_slot* slot = nullptr;
+    {
+        std::lock_guard lg(state.mutex);
+        auto& source_slot = state.source_hashes[source_path];
+        if (!source_slot)
+            source_slot = std::make_unique<source_hash_slot>();
+        slot = source_slot.get();
+    }
+
+    std::call_once(slot->once,
+                   [&]
+                   {
+                       auto const include_paths = cc::span<char const* const>(state.include_path_ptrs.data(), state.include_path_ptrs.size());
+                       slot->hash = hash_source_dependencies(source_path, include_paths);
+                   });
+
+    entry.source_hash = slot->hash;
+
+    std::lock_guard lg(state.mutex);
+    auto const [it, is_new] = state.entry_indices.try_emplace(std::move(key), state.entries.size());
+    if (is_new)
+        state.entries.push_back(std::move(entry));
+    else
+        state.entries[it->second] = std::move(entry);
+}
+
+bool dxcw::manifest_writer::write(char const* path) const
+{
+    CC_CONTRACT(path);
+    CC_ASSERT(_state != nullptr && "Uninitialized dxcw::manifest_writer");
+    auto const& state = *_state;
+
+    // sorted like the archive index, so readers of the binary form can use the same lookup
+    std::vector<manifest_entry const*> entries;
+    entries.reserve(state.entries.size());
+    for (auto const& entry : state.entries)
+        entries.push_back(&entry);
+
+    std::vector<uint64_t> name_hashes(state.entries.size());
+    for (size_t i = 0; i < state.entries.size(); ++i)
+        name_hashes[i] = hash_archive_name(state.entries[i].name.c_str(), state.entries[i].name.size());
+
+    auto const f_name_hash = [&](manifest_entry const* entry) { return name_hashes[size_t(entry - state.entries.data())]; };
+
+    std::sort(entries.begin(), entries.end(),
+              [&](manifest_entry const* lhs, manifest_entry const* rhs)
+              {
+                  if (f_name_hash(lhs) != f_name_hash(rhs))
+                      return f_name_hash(lhs) < f_name_hash(rhs);
+                  if (lhs->output != rhs->output)
+                      return lhs->output < rhs->output;
+                  return lhs->name < rhs->name;
+              });
+
+    // JSON
+    std::string json = "{\n    \"version\": " + std::to_string(manifest_header::current_version) + ",\n    \"binaries\": [";
+    for (size_t i = 0; i < entries.size(); ++i)
+    {
+        auto const& entry = *entries[i];
+
+        json.append(i == 0 ? "\n        {\"name\": \"" : ",\n        {\"name\": \"");
+        append_escaped(json, entry.name);
+        json.append("\", \"entrypoint\": \"");
+        append_escaped(json, entry.entrypoint);
+        json.append("\", \"target\": \"").append((entry.flags & archive_entry::flag_library) ? "lib" : get_target_name(entry.target));
+        json.append("\", \"format\": \"").append(entry.output == dxcw::output::spirv ? "spirv" : "dxil");
+        json.append("\", \"path\": \"");
+        append_escaped(json, entry.path);
+        json.append("\", \"size\": ").append(std::to_string(entry.size));
+        json.append(", \"content_hash\": ");
+        append_hash(json, entry.content_hash);
+        json.append(", \"source_hash\": ");
+        append_hash(json, entry.source_hash);
+        json.append(", \"checksum\": ");
+        append_checksum(json, entry.checksum);
+        json.append("}");
+    }
+    json.append(entries.empty() ? "]\n}\n" : "\n    ]\n}\n");
+
+    // binary form, strings are shared between records (ie. paths of archived outputs)
+    std::vector<char> strings;
+    std::unordered_map<std::string, uint32_t> string_offsets;
+    auto const f_add_string = [&](std::string const& str) -> uint32_t
+    {
+        auto const [it, is_new] = string_offsets.try_emplace(str, uint32_t(strings.size()));
+        if (is_new)
+            strings.insert(strings.end(), str.c_str(), str.c_str() + str.size() + 1);
+        return it->second;
+    };
+
+    std::vector<manifest_record> records(entries.size());
+    for (size_t i = 0; i < entries.size(); ++i)
+    {
+        auto const& entry = *entries[i];
+        auto& record = records[i];
+        record = {};
+        record.name_hash = f_name_hash(entries[i]);
+        record.content_hash = entry.content_hash;
+        record.source_hash = entry.source_hash;
+        record.size = entry.size;
+        record.name_offset = f_add_string(entry.name);
+        record.entrypoint_offset = f_add_string(entry.entrypoint);
+        record.path_offset = f_add_string(entry.path);
+        record.target = entry.target;
+        record.output = entry.output;
+        record.flags = entry.flags;
+        record.checksum = entry.checksum;
+    }
+
+    manifest_header header = {};
+    header.magic = manifest_header::magic_value;
+    header.version = manifest_header::current_version;
+    header.num_records = uint32_t(records.size());
+    header.strings_size = uint32_t(strings.size());
+    header.records_offset = sizeof(header);
+    header.strings_offset = header.records_offset + records.size() * sizeof(manifest_record);
+
+    std::string binary;
+    binary.reserve(size_t(header.strings_offset) + strings.size());
+    binary.append(reinterpret_cast<char const*>(&header), sizeof(header));
+    binary.append(reinterpret_cast<char const*>(records.data()), records.size() * sizeof(manifest_record));
+    binary.append(strings.data(), strings.size());
+
+    bool const json_success = write_manifest_file(json, std::string(path) + ".json");
+    bool const binary_success = write_manifest_file(binary, std::string(path) + ".bin");
+
+    if (json_success && binary_success)
+        DXCW_LOG("wrote shader manifest {} ({} binaries)", path, entries.size());
+
+    return json_success && binary_success;
+}
+
+void dxcw::manifest_writer::destroy()
+{
+    delete _state;
+    _state = nullptr;
+}
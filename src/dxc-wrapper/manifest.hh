@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <clean-core/span.hh>
+
+#include <dxc-wrapper/common/api.hh>
+#include <dxc-wrapper/fwd.hh>
+
+namespace dxcw
+{
+namespace detail
+{
+struct manifest_writer_state;
+}
+
+/// compact binary manifest, describes all outputs of a shaderlist build without opening any of them
+///
+/// layout:
+/// [manifest_header][manifest_record index][string table]
+/// records are sorted by (name_hash, output, name) like archive entries, names are the same as in archives (see archive.hh)
+/// content hashes are hash_archive_content of the binary, equal to archive_entry::content_hash of the same binary
+/// checksums are CRC-32C of the binary (see common/crc32c.hh), to detect damaged outputs at memory bandwidth
+/// all values are little endian
+struct manifest_header
+{
+    static constexpr uint32_t magic_value = 0x4d435844; // "DXCM"
+    static constexpr uint32_t current_version = 2;
+
+    uint32_t magic;
+    uint32_t version;
+    uint32_t num_records;
+    uint32_t strings_size;
+    uint64_t records_offset; // manifest_record[num_records]
+    uint64_t strings_offset; // null-terminated strings, referenced by offset
+};
+
+static_assert(sizeof(manifest_header) == 32, "manifest_header layout changed");
+
+struct manifest_record
+{
+    uint64_t name_hash;    // hash_archive_name of the name
+    uint64_t content_hash; // hash_archive_content of the binary
+    uint64_t source_hash;  // hash of the contents of the source file and all of its includes
+    uint64_t size;         // size of the binary in bytes
+    uint32_t name_offset;       // output path relative to the shaderlist without ending, ie. "bin/mat_ps"
+    uint32_t entrypoint_offset; // empty for libraries
+    uint32_t path_offset;       // file containing the binary relative to the shaderlist, ie. "bin/mat_ps.spv", or the archive
+    dxcw::target target;
+    dxcw::output output;
+    uint16_t flags; // archive_entry flags (ie. flag_library), without codec flags
+
+    uint32_t checksum; // CRC-32C of the binary
+    uint32_t reserved;
+};
+
+static_assert(sizeof(manifest_record) == 56, "manifest_record layout changed");
+
+/// collects the outputs of a shaderlist build and writes them as a manifest, in JSON and in the binary form above
+///
+/// the JSON form lists the same fields per output, hashes as hex strings:
+/// { "version": 2, "binaries": [ { "name": "bin/mat_ps", "entrypoint": "main_ps", "target": "ps", "format": "spirv",
+///   "path": "bin/mat_ps.spv", "size": 1234, "content_hash": "0x...", "source_hash": "0x...", "checksum": "0x..." } ] }
+/// source hashes are computed once per source file, includes are resolved like parse_includes
+/// files with unchanged content are not rewritten, so an unchanged build does not touch the manifest
+///
+/// Usage:
+/// dxcw::manifest_writer writer;
+/// writer.initialize("res/", include_paths);
+/// writer.add("res/bin/shader_vs", "spv", "res/src/shader.hlsl", "main_vs", dxcw::target::vertex, dxcw::output::spirv, data);
+/// writer.write("res/shaderlist.manifest"); // res/shaderlist.manifest.json and res/shaderlist.manifest.bin
+/// writer.destroy();
+struct DXCW_API manifest_writer
+{
+public:
+    /// names and paths of added outputs are relative to base_path, which is usually the directory of the shaderlist
+    /// include_paths are used to resolve the includes of sources, the writer keeps a copy
+    /// opt_container_path: the archive or embed source all binaries are written to, if they are not written to separate files
+    void initialize(char const* base_path, cc::span<char const* const> include_paths = {}, char const* opt_container_path = nullptr);
+
+    /// records a written binary, thread safe
+    /// output_path without file ending, the binary was written to <output_path>.<ending> unless there is a container
+    /// an existing record with the same name and output is replaced
+    void add(char const* output_path,
+             char const* ending,
+             char const* source_path,
+             char const* entrypoint,
+             dxcw::target target,
+             dxcw::output output,
+             cc::span<std::byte const> data,
+             uint16_t flags = 0);
+
+    /// writes <path>.json and <path>.bin, path without file ending
+    /// returns false if any of the files can't be written
+    bool write(char const* path) const;
+
+    void destroy();
+
+    bool is_initialized() const { return _state != nullptr; }
+
+    detail::manifest_writer_state* _state = nullptr;
+};
+}
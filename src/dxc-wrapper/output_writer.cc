@@ -0,0 +1,171 @@
+#include "output_writer.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <clean-core/assert.hh>
+
+#include <dxc-wrapper/common/log.hh>
+#include <dxc-wrapper/compiler.hh>
+#include <dxc-wrapper/file_util.hh>
+
+namespace
+{
+// jobs taken by a writer thread at once, larger batches mean fewer wakeups but less balancing between threads
+constexpr size_t sc_max_batch_size = 32;
+
+struct write_job
+{
+    dxcw::binary binary; // holds a reference of its blob
+    std::string path;
+};
+}
+
+struct dxcw::detail::output_writer_state
+{
+    std::mutex mutex;
+    std::condition_variable cv_pending; // jobs were queued or the writer is shutting down
+    std::condition_variable cv_idle;    // no jobs are queued or in flight
+
+    std::vector<write_job> pending_jobs;
+    unsigned num_jobs_in_flight = 0;
+    bool is_shutting_down = false;
+
+    std::atomic<unsigned> num_failed_writes = {0};
+    std::vector<std::thread> threads;
+};
+
+namespace
+{
+void run_writer_thread(dxcw::detail::output_writer_state& state)
+{
+    std::vector<write_job> batch;
+
+    for (;;)
+    {
+        {
+            std::unique_lock lock(state.mutex);
+            state.cv_pending.wait(lock, [&] { return !state.pending_jobs.empty() || state.is_shutting_down; });
+
+            if (state.pending_jobs.empty())
+                return;
+
+            // take the oldest jobs
+            size_t const num_taken = std::min(state.pending_jobs.size(), sc_max_batch_size);
+            batch.assign(std::make_move_iterator(state.pending_jobs.begin()), std::make_move_iterator(state.pending_jobs.begin() + num_taken));
+            state.pending_jobs.erase(state.pending_jobs.begin(), state.pending_jobs.begin() + num_taken);
+            state.num_jobs_in_flight += unsigned(num_taken);
+        }
+
+        for (auto& job : batch)
+        {
+            if (!dxcw::write_binary_to_file(job.binary, job.path.c_str()))
+                ++state.num_failed_writes;
+
+            dxcw::destroy_blob(job.binary.internal_blob);
+        }
+
+        {
+            std::lock_guard lock(state.mutex);
+            state.num_jobs_in_flight -= unsigned(batch.size());
+
+            if (state.pending_jobs.empty() && state.num_jobs_in_flight == 0)
+                state.cv_idle.notify_all();
+        }
+
+        batch.clear();
+    }
+}
+}
+
+void dxcw::output_writer::initialize(unsigned num_threads)
+{
+    CC_ASSERT(_state == nullptr && "double initialize");
+
+    _state = new detail::output_writer_state();
+    num_threads = std::max(1u, num_threads);
+
+    _state->threads.reserve(num_threads);
+    for (auto i = 0u; i < num_threads; ++i)
+    {
+        _state->threads.emplace_back(run_writer_thread, std::ref(*_state));
+    }
+}
+
+bool dxcw::output_writer::destroy()
+{
+    if (_state == nullptr)
+        return true;
+
+    {
+        std::lock_guard lock(_state->mutex);
+        _state->is_shutting_down = true;
+    }
+
+    // threads exit once the queue is drained
+    _state->cv_pending.notify_all();
+    for (auto& thread : _state->threads)
+    {
+        thread.join();
+    }
+
+    bool const success = _state->num_failed_writes.load() == 0;
+
+    delete _state;
+    _state = nullptr;
+    return success;
+}
+
+void dxcw::output_writer::write(dxcw::binary const& binary, char const* path, char const* ending)
+{
+    CC_CONTRACT(path);
+    CC_CONTRACT(ending);
+    CC_ASSERT(_state != nullptr && "Uninitialized dxcw::output_writer");
+
+    if (binary.data == nullptr)
+    {
+        ++_state->num_failed_writes;
+        return;
+    }
+
+    if (binary.internal_blob == nullptr)
+    {
+        // memory without a blob can't be kept alive, write it directly
+        if (!dxcw::write_binary_to_file(binary, path, ending))
+            ++_state->num_failed_writes;
+
+        return;
+    }
+
+    write_job job;
+    job.binary = binary;
+    job.path.append(path).append(".").append(ending);
+    dxcw::retain_blob(binary.internal_blob);
+
+    {
+        std::lock_guard lock(_state->mutex);
+        CC_ASSERT(!_state->is_shutting_down && "write during destroy");
+        _state->pending_jobs.push_back(std::move(job));
+    }
+
+    _state->cv_pending.notify_one();
+}
+
+void dxcw::output_writer::flush()
+{
+    CC_ASSERT(_state != nullptr && "Uninitialized dxcw::output_writer");
+
+    std::unique_lock lock(_state->mutex);
+    _state->cv_idle.wait(lock, [&] { return _state->pending_jobs.empty() && _state->num_jobs_in_flight == 0; });
+}
+
+unsigned dxcw::output_writer::get_num_failed_writes() const
+{
+    CC_ASSERT(_state != nullptr && "Uninitialized dxcw::output_writer");
+    return _state->num_failed_writes.load();
+}
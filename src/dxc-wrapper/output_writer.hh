@@ -0,0 +1,46 @@
+#pragma once
+
+#include <dxc-wrapper/common/api.hh>
+#include <dxc-wrapper/fwd.hh>
+
+namespace dxcw
+{
+namespace detail
+{
+struct output_writer_state;
+}
+
+/// writes compiled binaries to files on dedicated threads, so compiling threads never block on disk I/O
+///
+/// binaries are handed over without copying, the writer holds a reference to their blob until the file is written
+/// queued writes are picked up in batches, each write goes through write_binary_to_file
+///
+/// Usage:
+/// dxcw::output_writer writer;
+/// writer.initialize();
+/// writer.write(binary, "res/bin/shader_vs", "spv");
+/// dxcw::destroy(binary); // the writer keeps its own reference
+/// writer.destroy();
+struct DXCW_API output_writer
+{
+public:
+    /// starts the writer threads
+    void initialize(unsigned num_threads = 2);
+
+    /// waits for all queued writes and stops the threads, returns false if any write failed
+    bool destroy();
+
+    /// queues a write of the binary to <path>.<ending>, the caller can destroy the binary right after
+    void write(dxcw::binary const& binary, char const* path, char const* ending);
+
+    /// blocks until all writes queued so far are done
+    void flush();
+
+    /// amount of failed writes since initialize()
+    unsigned get_num_failed_writes() const;
+
+    bool is_initialized() const { return _state != nullptr; }
+
+    detail::output_writer_state* _state = nullptr;
+};
+}
@@ -0,0 +1,32 @@
+#include "reflection.hh"
+
+#include <clean-core/assert.hh>
+
+#include <dxc-wrapper/common/dxil_container.hh>
+#include <dxc-wrapper/common/log.hh>
+#include <dxc-wrapper/common/spirv_reflect.hh>
+#include <dxc-wrapper/compiler.hh>
+
+bool dxcw::reflect_binary(cc::span<std::byte const> data, dxcw::output output, shader_reflection* out_reflection)
+{
+    CC_CONTRACT(out_reflection);
+
+    if (output == output::spirv)
+    {
+        if (!detail::spirv_reflect(data.data(), data.size(), out_reflection))
+        {
+            DXCW_LOG_ERROR("failed to reflect SPIR-V binary, the module is malformed or exceeds the capacity of dxcw::shader_reflection");
+            return false;
+        }
+
+        return true;
+    }
+
+    if (!detail::dxil_reflect(data.data(), data.size(), out_reflection))
+    {
+        DXCW_LOG_ERROR("failed to reflect DXIL binary, the container is malformed or exceeds the capacity of dxcw::shader_reflection");
+        return false;
+    }
+
+    return true;
+}
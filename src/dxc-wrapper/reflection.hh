@@ -0,0 +1,127 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <clean-core/span.hh>
+
+#include <dxc-wrapper/common/api.hh>
+#include <dxc-wrapper/fwd.hh>
+
+namespace dxcw
+{
+/// kind of a resource binding, HLSL type and the equivalent Vulkan descriptor type
+enum class resource_type : uint8_t
+{
+    unknown,
+    constant_buffer,          // cbuffer, ConstantBuffer<T> - uniform buffer
+    sampler,                  // SamplerState, SamplerComparisonState - sampler
+    texture,                  // Texture* - sampled image
+    rw_texture,               // RWTexture* - storage image
+    typed_buffer,             // Buffer<T> - uniform texel buffer
+    rw_typed_buffer,          // RWBuffer<T> - storage texel buffer
+    buffer,                   // StructuredBuffer<T>, ByteAddressBuffer - read-only storage buffer
+    rw_buffer,                // RWStructuredBuffer<T>, RWByteAddressBuffer, Append/ConsumeStructuredBuffer<T>, counters - storage buffer
+    acceleration_structure,   // RaytracingAccelerationStructure
+    combined_texture_sampler, // SPIR-V only, [[vk::combinedImageSampler]]
+    input_attachment,         // SPIR-V only, SubpassInput
+};
+
+/// scalar type of a stage input or output
+enum class component_type : uint8_t
+{
+    unknown,
+    boolean,
+    int16,
+    uint16,
+    int32,
+    uint32,
+    int64,
+    uint64,
+    float16,
+    float32,
+    float64,
+};
+
+struct reflection_binding
+{
+    uint16_t name_offset;
+    resource_type type;
+    uint32_t space;        // SPIR-V: descriptor set
+    uint32_t binding;      // SPIR-V: binding, DXIL: register (lower bound)
+    uint32_t num_elements; // 1 if the resource is not an array, 0 if the array is unbounded
+    uint32_t size;         // constant buffers only, size of the buffer in bytes, 0 if unknown (always for DXIL)
+};
+
+struct reflection_push_constants
+{
+    uint16_t name_offset;
+    uint16_t entry_point_index;
+    uint32_t size; // size of the block in bytes, the highest member offset plus member size
+};
+
+struct reflection_signature_element
+{
+    static constexpr uint32_t no_value = 0xFFFFFFFF;
+
+    uint16_t name_offset; // semantic name without index, ie. "TEXCOORD" (SPIR-V: the variable name if compiled without -fspv-reflect)
+    uint16_t entry_point_index;
+    uint32_t semantic_index; // DXIL: the first index of elements spanning multiple rows
+    uint32_t location; // SPIR-V: location, DXIL: start row, no_value for built-ins without one
+    uint32_t builtin;  // SPIR-V: BuiltIn decoration, DXIL: semantic kind, no_value for user semantics
+    component_type type;
+    uint8_t num_components; // 1 - 4, 0 for structs
+    bool is_output;
+};
+
+struct reflection_entry_point
+{
+    uint16_t name_offset;
+    dxcw::target target;
+    uint32_t thread_group_size[3]; // compute, mesh and amplification only, otherwise 0
+};
+
+/// binding and interface information of a compiled binary, without D3D12 or external dependencies
+/// all names are null-terminated and referenced by offset into string_buffer, use get_name
+struct shader_reflection
+{
+    static constexpr unsigned max_num_entry_points = 64;
+    static constexpr unsigned max_num_bindings = 128;
+    static constexpr unsigned max_num_push_constants = 8;
+    static constexpr unsigned max_num_signature_elements = 128;
+
+    char string_buffer[8192];
+    uint16_t string_buffer_size = 0;
+
+    reflection_entry_point entry_points[max_num_entry_points];
+    reflection_binding bindings[max_num_bindings];
+    reflection_push_constants push_constants[max_num_push_constants];
+    reflection_signature_element signature_elements[max_num_signature_elements];
+    uint16_t num_entry_points = 0;
+    uint16_t num_bindings = 0;
+    uint16_t num_push_constants = 0;
+    uint16_t num_signature_elements = 0;
+
+    char const* get_name(uint16_t offset) const { return string_buffer + offset; }
+
+    /// copies a string (not necessarily null-terminated) to the string buffer, returns false if it is full
+    bool add_name(char const* text, size_t length, uint16_t& out_offset)
+    {
+        if (length >= sizeof(string_buffer) - string_buffer_size)
+            return false;
+
+        out_offset = string_buffer_size;
+        std::memcpy(string_buffer + string_buffer_size, text, length);
+        string_buffer[string_buffer_size + length] = '\0';
+        string_buffer_size = uint16_t(string_buffer_size + length + 1);
+        return true;
+    }
+};
+
+/// reads the reflection of a compiled binary, as returned by the compile functions or read from an archive
+/// SPIR-V modules are parsed natively (see common/spirv_reflect.hh), names require a binary that was not stripped of debug information
+/// DXIL containers are reflected from their PSV0 and RDAT parts (see common/dxil_container.hh), resources are only named in libraries
+/// returns false if the binary is malformed or its reflection exceeds the capacity of shader_reflection
+DXCW_API bool reflect_binary(cc::span<std::byte const> data, dxcw::output output, shader_reflection* out_reflection);
+}
@@ -0,0 +1,314 @@
+#include "shader_store.hh"
+
+#include <cstring>
+
+#include <algorithm>
+
+#include <clean-core/alloc_array.hh>
+#include <clean-core/assert.hh>
+
+#include <dxc-wrapper/common/crc32c.hh>
+#include <dxc-wrapper/common/log.hh>
+#include <dxc-wrapper/common/lz.hh>
+#include <dxc-wrapper/common/spirv_codec.hh>
+#include <dxc-wrapper/compiler.hh>
+
+namespace
+{
+// mappings of an archive that is updated concurrently, an update only needs a single remap unless it is followed by another
+constexpr unsigned sc_max_map_attempts = 4;
+}
+
+bool dxcw::shader_store::initialize(char const* archive_path, bool verify_checksums)
+{
+    CC_CONTRACT(archive_path);
+    CC_ASSERT(!is_initialized() && "double initialize");
+
+    // updates of the archive overwrite header slots in place (see archive_writer::initialize_update), the current one is copied once
+    // and only the copy is used
+    // an update can append a new index after the archive was mapped and reference it from a header before the copy is taken,
+    // read_archive_header then prefers the previous header, if both lie beyond the mapping the archive is mapped again
+    archive_header header;
+    for (auto attempt = 0u;; ++attempt)
+    {
+        if (!_file.map(archive_path))
+        {
+            DXCW_LOG_ERROR("failed to open shader archive {}", archive_path);
+            return false;
+        }
+
+        if (!read_archive_header(_file.data, _file.size, archive_path, header))
+        {
+            _file.unmap();
+            return false;
+        }
+
+        if (get_archive_index_end(header) <= _file.size)
+            break;
+
+        _file.unmap();
+        if (attempt + 1 == sc_max_map_attempts)
+        {
+            DXCW_LOG_ERROR("shader archive {} references an index beyond its end, it is being updated or truncated", archive_path);
+            return false;
+        }
+    }
+
+    if (!validate_archive(header, _file.data, _file.size, archive_path))
+    {
+        _file.unmap();
+        return false;
+    }
+
+    _header = header;
+    _entries = reinterpret_cast<archive_entry const*>(_file.data + _header.index_offset);
+    _strings = reinterpret_cast<char const*>(_file.data + _header.strings_offset);
+
+    if (_header.phf_num_buckets > 0)
+    {
+        _phf_displacements = reinterpret_cast<uint32_t const*>(_file.data + _header.phf_offset);
+        _phf_entry_indices = _phf_displacements + _header.phf_num_buckets;
+    }
+
+    if (verify_checksums)
+        _checksum_states = new std::atomic<uint32_t>[(size_t(_header.num_entries) + 15) / 16]();
+
+    return true;
+}
+
+void dxcw::shader_store::destroy()
+{
+    _file.unmap();
+    _header = {};
+    _entries = nullptr;
+    _strings = nullptr;
+    _phf_displacements = nullptr;
+    _phf_entry_indices = nullptr;
+
+    delete[] _checksum_states;
+    _checksum_states = nullptr;
+}
+
+cc::span<std::byte const> dxcw::shader_store::find(char const* name, dxcw::output output) const
+{
+    auto const* const entry = find_entry(name, output);
+    if (!entry)
+        return {};
+
+    if (is_encoded(*entry))
+    {
+        DXCW_LOG_WARN("shader archive entry {} is compressed or encoded, use dxcw::shader_store::read", name);
+        return {};
+    }
+
+    if (_checksum_states && !verify(*entry))
+        return {};
+
+    return get_data(*entry);
+}
+
+dxcw::archive_entry const* dxcw::shader_store::find_entry(char const* name, dxcw::output output) const
+{
+    CC_CONTRACT(name);
+    return find_entry(hash_archive_name(name), name, output);
+}
+
+dxcw::archive_entry const* dxcw::shader_store::find_entry(uint64_t name_hash, char const* name, dxcw::output output) const
+{
+    CC_CONTRACT(name);
+    CC_ASSERT(is_initialized() && "Uninitialized dxcw::shader_store");
+
+    if (_phf_displacements)
+    {
+        // keys are unique in archives with a perfect hash, the slot is the only candidate
+        auto const* const entry = find_candidate(name_hash, output);
+        if (entry && std::strcmp(_strings + entry->name_offset, name) == 0)
+            return entry;
+
+        return nullptr;
+    }
+
+    auto const* const begin = _entries;
+    auto const* const end = _entries + _header.num_entries;
+
+    auto const* it = std::lower_bound(begin, end, nullptr,
+                                      [&](archive_entry const& entry, std::nullptr_t)
+                                      {
+                                          if (entry.name_hash != name_hash)
+                                              return entry.name_hash < name_hash;
+                                          return entry.output < output;
+                                      });
+
+    // entries with equal hash and output are ordered by name, hash collisions are rare
+    for (; it != end && it->name_hash == name_hash && it->output == output; ++it)
+    {
+        if (std::strcmp(_strings + it->name_offset, name) == 0)
+            return it;
+    }
+
+    return nullptr;
+}
+
+dxcw::archive_entry const* dxcw::shader_store::find_entry(uint64_t name_hash, dxcw::output output) const
+{
+    CC_ASSERT(is_initialized() && "Uninitialized dxcw::shader_store");
+
+    if (_phf_displacements)
+        return find_candidate(name_hash, output);
+
+    auto const* const end = _entries + _header.num_entries;
+    auto const* const it = std::lower_bound(_entries, end, nullptr,
+                                            [&](archive_entry const& entry, std::nullptr_t)
+                                            {
+                                                if (entry.name_hash != name_hash)
+                                                    return entry.name_hash < name_hash;
+                                                return entry.output < output;
+                                            });
+
+    if (it == end || it->name_hash != name_hash || it->output != output)
+        return nullptr;
+
+    return it;
+}
+
+dxcw::archive_entry const* dxcw::shader_store::find_candidate(uint64_t name_hash, dxcw::output output) const
+{
+    if (_header.num_entries == 0)
+        return nullptr;
+
+    auto const key = get_archive_key(name_hash, output);
+    auto const bucket = get_archive_bucket(key, _header.phf_seed, _header.phf_num_buckets);
+    auto const slot = get_archive_slot(key, _header.phf_seed, _phf_displacements[bucket], _header.num_entries);
+
+    auto const& entry = _entries[_phf_entry_indices[slot]];
+    if (entry.name_hash != name_hash || entry.output != output)
+        return nullptr;
+
+    return &entry;
+}
+
+dxcw::archive_entry const* dxcw::shader_store::find_entry(char const* name, char const* entrypoint, dxcw::target target, dxcw::output output) const
+{
+    CC_CONTRACT(entrypoint);
+
+    auto const* const entry = find_entry(name, output);
+    if (!entry || entry->target != target || std::strcmp(_strings + entry->entrypoint_offset, entrypoint) != 0)
+        return nullptr;
+
+    return entry;
+}
+
+cc::span<std::byte const> dxcw::shader_store::get_data(archive_entry const& entry) const
+{
+    CC_ASSERT(is_initialized() && "Uninitialized dxcw::shader_store");
+    return cc::span<std::byte const>(_file.data + entry.offset, size_t(entry.size));
+}
+
+bool dxcw::shader_store::read(archive_entry const& entry, cc::span<std::byte> out_memory, cc::allocator* scratch_alloc) const
+{
+    CC_ASSERT(is_initialized() && "Uninitialized dxcw::shader_store");
+
+    if (out_memory.size() < entry.raw_size)
+    {
+        DXCW_LOG_ERROR("memory for shader archive entry {} too small ({} of {} bytes)", get_name(entry), out_memory.size(), entry.raw_size);
+        return false;
+    }
+
+    if (_checksum_states && !verify(entry))
+        return false;
+
+    auto const data = get_data(entry);
+    bool success = true;
+
+    switch (entry.flags & archive_entry::codec_flags)
+    {
+    case 0:
+        std::memcpy(out_memory.data(), data.data(), data.size());
+        break;
+    case archive_entry::flag_compressed:
+        success = detail::lz_decompress(data.data(), data.size(), out_memory.data(), entry.raw_size);
+        break;
+    case archive_entry::flag_spirv_encoded:
+        success = detail::spirv_decode(data.data(), data.size(), out_memory.data(), entry.raw_size);
+        break;
+    default:
+    {
+        // size of the encoded module, followed by the compressed encoded module
+        uint32_t encoded_size = 0;
+        success = data.size() >= sizeof(encoded_size);
+        if (success)
+            std::memcpy(&encoded_size, data.data(), sizeof(encoded_size));
+
+        // the encoded size is not validated on load, bound it before allocating
+        success = success && encoded_size <= detail::spirv_get_max_encoded_size(entry.raw_size);
+        if (success)
+        {
+            auto encoded = cc::alloc_array<std::byte>::uninitialized(encoded_size, scratch_alloc);
+            success = detail::lz_decompress(data.data() + sizeof(encoded_size), data.size() - sizeof(encoded_size), encoded.data(), encoded.size())
+                      && detail::spirv_decode(encoded.data(), encoded.size(), out_memory.data(), entry.raw_size);
+        }
+        break;
+    }
+    }
+
+    if (!success)
+        DXCW_LOG_ERROR("shader archive entry {} is corrupt", get_name(entry));
+
+    return success;
+}
+
+bool dxcw::shader_store::verify(archive_entry const& entry) const
+{
+    CC_ASSERT(is_initialized() && "Uninitialized dxcw::shader_store");
+
+    auto const index = size_t(&entry - _entries);
+    CC_ASSERT(index < _header.num_entries && "entry is not part of this store");
+
+    uint32_t const verified_bit = 1u << (index % 16 * 2);
+    uint32_t const valid_bit = verified_bit << 1;
+
+    if (_checksum_states)
+    {
+        uint32_t const state = _checksum_states[index / 16].load(std::memory_order_relaxed);
+        if (state & verified_bit)
+            return (state & valid_bit) != 0;
+    }
+
+    // concurrent first accesses compute the same result, the redundant work is harmless
+    auto const data = get_data(entry);
+    bool const is_valid = detail::crc32c(data.data(), data.size()) == entry.checksum;
+
+    if (_checksum_states)
+        _checksum_states[index / 16].fetch_or(verified_bit | (is_valid ? valid_bit : 0), std::memory_order_relaxed);
+
+    if (!is_valid)
+        DXCW_LOG_ERROR("shader archive entry {} is corrupt (checksum mismatch)", get_name(entry));
+
+    return is_valid;
+}
+
+unsigned dxcw::shader_store::verify_all() const
+{
+    CC_ASSERT(is_initialized() && "Uninitialized dxcw::shader_store");
+
+    unsigned num_corrupt = 0;
+    for (auto const& entry : get_entries())
+    {
+        if (!verify(entry))
+            ++num_corrupt;
+    }
+
+    return num_corrupt;
+}
+
+char const* dxcw::shader_store::get_name(archive_entry const& entry) const { return _strings + entry.name_offset; }
+
+char const* dxcw::shader_store::get_entrypoint(archive_entry const& entry) const { return _strings + entry.entrypoint_offset; }
+
+cc::span<dxcw::archive_entry const> dxcw::shader_store::get_entries() const
+{
+    if (!is_initialized())
+        return {};
+
+    return cc::span<archive_entry const>(_entries, _header.num_entries);
+}
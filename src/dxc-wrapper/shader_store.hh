@@ -0,0 +1,100 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include <clean-core/fwd.hh>
+#include <clean-core/span.hh>
+
+#include <dxc-wrapper/archive.hh>
+#include <dxc-wrapper/common/api.hh>
+#include <dxc-wrapper/common/mapped_file.hh>
+#include <dxc-wrapper/fwd.hh>
+
+namespace dxcw
+{
+/// read-only runtime access to a packed shader archive (see archive.hh)
+///
+/// the archive is memory mapped, lookups use the perfect hash of the archive (a binary search over the index for archives without one)
+/// and return spans into the mapping
+/// nothing is copied, pages of a binary are only loaded when its data is accessed
+/// the checksum of an entry is verified on its first access through find() or read(), the result is cached (two bits per entry)
+/// compressed or encoded entries are not accessible in place, read() decodes them into caller-provided memory
+/// a store keeps the index it was initialized with, updates of the archive (archive_writer::initialize_update) only append,
+/// so it stays valid until the archive is compacted or rewritten, initialize the store again to see updated entries
+///
+/// Usage:
+/// dxcw::shader_store store;
+/// store.initialize("res/bin/shaders.dxca");
+/// cc::span<std::byte const> spirv = store.find("bin/shader_vs", dxcw::output::spirv);
+///
+/// archive_entry const* entry = store.find_entry("bin/shader_ps", dxcw::output::spirv);
+/// std::vector<std::byte> memory(store.get_raw_size(*entry));
+/// store.read(*entry, memory);
+/// store.destroy();
+struct DXCW_API shader_store
+{
+public:
+    /// maps and validates the archive, returns false if it can't be opened or is malformed
+    /// verify_checksums = false skips the checksum verification of entries on first access, verify() can still be called explicitly
+    bool initialize(char const* archive_path, bool verify_checksums = true);
+    void destroy();
+
+    bool is_initialized() const { return _file.is_mapped(); }
+
+    /// returns the binary with the given name and output, or an empty span if it does not exist, is compressed or encoded, or is corrupt
+    /// the span is valid until destroy()
+    cc::span<std::byte const> find(char const* name, dxcw::output output) const;
+
+    /// returns the index entry with the given name and output, or nullptr
+    archive_entry const* find_entry(char const* name, dxcw::output output) const;
+
+    /// returns the index entry with the given name and output, or nullptr, name_hash must be hash_archive_name(name)
+    archive_entry const* find_entry(uint64_t name_hash, char const* name, dxcw::output output) const;
+
+    /// returns the index entry with the given name hash and output, or nullptr
+    /// compares the hash only, intended for constexpr ids from archive_writer::write_id_header
+    archive_entry const* find_entry(uint64_t name_hash, dxcw::output output) const;
+
+    /// returns the index entry with the given name, entrypoint, target and output, or nullptr
+    archive_entry const* find_entry(char const* name, char const* entrypoint, dxcw::target target, dxcw::output output) const;
+
+    /// writes the decoded binary of the entry to out_memory, which must hold get_raw_size(entry) bytes
+    /// returns false if out_memory is too small or the blob is corrupt (checksum mismatch or malformed encoding)
+    /// scratch_alloc is only used for entries that are both SPIR-V encoded and compressed
+    bool read(archive_entry const& entry, cc::span<std::byte> out_memory, cc::allocator* scratch_alloc = cc::system_allocator) const;
+
+    /// the stored bytes of the entry, compressed or encoded if is_encoded(entry)
+    /// the checksum is not verified, see verify()
+    cc::span<std::byte const> get_data(archive_entry const& entry) const;
+
+    /// returns true if the checksum of the stored bytes of the entry matches, thread safe
+    /// computed once per entry and cached, unless the store was initialized without checksum verification
+    bool verify(archive_entry const& entry) const;
+
+    /// verifies all entries, returns the amount of corrupt entries
+    unsigned verify_all() const;
+    static bool is_encoded(archive_entry const& entry) { return (entry.flags & archive_entry::codec_flags) != 0; }
+    static bool is_compressed(archive_entry const& entry) { return (entry.flags & archive_entry::flag_compressed) != 0; }
+    /// size of the binary, size of the stored bytes is entry.size
+    static size_t get_raw_size(archive_entry const& entry) { return entry.raw_size; }
+
+    char const* get_name(archive_entry const& entry) const;
+    char const* get_entrypoint(archive_entry const& entry) const;
+
+    /// all entries, sorted by (name_hash, output, name)
+    cc::span<archive_entry const> get_entries() const;
+
+    detail::mapped_file _file;
+    archive_header _header = {};
+    archive_entry const* _entries = nullptr;
+    char const* _strings = nullptr;
+    uint32_t const* _phf_displacements = nullptr; // nullptr if the archive has no perfect hash
+    uint32_t const* _phf_entry_indices = nullptr;
+    std::atomic<uint32_t>* _checksum_states = nullptr; // two bits per entry (verified, valid), nullptr if checksums are not verified
+
+private:
+    archive_entry const* find_candidate(uint64_t name_hash, dxcw::output output) const;
+};
+}
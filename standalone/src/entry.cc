@@ -1,18 +1,33 @@
 #include "entry.hh"
 
+#include <algorithm>
+#include <chrono>
 #include <csignal>
 #include <cstdio>
+#include <cstring>
 #include <filesystem>
+#include <memory>
+#include <string>
 #include <thread>
+#include <vector>
 
 #include <clean-core/alloc_array.hh>
 #include <clean-core/alloc_vector.hh>
 
 #include <nexus/args.hh>
 
+#include <dxc-wrapper/archive.hh>
+#include <dxc-wrapper/common/crc32c.hh>
 #include <dxc-wrapper/common/log.hh>
+#include <dxc-wrapper/common/lz.hh>
+#include <dxc-wrapper/common/mapped_file.hh>
+#include <dxc-wrapper/common/spirv_codec.hh>
 #include <dxc-wrapper/compiler.hh>
+#include <dxc-wrapper/embed.hh>
 #include <dxc-wrapper/file_util.hh>
+#include <dxc-wrapper/manifest.hh>
+#include <dxc-wrapper/reflection.hh>
+#include <dxc-wrapper/shader_store.hh>
 
 #include "common/file_watch.hh"
 
@@ -20,6 +35,279 @@ namespace
 {
 volatile int gv_keep_running = 1;
 void interrupt_handler(int) { gv_keep_running = 0; }
+
+uint64_t get_throughput(uint64_t num_bytes, double seconds) { return seconds > 0.0 ? uint64_t(double(num_bytes) / seconds / 1e6) : 0; }
+
+// verifies the checksums of all entries of an archive, returns false if it is malformed or any entry is corrupt
+bool verify_archive_checksums(char const* archive_path)
+{
+    dxcw::shader_store store;
+    if (!store.initialize(archive_path, false))
+        return false;
+
+    uint64_t num_bytes = 0;
+    for (auto const& entry : store.get_entries())
+        num_bytes += entry.size;
+
+    auto const start = std::chrono::steady_clock::now();
+    unsigned const num_corrupt = store.verify_all();
+    double const seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    DXCW_LOG("verified {} entries of shader archive {} ({} bytes at {} MB/s), {} corrupt", store.get_entries().size(), archive_path, num_bytes,
+             get_throughput(num_bytes, seconds), num_corrupt);
+
+    store.destroy();
+    return num_corrupt == 0;
+}
+
+// verifies the size and checksum of each output listed in a binary manifest, archives containing outputs are verified as a whole
+bool verify_manifest_outputs(dxcw::detail::mapped_file const& manifest, char const* manifest_path)
+{
+    using dxcw::manifest_header;
+    using dxcw::manifest_record;
+
+    if (manifest.size < sizeof(manifest_header))
+    {
+        DXCW_LOG_ERROR("shader manifest {} is truncated", manifest_path);
+        return false;
+    }
+
+    manifest_header header;
+    std::memcpy(&header, manifest.data, sizeof(header));
+
+    uint64_t const records_size = uint64_t(header.num_records) * sizeof(manifest_record);
+    if (header.version != manifest_header::current_version || header.records_offset > manifest.size
+        || records_size > manifest.size - header.records_offset || header.strings_offset > manifest.size
+        || header.strings_size > manifest.size - header.strings_offset || header.strings_size == 0
+        || char(manifest.data[header.strings_offset + header.strings_size - 1]) != '\0')
+    {
+        DXCW_LOG_ERROR("shader manifest {} is malformed or has an unsupported version", manifest_path);
+        return false;
+    }
+
+    auto const* const records = reinterpret_cast<manifest_record const*>(manifest.data + header.records_offset);
+    auto const* const strings = reinterpret_cast<char const*>(manifest.data + header.strings_offset);
+    auto const base_path = std::filesystem::path(manifest_path).remove_filename();
+
+    std::vector<std::string> verified_containers;
+    unsigned num_damaged = 0;
+    uint64_t num_bytes = 0;
+    double seconds = 0.0;
+
+    for (auto i = 0u; i < header.num_records; ++i)
+    {
+        auto const& record = records[i];
+        if (record.name_offset >= header.strings_size || record.path_offset >= header.strings_size)
+        {
+            DXCW_LOG_ERROR("shader manifest {} has an invalid record #{}", manifest_path, i);
+            return false;
+        }
+
+        std::string const name = strings + record.name_offset;
+        std::string const path = strings + record.path_offset;
+        auto const file_path = (base_path / path).string();
+
+        // outputs in archives and embedded sources share their path
+        if (path != name + (record.output == dxcw::output::spirv ? ".spv" : ".dxil"))
+        {
+            if (std::find(verified_containers.begin(), verified_containers.end(), path) != verified_containers.end())
+                continue;
+
+            verified_containers.push_back(path);
+
+            dxcw::detail::mapped_file container;
+            uint32_t magic = 0;
+            if (container.map(file_path.c_str()) && container.size >= sizeof(magic))
+                std::memcpy(&magic, container.data, sizeof(magic));
+
+            bool const is_archive = magic == dxcw::archive_header::magic_value;
+            container.unmap();
+
+            if (is_archive && !verify_archive_checksums(file_path.c_str()))
+                ++num_damaged;
+
+            continue;
+        }
+
+        dxcw::detail::mapped_file file;
+        if (!file.map(file_path.c_str()) && record.size > 0)
+        {
+            DXCW_LOG_ERROR("{} is missing", file_path);
+            ++num_damaged;
+            continue;
+        }
+
+        if (file.size != record.size)
+        {
+            DXCW_LOG_ERROR("{} has {} bytes, expected {}", file_path, file.size, record.size);
+            ++num_damaged;
+            file.unmap();
+            continue;
+        }
+
+        auto const start = std::chrono::steady_clock::now();
+        uint32_t const checksum = dxcw::detail::crc32c(file.data, file.size);
+        seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        num_bytes += file.size;
+
+        if (checksum != record.checksum)
+        {
+            DXCW_LOG_ERROR("{} is corrupt (checksum mismatch)", file_path);
+            ++num_damaged;
+        }
+
+        file.unmap();
+    }
+
+    DXCW_LOG("verified {} outputs of shader manifest {} ({} bytes at {} MB/s), {} damaged", header.num_records, manifest_path, num_bytes,
+             get_throughput(num_bytes, seconds), num_damaged);
+    return num_damaged == 0;
+}
+
+char const* get_resource_type_name(dxcw::resource_type type)
+{
+    switch (type)
+    {
+    case dxcw::resource_type::constant_buffer:
+        return "constant_buffer";
+    case dxcw::resource_type::sampler:
+        return "sampler";
+    case dxcw::resource_type::texture:
+        return "texture";
+    case dxcw::resource_type::rw_texture:
+        return "rw_texture";
+    case dxcw::resource_type::typed_buffer:
+        return "typed_buffer";
+    case dxcw::resource_type::rw_typed_buffer:
+        return "rw_typed_buffer";
+    case dxcw::resource_type::buffer:
+        return "buffer";
+    case dxcw::resource_type::rw_buffer:
+        return "rw_buffer";
+    case dxcw::resource_type::acceleration_structure:
+        return "acceleration_structure";
+    case dxcw::resource_type::combined_texture_sampler:
+        return "combined_texture_sampler";
+    case dxcw::resource_type::input_attachment:
+        return "input_attachment";
+    case dxcw::resource_type::unknown:
+        break;
+    }
+
+    return "unknown";
+}
+
+char const* get_component_type_name(dxcw::component_type type)
+{
+    switch (type)
+    {
+    case dxcw::component_type::boolean:
+        return "bool";
+    case dxcw::component_type::int16:
+        return "int16";
+    case dxcw::component_type::uint16:
+        return "uint16";
+    case dxcw::component_type::int32:
+        return "int32";
+    case dxcw::component_type::uint32:
+        return "uint32";
+    case dxcw::component_type::int64:
+        return "int64";
+    case dxcw::component_type::uint64:
+        return "uint64";
+    case dxcw::component_type::float16:
+        return "float16";
+    case dxcw::component_type::float32:
+        return "float32";
+    case dxcw::component_type::float64:
+        return "float64";
+    case dxcw::component_type::unknown:
+        break;
+    }
+
+    return "unknown";
+}
+
+// appends a name as a JSON string
+void append_json_string(std::string& out, char const* text)
+{
+    out.push_back('"');
+    for (; *text != '\0'; ++text)
+    {
+        if (*text == '"' || *text == '\\')
+            out.push_back('\\');
+
+        if (uint8_t(*text) >= 0x20)
+            out.push_back(*text);
+    }
+    out.push_back('"');
+}
+
+// appends a value that is signature_element::no_value if absent as a JSON number or null
+void append_json_optional(std::string& out, uint32_t value)
+{
+    out.append(value == dxcw::reflection_signature_element::no_value ? "null" : std::to_string(value));
+}
+
+std::string get_reflection_json(dxcw::shader_reflection const& reflection)
+{
+    std::string json = "{\n    \"entry_points\": [";
+    for (auto i = 0u; i < reflection.num_entry_points; ++i)
+    {
+        auto const& entry_point = reflection.entry_points[i];
+        json.append(i == 0 ? "\n        {\"name\": " : ",\n        {\"name\": ");
+        append_json_string(json, reflection.get_name(entry_point.name_offset));
+        json.append(", \"target\": \"").append(dxcw::get_target_name(entry_point.target));
+        json.append("\", \"thread_group_size\": [").append(std::to_string(entry_point.thread_group_size[0]));
+        json.append(", ").append(std::to_string(entry_point.thread_group_size[1]));
+        json.append(", ").append(std::to_string(entry_point.thread_group_size[2])).append("]}");
+    }
+
+    json.append(reflection.num_entry_points == 0 ? "],\n    \"bindings\": [" : "\n    ],\n    \"bindings\": [");
+    for (auto i = 0u; i < reflection.num_bindings; ++i)
+    {
+        auto const& binding = reflection.bindings[i];
+        json.append(i == 0 ? "\n        {\"name\": " : ",\n        {\"name\": ");
+        append_json_string(json, reflection.get_name(binding.name_offset));
+        json.append(", \"type\": \"").append(get_resource_type_name(binding.type));
+        json.append("\", \"space\": ");
+        append_json_optional(json, binding.space);
+        json.append(", \"binding\": ");
+        append_json_optional(json, binding.binding);
+        json.append(", \"num_elements\": ").append(std::to_string(binding.num_elements));
+        json.append(", \"size\": ").append(std::to_string(binding.size)).append("}");
+    }
+
+    json.append(reflection.num_bindings == 0 ? "],\n    \"push_constants\": [" : "\n    ],\n    \"push_constants\": [");
+    for (auto i = 0u; i < reflection.num_push_constants; ++i)
+    {
+        auto const& push_constants = reflection.push_constants[i];
+        json.append(i == 0 ? "\n        {\"name\": " : ",\n        {\"name\": ");
+        append_json_string(json, reflection.get_name(push_constants.name_offset));
+        json.append(", \"entry_point\": ").append(std::to_string(push_constants.entry_point_index));
+        json.append(", \"size\": ").append(std::to_string(push_constants.size)).append("}");
+    }
+
+    json.append(reflection.num_push_constants == 0 ? "],\n    \"signature\": [" : "\n    ],\n    \"signature\": [");
+    for (auto i = 0u; i < reflection.num_signature_elements; ++i)
+    {
+        auto const& element = reflection.signature_elements[i];
+        json.append(i == 0 ? "\n        {\"name\": " : ",\n        {\"name\": ");
+        append_json_string(json, reflection.get_name(element.name_offset));
+        json.append(", \"semantic_index\": ").append(std::to_string(element.semantic_index));
+        json.append(", \"entry_point\": ").append(std::to_string(element.entry_point_index));
+        json.append(element.is_output ? ", \"output\": true" : ", \"output\": false");
+        json.append(", \"location\": ");
+        append_json_optional(json, element.location);
+        json.append(", \"builtin\": ");
+        append_json_optional(json, element.builtin);
+        json.append(", \"type\": \"").append(get_component_type_name(element.type));
+        json.append("\", \"num_components\": ").append(std::to_string(element.num_components)).append("}");
+    }
+
+    json.append(reflection.num_signature_elements == 0 ? "]\n}\n" : "\n    ]\n}\n");
+    return json;
+}
 }
 
 int dxcw::display_version_and_exit()
@@ -33,6 +321,205 @@ int dxcw::display_version_and_exit()
     return success ? 0 : 1;
 }
 
+int dxcw::compact_archive_file(char const* archive_path) { return dxcw::compact_archive(archive_path) ? 0 : 1; }
+
+int dxcw::verify_file(char const* path)
+{
+    dxcw::detail::mapped_file file;
+    if (!file.map(path))
+    {
+        DXCW_LOG_ERROR("failed to open {}", path);
+        return 1;
+    }
+
+    uint32_t magic = 0;
+    if (file.size >= sizeof(magic))
+        std::memcpy(&magic, file.data, sizeof(magic));
+
+    bool success = false;
+    if (magic == dxcw::archive_header::magic_value)
+        success = verify_archive_checksums(path);
+    else if (magic == dxcw::manifest_header::magic_value)
+        success = verify_manifest_outputs(file, path);
+    else
+        DXCW_LOG_ERROR("{} is neither a shader archive nor a binary shader manifest", path);
+
+    file.unmap();
+    return success ? 0 : 1;
+}
+
+int dxcw::reflect_file(char const* path)
+{
+    dxcw::detail::mapped_file file;
+    if (!file.map(path))
+    {
+        DXCW_LOG_ERROR("failed to open {}", path);
+        return 1;
+    }
+
+    uint32_t magic = 0;
+    if (file.size >= sizeof(magic))
+        std::memcpy(&magic, file.data, sizeof(magic));
+
+    auto const output = magic == 0x07230203 ? dxcw::output::spirv : dxcw::output::dxil;
+
+    // large, but plain data
+    auto reflection = std::make_unique<dxcw::shader_reflection>();
+    bool const success = dxcw::reflect_binary({file.data, file.size}, output, reflection.get());
+    file.unmap();
+
+    if (!success)
+        return 1;
+
+    auto const json = get_reflection_json(*reflection);
+    auto const json_path = std::string(path) + ".reflection.json";
+
+    dxcw::binary content;
+    content.data = reinterpret_cast<std::byte const*>(json.data());
+    content.size = json.size();
+    if (!dxcw::write_binary_to_file(content, json_path.c_str()))
+    {
+        DXCW_LOG_ERROR("failed to write reflection to {}", json_path);
+        return 1;
+    }
+
+    DXCW_LOG("wrote reflection of {} to {} ({} entry points, {} bindings, {} push constant blocks, {} signature elements)", path, json_path,
+             reflection->num_entry_points, reflection->num_bindings, reflection->num_push_constants, reflection->num_signature_elements);
+    return 0;
+}
+
+int dxcw::benchmark_archive(char const* archive_path)
+{
+    // decode throughput only, checksums are verified by --verify
+    dxcw::shader_store store;
+    if (!store.initialize(archive_path, false))
+        return 1;
+
+    using clock = std::chrono::steady_clock;
+    constexpr int num_repetitions = 10;
+
+    // decode everything as stored, keeping the SPIR-V binaries for the codec comparison
+    std::vector<std::vector<std::byte>> spirv_binaries;
+    uint64_t num_raw_bytes = 0, num_stored_bytes = 0;
+    double stored_decode_seconds = 0.0;
+    std::vector<std::byte> memory;
+    size_t const num_entries = store.get_entries().size();
+
+    for (auto const& entry : store.get_entries())
+    {
+        memory.resize(store.get_raw_size(entry));
+
+        auto const start = clock::now();
+        if (!store.read(entry, memory))
+        {
+            store.destroy();
+            return 1;
+        }
+        stored_decode_seconds += std::chrono::duration<double>(clock::now() - start).count();
+
+        num_raw_bytes += entry.raw_size;
+        num_stored_bytes += entry.size;
+
+        if (entry.output == dxcw::output::spirv)
+            spirv_binaries.push_back(memory);
+    }
+
+    store.destroy();
+
+    DXCW_LOG("{} binaries, {} bytes raw, {} bytes stored, decoded at {} MB/s", num_entries, num_raw_bytes, num_stored_bytes,
+             get_throughput(num_raw_bytes, stored_decode_seconds));
+
+    if (spirv_binaries.empty())
+        return 0;
+
+    struct codec_result
+    {
+        char const* name;
+        bool use_spirv_encoding;
+        bool use_compression;
+    };
+
+    codec_result const codecs[] = {{"raw", false, false}, {"lz", false, true}, {"spirv", true, false}, {"spirv+lz", true, true}};
+
+    DXCW_LOG("{} SPIR-V binaries:", spirv_binaries.size());
+    for (auto const& codec : codecs)
+    {
+        // encode outside of the measurement, the same way archive_writer does
+        std::vector<std::vector<std::byte>> encoded(spirv_binaries.size());
+        std::vector<std::vector<std::byte>> intermediate(spirv_binaries.size());
+        uint64_t num_raw = 0, num_encoded = 0;
+
+        for (auto i = 0u; i < spirv_binaries.size(); ++i)
+        {
+            auto const& binary = spirv_binaries[i];
+            std::vector<std::byte> data = binary;
+
+            if (codec.use_spirv_encoding)
+            {
+                data.resize(dxcw::detail::spirv_get_max_encoded_size(binary.size()));
+                data.resize(dxcw::detail::spirv_encode(binary.data(), binary.size(), data.data()));
+            }
+
+            intermediate[i] = data;
+
+            if (codec.use_compression)
+            {
+                encoded[i].resize(dxcw::detail::lz_get_max_compressed_size(data.size()));
+                encoded[i].resize(dxcw::detail::lz_compress(data.data(), data.size(), encoded[i].data()));
+            }
+            else
+            {
+                encoded[i] = data;
+            }
+
+            num_raw += binary.size();
+            num_encoded += encoded[i].size();
+        }
+
+        bool success = true;
+        auto const start = clock::now();
+        for (auto rep = 0; rep < num_repetitions; ++rep)
+        {
+            for (auto i = 0u; i < spirv_binaries.size(); ++i)
+            {
+                auto& out = memory;
+                out.resize(spirv_binaries[i].size());
+
+                std::byte const* data = encoded[i].data();
+                size_t size = encoded[i].size();
+
+                if (codec.use_compression)
+                {
+                    auto& target = codec.use_spirv_encoding ? intermediate[i] : out;
+                    success &= dxcw::detail::lz_decompress(data, size, target.data(), target.size());
+                    data = target.data();
+                    size = target.size();
+                }
+
+                if (codec.use_spirv_encoding)
+                    success &= dxcw::detail::spirv_decode(data, size, out.data(), out.size());
+                else if (!codec.use_compression)
+                    std::memcpy(out.data(), data, size);
+
+                if (rep == 0)
+                    success &= std::memcmp(out.data(), spirv_binaries[i].data(), out.size()) == 0;
+            }
+        }
+        double const seconds = std::chrono::duration<double>(clock::now() - start).count();
+
+        if (!success)
+        {
+            DXCW_LOG_ERROR("  {}: round trip failed", codec.name);
+            return 1;
+        }
+
+        DXCW_LOG("  {}: {} bytes ({}% of raw), decoded at {} MB/s", codec.name, num_encoded, num_raw > 0 ? num_encoded * 100 / num_raw : 0,
+                 get_throughput(num_raw * num_repetitions, seconds));
+    }
+
+    return 0;
+}
+
 int dxcw::compile_shader_single(const nx::args& args)
 {
     auto const pos_args = args.positional_args();
@@ -220,7 +707,14 @@ int dxcw::compile_shaderlist_watch(const char* shaderlist_path, cc::allocator* s
     return 0;
 }
 
-int dxcw::compile_shaderlist_json_single(const char* shaderlist_json, cc::allocator* scratch_alloc)
+int dxcw::compile_shaderlist_json_single(const char* shaderlist_json,
+                                         const char* opt_archive_path,
+                                         const char* opt_archive_ids_path,
+                                         bool compress_archive,
+                                         bool encode_archive_spirv,
+                                         bool update_archive,
+                                         const char* opt_embed_path,
+                                         cc::allocator* scratch_alloc)
 {
     std::error_code ec;
     auto const base_path_fs = std::filesystem::canonical(std::filesystem::path(shaderlist_json).remove_filename(), ec);
@@ -260,25 +754,74 @@ int dxcw::compile_shaderlist_json_single(const char* shaderlist_json, cc::alloca
         }
     } while (not_enough_space); // do-while because this could theoretically happen multiple times with unlucky file changes between each run
 
-    unsigned num_errors = 0;
-    for (auto i = 0u; i < num_shaders; ++i)
+    dxcw::archive_writer archive;
+    if (opt_archive_path)
     {
-        bool ok = dxcw::compile_binary_entry(compiler, watch_binary_entries[i], additional_includes, scratch_alloc);
-        if (!ok)
-            ++num_errors;
+        bool const success = update_archive
+                                 ? archive.initialize_update(opt_archive_path, base_path_string.c_str(), compress_archive, encode_archive_spirv)
+                                 : archive.initialize(opt_archive_path, base_path_string.c_str(), 4096, compress_archive, encode_archive_spirv);
+        if (!success)
+        {
+            compiler.destroy();
+            return 1;
+        }
     }
-    for (auto i = 0u; i < num_libraries; ++i)
+
+    dxcw::embed_writer embed;
+    if (opt_embed_path)
+        embed.initialize(base_path_string.c_str());
+
+    // outputs in an archive or embedded source are recorded with that file as their path
+    auto const embed_source_path = opt_embed_path ? std::string(opt_embed_path) + ".cc" : std::string();
+    char const* const container_path = opt_archive_path ? opt_archive_path : (opt_embed_path ? embed_source_path.c_str() : nullptr);
+
+    dxcw::manifest_writer manifest;
+    manifest.initialize(base_path_string.c_str(), additional_includes, container_path);
+
+    // compile all binary permutations and libraries in parallel
+    dxcw::shaderlist_compilation_result res = {};
+    auto const report_path = dxcw::get_diagnostics_report_path(shaderlist_json);
+    dxcw::compile_entries_parallel(compiler, cc::span<dxcw::shaderlist_binary_entry_owning const>(watch_binary_entries.data(), num_shaders),
+                                   cc::span<dxcw::shaderlist_library_entry_owning const>(watch_library_entries.data(), num_libraries),
+                                   additional_includes, &res, 0, report_path.str, archive.is_initialized() ? &archive : nullptr,
+                                   embed.is_initialized() ? &embed : nullptr, &manifest);
+
+    if (archive.is_initialized())
     {
-        bool ok = dxcw::compile_library_entry(compiler, watch_library_entries[i], additional_includes, scratch_alloc);
-        if (!ok)
-            ++num_errors;
+        // entries of failed compilations are kept, the previous binary is better than none
+        if (update_archive && res.num_errors == 0)
+        {
+            auto const num_removed = archive.remove_stale_entries();
+            if (num_removed > 0)
+                DXCW_LOG("removed {} entries no longer in the shaderlist from the archive", num_removed);
+        }
+
+        if (opt_archive_ids_path && !archive.write_id_header(opt_archive_ids_path))
+            ++res.num_errors;
+
+        if (!archive.finalize())
+            ++res.num_errors;
+    }
+
+    if (embed.is_initialized())
+    {
+        if (!embed.write(opt_embed_path))
+            ++res.num_errors;
+
+        embed.destroy();
     }
 
+    // a manifest must only list outputs that were written, the previous one is kept if any failed
+    if (res.num_errors > 0)
+        DXCW_LOG_WARN("shader manifest {} not written, the build has errors", dxcw::get_manifest_path(shaderlist_json).str);
+    else if (!manifest.write(dxcw::get_manifest_path(shaderlist_json).str))
+        ++res.num_errors;
 
+    manifest.destroy();
     compiler.destroy();
 
-    DXCW_LOG("compiled {} shaders, {} libraries, {} errors", num_shaders, num_libraries, num_errors);
-    return (num_errors == 0) ? 0 : 1;
+    DXCW_LOG("compiled {} shaders, {} libraries, {} errors", res.num_shaders_detected, res.num_libraries_detected, res.num_errors);
+    return (res.num_errors == 0) ? 0 : 1;
 }
 
 int dxcw::compile_shaderlist_json_watch(const char* shaderlist_json_path, cc::allocator* scratch_alloc)
@@ -383,8 +926,7 @@ int dxcw::compile_shaderlist_json_watch(const char* shaderlist_json_path, cc::al
                 auto const& entry = watch_binary_entries[i];
 
                 DXCW_LOG("  [B {}/{}] building {} ({}; {})", i + 1, num_shaders, entry.pathin, entry.target, entry.entrypoint);
-                auto const success = dxcw::compile_shader(compiler, entry.pathin_absolute, entry.target, entry.entrypoint, entry.pathout_absolute,
-                                                          additional_includes, scratch_alloc);
+                auto const success = dxcw::compile_binary_entry(compiler, entry, additional_includes, scratch_alloc);
 
                 watch_binary_aux[i].was_last_compilation_successful = success;
 
@@ -454,8 +996,7 @@ int dxcw::compile_shaderlist_json_watch(const char* shaderlist_json_path, cc::al
         char const* additional_includes[] = {base_path_fs.c_str()};
 
         DXCW_LOG("rebuilding {} ({}; {})", entry.pathin, entry.target, entry.entrypoint);
-        auto const success = dxcw::compile_shader(compiler, entry.pathin_absolute, entry.target, entry.entrypoint, entry.pathout_absolute,
-                                                  additional_includes, scratch_alloc);
+        auto const success = dxcw::compile_binary_entry(compiler, entry, additional_includes, scratch_alloc);
 
         bool const prev_success = watch_binary_aux[index].was_last_compilation_successful;
 
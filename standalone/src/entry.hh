@@ -8,13 +8,28 @@ namespace dxcw
 {
 int display_version_and_exit();
 
+int benchmark_archive(char const* archive_path);
+
+int compact_archive_file(char const* archive_path);
+
+int verify_file(char const* path);
+
+int reflect_file(char const* path);
+
 int compile_shader_single(nx::args const& args);
 
 int compile_shaderlist_single(char const* shaderlist_path);
 
 int compile_shaderlist_watch(char const* shaderlist_path, cc::allocator* scratch_alloc = cc::system_allocator);
 
-int compile_shaderlist_json_single(char const* shaderlist_json_path, cc::allocator* scratch_alloc = cc::system_allocator);
+int compile_shaderlist_json_single(char const* shaderlist_json_path,
+                                   char const* opt_archive_path = nullptr,
+                                   char const* opt_archive_ids_path = nullptr,
+                                   bool compress_archive = false,
+                                   bool encode_archive_spirv = false,
+                                   bool update_archive = false,
+                                   char const* opt_embed_path = nullptr,
+                                   cc::allocator* scratch_alloc = cc::system_allocator);
 
 int compile_shaderlist_json_watch(char const* shaderlist_json_path, cc::allocator* scratch_alloc = cc::system_allocator);
 }
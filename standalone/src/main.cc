@@ -17,8 +17,18 @@ int main(int argc, char const* argv[])
 
     bool is_watch_mode = false;
     bool is_display_version_mode = false;
+    bool is_archive_compressed = false;
+    bool is_archive_spirv_encoded = false;
+    bool is_archive_update = false;
     cc::string shaderlist_file;
     cc::string json_file;
+    cc::string archive_file;
+    cc::string archive_ids_file;
+    cc::string embed_file;
+    cc::string benchmark_archive_file;
+    cc::string compact_archive_file;
+    cc::string verify_file;
+    cc::string reflect_file;
     auto args = nx::args("dxcw-standalone", "standalone CLI for dxc-wrapper, compiles HLSL to DXIL (D3D12) or SPIR-V (Vulkan)\n\n"
                                             "Usage:\n"
                                             "./dxcw [input file] [entrypoint] [target] [output file without ending]\n"
@@ -26,11 +36,39 @@ int main(int argc, char const* argv[])
                                             "or: ./dxcw -l [list file]\n"
                                             "  list file contains normal arguments line-by-line\n"
                                             "or: ./dxcw -w -l [list file]\n"
-                                            "  watch mode - list file contains normal arguments line-by-line\n")
+                                            "  watch mode - list file contains normal arguments line-by-line\n"
+                                            "or: ./dxcw -j [json file] -a [archive file]\n"
+                                            "  write all binaries of a json shaderlist into a single packed archive\n"
+                                            "or: ./dxcw -j [json file] -a [archive file] --archive-ids [header file]\n"
+                                            "  additionally write a C++ header with constexpr name hashes of all archive entries\n"
+                                            "or: ./dxcw -j [json file] -a [archive file] -c\n"
+                                            "  compress the binaries in the archive\n"
+                                            "or: ./dxcw -j [json file] -a [archive file] -u\n"
+                                            "  update an existing archive in place, only appending changed binaries\n"
+                                            "or: ./dxcw --compact [archive file]\n"
+                                            "  rewrite an archive without the space of replaced or removed binaries\n"
+                                            "or: ./dxcw --verify [archive or manifest file]\n"
+                                            "  check the checksums of all archive entries, or of all outputs listed in a binary manifest (.manifest.bin)\n"
+                                            "or: ./dxcw --reflect [binary file]\n"
+                                            "  write bindings, stage I/O and entry points of a DXIL or SPIR-V binary to <file>.reflection.json\n"
+                                            "or: ./dxcw -j [json file] -e [output path without ending]\n"
+                                            "  write all binaries of a json shaderlist as C++ source (.hh and .cc) to bake them into an executable\n"
+                                            "or: ./dxcw --benchmark-archive [archive file]\n"
+                                            "  report sizes and decode throughput of the archive binaries with each codec\n")
                     .add(is_display_version_mode, {"v", "version"}, "display DXC version and exit")
                     .add(is_watch_mode, {"w", "watch"}, "listen for changes and recompile")
                     .add(shaderlist_file, {"l", "list"}, "parse a shaderlist and compile all shaders within instead of a single file")
-                    .add(json_file, {"j", "json"}, "parse a shaderlist json and compile all shaders within");
+                    .add(json_file, {"j", "json"}, "parse a shaderlist json and compile all shaders within")
+                    .add(archive_file, {"a", "archive"}, "write the binaries of a shaderlist json into a single packed archive file")
+                    .add(is_archive_compressed, {"c", "compress"}, "compress the binaries in the archive, where that reduces their size")
+                    .add(is_archive_spirv_encoded, {"s", "encode-spirv"}, "encode SPIR-V binaries in the archive, can be combined with -c")
+                    .add(is_archive_update, {"u", "update"}, "update an existing archive in place instead of rewriting it")
+                    .add(archive_ids_file, {"archive-ids"}, "write a C++ header with constexpr name hashes of all entries in the archive")
+                    .add(embed_file, {"e", "embed"}, "write the binaries of a shaderlist json as C++ source files, <path>.hh and <path>.cc")
+                    .add(benchmark_archive_file, {"benchmark-archive"}, "compare codecs on the binaries of an archive file")
+                    .add(compact_archive_file, {"compact"}, "remove unreferenced space from an archive file")
+                    .add(verify_file, {"verify"}, "check the checksums of an archive file, or of the outputs listed in a binary manifest")
+                    .add(reflect_file, {"reflect"}, "write the reflection of a compiled binary as JSON, without D3D12");
 
     if (!args.parse(argc, argv))
     {
@@ -42,6 +80,26 @@ int main(int argc, char const* argv[])
         return dxcw::display_version_and_exit();
     }
 
+    if (benchmark_archive_file.size() > 0)
+    {
+        return dxcw::benchmark_archive(benchmark_archive_file.c_str());
+    }
+
+    if (compact_archive_file.size() > 0)
+    {
+        return dxcw::compact_archive_file(compact_archive_file.c_str());
+    }
+
+    if (verify_file.size() > 0)
+    {
+        return dxcw::verify_file(verify_file.c_str());
+    }
+
+    if (reflect_file.size() > 0)
+    {
+        return dxcw::reflect_file(reflect_file.c_str());
+    }
+
     if (shaderlist_file.size() > 0)
     {
         if (is_watch_mode)
@@ -57,11 +115,35 @@ int main(int argc, char const* argv[])
     {
         if (is_watch_mode)
         {
+            if (archive_file.size() > 0 || embed_file.size() > 0)
+            {
+                DXCW_LOG_WARN("archive and embed output are not supported in watch mode, writing separate files");
+            }
+
             return dxcw::compile_shaderlist_json_watch(json_file.c_str());
         }
         else
         {
-            return dxcw::compile_shaderlist_json_single(json_file.c_str());
+            if (archive_ids_file.size() > 0 && archive_file.size() == 0)
+            {
+                DXCW_LOG_WARN("--archive-ids requires archive output (-a), no id header is written");
+            }
+
+            if (archive_file.size() > 0 && embed_file.size() > 0)
+            {
+                DXCW_LOG_ERROR("archive (-a) and embed (-e) output can't be combined");
+                return 1;
+            }
+
+            if (is_archive_update && archive_file.size() == 0)
+            {
+                DXCW_LOG_WARN("--update requires archive output (-a), ignoring it");
+            }
+
+            return dxcw::compile_shaderlist_json_single(json_file.c_str(), archive_file.size() > 0 ? archive_file.c_str() : nullptr,
+                                                        archive_ids_file.size() > 0 ? archive_ids_file.c_str() : nullptr, is_archive_compressed,
+                                                        is_archive_spirv_encoded, is_archive_update,
+                                                        embed_file.size() > 0 ? embed_file.c_str() : nullptr);
         }
     }
     else if (args.positional_args().size() == 4)